@@ -0,0 +1,179 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef EPD_UTILS_LIB__ALLOC_AUDIT_HPP_
+#define EPD_UTILS_LIB__ALLOC_AUDIT_HPP_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "epd_utils_lib/stage_observer.hpp"
+
+/*! \brief Counters of heap allocations per stage.\n
+Allocations are only counted in executables that link alloc_audit_hook.cpp,
+which replaces the C heap functions that operator new, cv::Mat and the Ort
+CPU allocator all allocate through. This is meant for tests and benchmarks
+only, and the processor node never links it.
+ */
+namespace EPD
+{
+/*! \brief The number of heap allocations and bytes allocated.*/
+struct AllocStats
+{
+  uint64_t count;
+  uint64_t bytes;
+};
+
+/*! \brief The number of counters. Allocations made outside of any stage are
+counted under the index NUM_STAGES.*/
+const size_t NUM_ALLOC_SCOPES = NUM_STAGES + 1;
+/*! \brief The maximum nesting depth of stages tracked per thread.*/
+const size_t MAX_ALLOC_STAGE_DEPTH = 16;
+
+/*! \class AllocAudit
+    \brief A collection of process-wide allocation counters, recorded by the
+    C heap functions replaced in alloc_audit_hook.cpp and attributed to the
+    innermost stage of the allocating thread. Allocations are attributed to
+    stages only while an AllocAudit object is registered with
+    addStageObserver.
+*/
+class AllocAudit : public StageObserver
+{
+public:
+  /*! \brief A Getter function that checks if alloc_audit_hook.cpp is linked
+  into the executable.*/
+  static bool isHooked()
+  {
+    return getHooked().load(std::memory_order_relaxed);
+  }
+
+  /*! \brief A Mutator function that starts or stops counting.*/
+  static void setEnabled(bool enabled)
+  {
+    getEnabled().store(enabled, std::memory_order_relaxed);
+  }
+
+  /*! \brief A Mutator function that zeroes all counters.*/
+  static void reset()
+  {
+    for (size_t i = 0; i < NUM_ALLOC_SCOPES; ++i) {
+      getCounts()[i].store(0, std::memory_order_relaxed);
+      getBytes()[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  /*! \brief A Getter function that gets the allocations made in a stage since
+  the last reset.*/
+  static AllocStats getStats(Stage stage)
+  {
+    const size_t scope = static_cast<size_t>(stage);
+    return AllocStats {
+      getCounts()[scope].load(std::memory_order_relaxed),
+      getBytes()[scope].load(std::memory_order_relaxed)};
+  }
+
+  /*! \brief A Getter function that gets the allocations made in all stages,
+  and outside of them, since the last reset.*/
+  static AllocStats getTotalStats()
+  {
+    AllocStats total {0, 0};
+    for (size_t i = 0; i < NUM_ALLOC_SCOPES; ++i) {
+      total.count += getCounts()[i].load(std::memory_order_relaxed);
+      total.bytes += getBytes()[i].load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+  /*! \brief A Mutator function called by the replaced C heap functions for every
+  allocation. It must not allocate itself.*/
+  static void record(size_t size)
+  {
+    if (!getEnabled().load(std::memory_order_relaxed)) {
+      return;
+    }
+    const size_t depth = getStageDepth();
+    const size_t scope = (depth == 0 || depth > MAX_ALLOC_STAGE_DEPTH) ?
+      NUM_STAGES : static_cast<size_t>(getStageStack()[depth - 1]);
+    getCounts()[scope].fetch_add(1, std::memory_order_relaxed);
+    getBytes()[scope].fetch_add(size, std::memory_order_relaxed);
+  }
+
+  /*! \brief A Mutator function called once by alloc_audit_hook.cpp.*/
+  static void markHooked()
+  {
+    getHooked().store(true, std::memory_order_relaxed);
+  }
+
+  void onStageBegin(Stage stage) override
+  {
+    size_t & depth = getStageDepth();
+    if (depth < MAX_ALLOC_STAGE_DEPTH) {
+      getStageStack()[depth] = stage;
+    }
+    ++depth;
+  }
+
+  void onStageEnd(Stage) override
+  {
+    size_t & depth = getStageDepth();
+    if (depth > 0) {
+      --depth;
+    }
+  }
+
+private:
+  static std::atomic<bool> & getHooked()
+  {
+    static std::atomic<bool> hooked {false};
+    return hooked;
+  }
+
+  static std::atomic<bool> & getEnabled()
+  {
+    static std::atomic<bool> enabled {false};
+    return enabled;
+  }
+
+  static std::array<std::atomic<uint64_t>, NUM_ALLOC_SCOPES> & getCounts()
+  {
+    static std::array<std::atomic<uint64_t>, NUM_ALLOC_SCOPES> counts {};
+    return counts;
+  }
+
+  static std::array<std::atomic<uint64_t>, NUM_ALLOC_SCOPES> & getBytes()
+  {
+    static std::array<std::atomic<uint64_t>, NUM_ALLOC_SCOPES> bytes {};
+    return bytes;
+  }
+
+  /*! \brief The stages the calling thread is in, innermost last.*/
+  static std::array<Stage, MAX_ALLOC_STAGE_DEPTH> & getStageStack()
+  {
+    thread_local std::array<Stage, MAX_ALLOC_STAGE_DEPTH> stageStack;
+    return stageStack;
+  }
+
+  static size_t & getStageDepth()
+  {
+    thread_local size_t depth = 0;
+    return depth;
+  }
+};
+
+}  // namespace EPD
+
+#endif  // EPD_UTILS_LIB__ALLOC_AUDIT_HPP_
@@ -0,0 +1,92 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/* Replaces the C heap allocation functions to count heap allocations into
+EPD::AllocAudit. This covers the global operator new, which allocates through
+malloc, as well as cv::Mat buffers and the ONNXRuntime CPU allocator, which
+allocate through malloc and posix_memalign directly. Memory is still allocated
+and freed by glibc. Only link this into tests and benchmarks. */
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+
+#include "epd_utils_lib/alloc_audit.hpp"
+
+// The glibc allocation functions that the replaced ones forward to.
+extern "C" {
+void * __libc_malloc(std::size_t size);
+void * __libc_calloc(std::size_t num, std::size_t size);
+void * __libc_realloc(void * ptr, std::size_t size);
+void * __libc_memalign(std::size_t alignment, std::size_t size);
+}
+
+namespace
+{
+struct AllocAuditHookRegistration
+{
+  AllocAuditHookRegistration()
+  {
+    EPD::AllocAudit::markHooked();
+  }
+} allocAuditHookRegistration;
+}  // namespace
+
+extern "C" {
+void * malloc(std::size_t size) noexcept
+{
+  EPD::AllocAudit::record(size);
+  return __libc_malloc(size);
+}
+
+void * calloc(std::size_t num, std::size_t size) noexcept
+{
+  EPD::AllocAudit::record(num * size);
+  return __libc_calloc(num, size);
+}
+
+void * realloc(void * ptr, std::size_t size) noexcept
+{
+  // Resizing may move the block, so it counts as an allocation.
+  EPD::AllocAudit::record(size);
+  return __libc_realloc(ptr, size);
+}
+
+void * memalign(std::size_t alignment, std::size_t size) noexcept
+{
+  EPD::AllocAudit::record(size);
+  return __libc_memalign(alignment, size);
+}
+
+void * aligned_alloc(std::size_t alignment, std::size_t size) noexcept
+{
+  EPD::AllocAudit::record(size);
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void ** ptr, std::size_t alignment, std::size_t size) noexcept
+{
+  if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0) {
+    return EINVAL;
+  }
+  EPD::AllocAudit::record(size);
+  void * mem = __libc_memalign(alignment, size);
+  if (mem == nullptr) {
+    return ENOMEM;
+  }
+  *ptr = mem;
+  return 0;
+}
+}  // extern "C"
@@ -0,0 +1,312 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef EPD_UTILS_LIB__COLUMNAR_FILE_HPP_
+#define EPD_UTILS_LIB__COLUMNAR_FILE_HPP_
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/*! \brief A file of named columns, each a flat little-endian array, used to
+write the results of a batch run in a layout that analysis tools, such as
+numpy.frombuffer, read without parsing every row.\n
+The file starts with a ColumnarFileHeader. The data of every column follows,
+each aligned to 64 bytes, and then a ColumnEntry per column. A STRING column
+holds numRows + 1 uint64 byte offsets followed by the concatenated UTF-8
+bytes of every row.
+ */
+namespace EPD
+{
+/*! \brief The identifier written at the start of every columnar file.*/
+const uint32_t COLUMNAR_FILE_MAGIC = 0x45504443;  // "EPDC"
+/*! \brief The version of the columnar file layout.*/
+const uint32_t COLUMNAR_FILE_VERSION = 1;
+/*! \brief The longest column name a columnar file stores.*/
+const size_t COLUMN_NAME_SIZE = 48;
+
+/*! \brief The element types of a column.*/
+enum class ColumnType : uint32_t
+{
+  INT32 = 0,
+  INT64,
+  UINT32,
+  FLOAT32,
+  FLOAT64,
+  STRING
+};
+
+/*! \brief The ColumnType of every supported element type.*/
+template<typename T>
+struct ColumnTypeOf;
+template<>
+struct ColumnTypeOf<int32_t> {static constexpr ColumnType value = ColumnType::INT32;};
+template<>
+struct ColumnTypeOf<int64_t> {static constexpr ColumnType value = ColumnType::INT64;};
+template<>
+struct ColumnTypeOf<uint32_t> {static constexpr ColumnType value = ColumnType::UINT32;};
+template<>
+struct ColumnTypeOf<float> {static constexpr ColumnType value = ColumnType::FLOAT32;};
+template<>
+struct ColumnTypeOf<double> {static constexpr ColumnType value = ColumnType::FLOAT64;};
+
+/*! \brief The layout at the start of a columnar file.*/
+struct ColumnarFileHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  /*! \brief The byte offset of the first ColumnEntry.*/
+  uint64_t directoryOffset;
+  uint64_t numColumns;
+  uint8_t reserved[40];
+};
+
+/*! \brief The layout of the directory entry of every column.*/
+struct ColumnEntry
+{
+  char name[COLUMN_NAME_SIZE];
+  uint32_t type;
+  uint32_t reserved;
+  uint64_t numRows;
+  /*! \brief The byte offset of the column data.*/
+  uint64_t offset;
+  /*! \brief The size of the column data in bytes.*/
+  uint64_t size;
+};
+
+/*! \brief A Getter function that rounds a size up to the 64-byte alignment of
+column data.*/
+inline size_t alignColumn(size_t size)
+{
+  return (size + 63) / 64 * 64;
+}
+
+/*! \class ColumnarWriter
+    \brief A producer of a columnar file.
+    The ColumnarWriter class object collects columns in memory and writes them
+    out at once.
+*/
+class ColumnarWriter
+{
+public:
+  /*! \brief A Mutator function that adds a column of numbers.*/
+  template<typename T>
+  void addColumn(const std::string & name, const std::vector<T> & values)
+  {
+    const uint8_t * bytes = reinterpret_cast<const uint8_t *>(values.data());
+    this->addColumnData(name, ColumnTypeOf<T>::value, values.size(),
+      std::vector<uint8_t>(bytes, bytes + values.size() * sizeof(T)));
+  }
+
+  /*! \brief A Mutator function that adds a column of strings.*/
+  void addColumn(const std::string & name, const std::vector<std::string> & values)
+  {
+    std::vector<uint64_t> offsets(1, 0);
+    offsets.reserve(values.size() + 1);
+    for (const auto & value : values) {
+      offsets.push_back(offsets.back() + value.size());
+    }
+    std::vector<uint8_t> data(offsets.size() * sizeof(uint64_t) + offsets.back());
+    memcpy(data.data(), offsets.data(), offsets.size() * sizeof(uint64_t));
+    uint8_t * chars = data.data() + offsets.size() * sizeof(uint64_t);
+    for (const auto & value : values) {
+      memcpy(chars, value.data(), value.size());
+      chars += value.size();
+    }
+    this->addColumnData(name, ColumnType::STRING, values.size(), std::move(data));
+  }
+
+  /*! \brief A Mutator function that writes every column added so far to the
+  file at path, overwriting it.*/
+  void write(const std::string & path) const
+  {
+    std::vector<ColumnEntry> entries(m_columns.size());
+    size_t offset = alignColumn(sizeof(ColumnarFileHeader));
+    for (size_t i = 0; i < m_columns.size(); ++i) {
+      entries[i] = m_columns[i].entry;
+      entries[i].offset = offset;
+      offset = alignColumn(offset + entries[i].size);
+    }
+
+    ColumnarFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = COLUMNAR_FILE_MAGIC;
+    header.version = COLUMNAR_FILE_VERSION;
+    header.directoryOffset = offset;
+    header.numColumns = entries.size();
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      throw std::runtime_error("Unable to create columnar file " + path);
+    }
+    const std::vector<char> padding(64, 0);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(padding.data(), alignColumn(sizeof(header)) - sizeof(header));
+    for (size_t i = 0; i < m_columns.size(); ++i) {
+      const std::vector<uint8_t> & data = m_columns[i].data;
+      file.write(reinterpret_cast<const char *>(data.data()), data.size());
+      file.write(padding.data(), alignColumn(data.size()) - data.size());
+    }
+    file.write(reinterpret_cast<const char *>(entries.data()),
+      entries.size() * sizeof(ColumnEntry));
+    if (!file) {
+      throw std::runtime_error("Unable to write columnar file " + path);
+    }
+  }
+
+private:
+  /*! \brief A column waiting to be written.*/
+  struct Column
+  {
+    ColumnEntry entry;
+    std::vector<uint8_t> data;
+  };
+  /*! \brief The columns added so far, in order.*/
+  std::vector<Column> m_columns;
+
+  void addColumnData(
+    const std::string & name,
+    ColumnType type,
+    size_t numRows,
+    std::vector<uint8_t> data)
+  {
+    if (name.empty() || name.size() >= COLUMN_NAME_SIZE) {
+      throw std::runtime_error("Invalid column name " + name);
+    }
+    Column column;
+    memset(&column.entry, 0, sizeof(column.entry));
+    memcpy(column.entry.name, name.c_str(), name.size());
+    column.entry.type = static_cast<uint32_t>(type);
+    column.entry.numRows = numRows;
+    column.entry.size = data.size();
+    column.data = std::move(data);
+    m_columns.push_back(std::move(column));
+  }
+};
+
+/*! \class ColumnarReader
+    \brief A consumer of a columnar file.
+    The ColumnarReader class object loads a columnar file and gets its columns
+    by name.
+*/
+class ColumnarReader
+{
+public:
+  /*! \brief A Constructor function that loads the columnar file at path.*/
+  explicit ColumnarReader(const std::string & path)
+  {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+      throw std::runtime_error("Unable to open columnar file " + path);
+    }
+    m_data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+    ColumnarFileHeader header;
+    if (m_data.size() < sizeof(header)) {
+      throw std::runtime_error("Invalid columnar file " + path);
+    }
+    memcpy(&header, m_data.data(), sizeof(header));
+    if (header.magic != COLUMNAR_FILE_MAGIC || header.version != COLUMNAR_FILE_VERSION ||
+      header.directoryOffset + header.numColumns * sizeof(ColumnEntry) > m_data.size())
+    {
+      throw std::runtime_error("Invalid columnar file " + path);
+    }
+    m_entries.resize(header.numColumns);
+    memcpy(m_entries.data(), m_data.data() + header.directoryOffset,
+      m_entries.size() * sizeof(ColumnEntry));
+    for (const auto & entry : m_entries) {
+      if (entry.offset + entry.size > m_data.size()) {
+        throw std::runtime_error("Invalid columnar file " + path);
+      }
+    }
+  }
+
+  /*! \brief A Getter function that gets the name of every column, in
+  order.*/
+  std::vector<std::string> getColumnNames() const
+  {
+    std::vector<std::string> names;
+    for (const auto & entry : m_entries) {
+      names.emplace_back(entry.name, strnlen(entry.name, COLUMN_NAME_SIZE));
+    }
+    return names;
+  }
+
+  /*! \brief A Getter function that gets a column of numbers.*/
+  template<typename T>
+  std::vector<T> getColumn(const std::string & name) const
+  {
+    const ColumnEntry & entry = this->findColumn(name, ColumnTypeOf<T>::value);
+    if (entry.size != entry.numRows * sizeof(T)) {
+      throw std::runtime_error("Invalid column " + name);
+    }
+    std::vector<T> values(entry.numRows);
+    memcpy(values.data(), m_data.data() + entry.offset, entry.size);
+    return values;
+  }
+
+  /*! \brief A Getter function that gets a column of strings.*/
+  std::vector<std::string> getStringColumn(const std::string & name) const
+  {
+    const ColumnEntry & entry = this->findColumn(name, ColumnType::STRING);
+    const size_t offsetsSize = (entry.numRows + 1) * sizeof(uint64_t);
+    if (entry.size < offsetsSize) {
+      throw std::runtime_error("Invalid column " + name);
+    }
+    std::vector<uint64_t> offsets(entry.numRows + 1);
+    memcpy(offsets.data(), m_data.data() + entry.offset, offsetsSize);
+    if (offsets.back() != entry.size - offsetsSize) {
+      throw std::runtime_error("Invalid column " + name);
+    }
+
+    const char * chars = m_data.data() + entry.offset + offsetsSize;
+    std::vector<std::string> values;
+    values.reserve(entry.numRows);
+    for (size_t i = 0; i < entry.numRows; ++i) {
+      if (offsets[i] > offsets[i + 1]) {
+        throw std::runtime_error("Invalid column " + name);
+      }
+      values.emplace_back(chars + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+    return values;
+  }
+
+private:
+  /*! \brief The whole columnar file.*/
+  std::vector<char> m_data;
+  /*! \brief The directory entry of every column.*/
+  std::vector<ColumnEntry> m_entries;
+
+  const ColumnEntry & findColumn(const std::string & name, ColumnType type) const
+  {
+    for (const auto & entry : m_entries) {
+      if (name == std::string(entry.name, strnlen(entry.name, COLUMN_NAME_SIZE))) {
+        if (entry.type != static_cast<uint32_t>(type)) {
+          throw std::runtime_error("Mismatch type of column " + name);
+        }
+        return entry;
+      }
+    }
+    throw std::out_of_range("No column " + name);
+  }
+};
+
+}  // namespace EPD
+
+#endif  // EPD_UTILS_LIB__COLUMNAR_FILE_HPP_
@@ -0,0 +1,224 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef EPD_UTILS_LIB__DEADLINE_SCHEDULER_HPP_
+#define EPD_UTILS_LIB__DEADLINE_SCHEDULER_HPP_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "epd_utils_lib/stage_observer.hpp"
+
+namespace EPD
+{
+/*! \brief The decisions DeadlineScheduler makes on a frame.*/
+enum class FrameDecision : uint8_t
+{
+  PROCESS = 0,
+  /*! \brief The deadline has already passed.*/
+  SKIP_EXPIRED,
+  /*! \brief Processing is predicted to end after the deadline.*/
+  SKIP_PREDICTED_MISS
+};
+
+/*! \class DeadlineScheduler
+    \brief A StageObserver that keeps a running latency estimate of every
+    stage a frame goes through once it is received, and decides whether a
+    frame can still be processed before its deadline.\n
+    The stages of a frame are summed per thread between beginFrame and
+    endFrame, usually through a ScopedFrame, and folded into the estimates
+    once the frame ends, so that stages that run several times per frame,
+    such as those of a cascade Ort Session, are counted in full. A frame
+    begun within another frame on the same thread is part of it. Stages that
+    run outside any frame, and frames that are skipped, do not change the
+    estimates.\n
+    Every member function may be called from any thread.
+*/
+class DeadlineScheduler : public StageObserver
+{
+public:
+  /*! \brief The first stage that runs after the scheduling decision.*/
+  static constexpr Stage FIRST_SCHEDULED_STAGE = Stage::CONVERT;
+
+  /*! \brief A Constructor function. smoothing is the weight of a new frame
+  in the running estimates.*/
+  explicit DeadlineScheduler(double smoothing = 0.2)
+  : m_smoothing(smoothing)
+  {
+    for (auto & latencyMs : m_latencyMs) {
+      latencyMs.store(-1.0, std::memory_order_relaxed);
+    }
+  }
+
+  /*! \brief A Getter function that gets the running latency estimate of a
+  stage in ms, or 0 if it was never measured.*/
+  double getStageLatencyMs(Stage stage) const
+  {
+    const double latencyMs = m_latencyMs[static_cast<size_t>(stage)].load();
+    return latencyMs < 0.0 ? 0.0 : latencyMs;
+  }
+
+  /*! \brief A Getter function that gets the predicted time from the
+  scheduling decision until a frame is published, in ms.*/
+  double getPredictedLatencyMs() const
+  {
+    double predictedMs = 0.0;
+    for (size_t i = static_cast<size_t>(FIRST_SCHEDULED_STAGE); i < NUM_STAGES; ++i) {
+      predictedMs += getStageLatencyMs(static_cast<Stage>(i));
+    }
+    return predictedMs;
+  }
+
+  /*! \brief A Getter function that decides on a frame that has already
+  waited waitedMs out of a latency budget of budgetMs.*/
+  FrameDecision decide(double waitedMs, double budgetMs) const
+  {
+    if (waitedMs > budgetMs) {
+      return FrameDecision::SKIP_EXPIRED;
+    }
+    if (waitedMs + getPredictedLatencyMs() > budgetMs) {
+      return FrameDecision::SKIP_PREDICTED_MISS;
+    }
+    return FrameDecision::PROCESS;
+  }
+
+  /*! \brief A Mutator function that folds the time spent in every stage by
+  one processed frame into the running estimates.*/
+  void addFrame(const std::array<double, NUM_STAGES> & elapsedMs)
+  {
+    for (size_t i = static_cast<size_t>(FIRST_SCHEDULED_STAGE); i < NUM_STAGES; ++i) {
+      std::atomic<double> & latencyMs = m_latencyMs[i];
+      double expected = latencyMs.load();
+      double desired;
+      do {
+        desired = expected < 0.0 ?
+          elapsedMs[i] : expected + m_smoothing * (elapsedMs[i] - expected);
+      } while (!latencyMs.compare_exchange_weak(expected, desired));
+    }
+  }
+
+  /*! \brief A Mutator function that begins a frame on the calling thread.*/
+  void beginFrame(void)
+  {
+    FrameTimes & frame = getFrameTimes();
+    if (frame.depth++ == 0) {
+      frame.elapsedMs.fill(0.0);
+    }
+  }
+
+  /*! \brief A Mutator function that ends a frame on the calling thread and,
+  if it is the outermost one, folds its stage times into the estimates.*/
+  void endFrame(void)
+  {
+    FrameTimes & frame = getFrameTimes();
+    if (frame.depth == 0 || --frame.depth != 0) {
+      return;
+    }
+    // Only frames that went past the scheduling decision are measured.
+    bool processed = false;
+    for (size_t i = static_cast<size_t>(FIRST_SCHEDULED_STAGE); i < NUM_STAGES; ++i) {
+      processed = processed || frame.elapsedMs[i] > 0.0;
+    }
+    if (processed) {
+      this->addFrame(frame.elapsedMs);
+    }
+    frame.elapsedMs.fill(0.0);
+  }
+
+  /*! \brief A Mutator function that leaves the frame being processed by the
+  calling thread out of the running estimates, such as when it is abandoned
+  midway.*/
+  void discardFrame(void)
+  {
+    getFrameTimes().elapsedMs.fill(0.0);
+  }
+
+  void onStageBegin(Stage stage) override
+  {
+    getFrameTimes().begin[static_cast<size_t>(stage)] = std::chrono::steady_clock::now();
+  }
+
+  void onStageEnd(Stage stage) override
+  {
+    FrameTimes & frame = getFrameTimes();
+    if (frame.depth == 0) {
+      return;
+    }
+    const size_t idx = static_cast<size_t>(stage);
+    frame.elapsedMs[idx] += std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - frame.begin[idx]).count();
+  }
+
+private:
+  /*! \brief The stage times of the frame being processed by a thread.*/
+  struct FrameTimes
+  {
+    std::array<std::chrono::steady_clock::time_point, NUM_STAGES> begin;
+    std::array<double, NUM_STAGES> elapsedMs {};
+    /*! \brief The number of frames begun and not yet ended.*/
+    int depth = 0;
+  };
+
+  /*! \brief A Getter function that gets the FrameTimes of the calling
+  thread.*/
+  static FrameTimes & getFrameTimes()
+  {
+    thread_local FrameTimes frame;
+    return frame;
+  }
+
+  /*! \brief The weight of a new frame in the running estimates.*/
+  const double m_smoothing;
+  /*! \brief The running latency estimate of every stage in ms, or a negative
+  value if it was never measured.*/
+  std::array<std::atomic<double>, NUM_STAGES> m_latencyMs;
+};
+
+/*! \class ScopedFrame
+    \brief A guard that marks the lifetime of a scope as one frame of a
+    DeadlineScheduler, which may be nullptr.
+*/
+class ScopedFrame
+{
+public:
+  /*! \brief A Constructor function that begins a frame.*/
+  explicit ScopedFrame(DeadlineScheduler * scheduler)
+  : m_scheduler(scheduler)
+  {
+    if (m_scheduler != nullptr) {
+      m_scheduler->beginFrame();
+    }
+  }
+
+  /*! \brief A Destructor function that ends the frame.*/
+  ~ScopedFrame()
+  {
+    if (m_scheduler != nullptr) {
+      m_scheduler->endFrame();
+    }
+  }
+
+  ScopedFrame(const ScopedFrame &) = delete;
+  ScopedFrame & operator=(const ScopedFrame &) = delete;
+
+private:
+  /*! \brief The scheduler this guard marks the frame for.*/
+  DeadlineScheduler * const m_scheduler;
+};
+}  // namespace EPD
+
+#endif  // EPD_UTILS_LIB__DEADLINE_SCHEDULER_HPP_
@@ -14,8 +14,11 @@
 // limitations under the License.
 
 #include <algorithm>
+#include <chrono>
 #include <fstream>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "epd_container.hpp"
@@ -29,11 +32,15 @@ EPDContainer::EPDContainer(void)
 {
   hasInitialized = false;
   onlyVisualize = true;
+  useCaseMode = EPD::CLASSIFICATION_MODE;
+  hasCascade = false;
+  startupPhaseMs.fill(-1.0);
 
-  this->setModelConfigFile();
-  this->setPrecisionLevel();
-  this->setLabelList();
-  this->setUseCaseConfigFile();
+  this->timeStartupPhase(StartupPhase::CONFIG, [this]() {this->setModelConfigFile();});
+  this->timeStartupPhase(StartupPhase::PRECISION_PROBE, [this]() {this->setPrecisionLevel();});
+  this->timeStartupPhase(StartupPhase::LABELS, [this]() {this->setLabelList();});
+  this->timeStartupPhase(StartupPhase::USECASE, [this]() {this->setUseCaseConfigFile();});
+  this->timeStartupPhase(StartupPhase::CASCADE, [this]() {this->setCascadeConfigFile();});
 }
 
 EPDContainer::~EPDContainer() {}
@@ -48,6 +55,26 @@ bool EPDContainer::isVisualize(void)
   return onlyVisualize;
 }
 
+bool EPDContainer::isCascade(void)
+{
+  return hasCascade;
+}
+
+double EPDContainer::getStartupPhaseMs(StartupPhase phase) const
+{
+  return (phase < StartupPhase::NUM_STARTUP_PHASES) ?
+         startupPhaseMs[static_cast<size_t>(phase)] : -1.0;
+}
+
+template<typename Function>
+void EPDContainer::timeStartupPhase(StartupPhase phase, Function function)
+{
+  const auto start = std::chrono::steady_clock::now();
+  function();
+  startupPhaseMs[static_cast<size_t>(phase)] = std::chrono::duration<double, std::milli>(
+    std::chrono::steady_clock::now() - start).count();
+}
+
 int EPDContainer::getHeight() {return frame_height;}
 
 int EPDContainer::getWidth() {return frame_width;}
@@ -63,18 +90,33 @@ void EPDContainer::setFrameDimension(int input_width, int input_height)
   frame_height = input_height;
 }
 
-void EPDContainer::initORTSessionHandler()
+constexpr int EPDContainer::DEFAULT_SHORT_SIDE;
+
+Ort::FrameGeometry EPDContainer::computeFrameGeometry(int width, int height, int shortSide)
 {
-  float ratio = 800.0 / std::min(frame_width, frame_height);
-  int newW = ratio * frame_width;
-  int newH = ratio * frame_height;
+  Ort::FrameGeometry geometry;
+  geometry.ratio = static_cast<float>(shortSide) / std::min(width, height);
+  geometry.newW = geometry.ratio * width;
+  geometry.newH = geometry.ratio * height;
   // Ensure that padded dimensions are divisible by 32.
-  int paddedW = static_cast<int>(((newW + 31) / 32) * 32);
-  int paddedH = static_cast<int>(((newH + 31) / 32) * 32);
+  geometry.paddedW = static_cast<int>(((geometry.newW + 31) / 32) * 32);
+  geometry.paddedH = static_cast<int>(((geometry.newH + 31) / 32) * 32);
+  return geometry;
+}
+
+void EPDContainer::initORTSessionHandler()
+{
+  const auto start = std::chrono::steady_clock::now();
+  Ort::FrameGeometry geometry = computeFrameGeometry(frame_width, frame_height);
+  float ratio = geometry.ratio;
+  int newW = geometry.newW;
+  int newH = geometry.newH;
+  int paddedW = geometry.paddedW;
+  int paddedH = geometry.paddedH;
 
   switch (precision_level) {
     case 1:
-      p1_ort_session = new Ort::P1OrtBase(
+      p1_ort_session = std::make_unique<Ort::P1OrtBase>(
         ratio, 224, 224, paddedW, paddedH,
         classNames.size(),
         onnx_model_path,
@@ -84,7 +126,7 @@ void EPDContainer::initORTSessionHandler()
       p1_ort_session->initClassNames(classNames);
       break;
     case 2:
-      p2_ort_session = new Ort::P2OrtBase(
+      p2_ort_session = std::make_unique<Ort::P2OrtBase>(
         ratio, newW, newH, paddedW, paddedH,
         classNames.size(),
         onnx_model_path,
@@ -94,7 +136,7 @@ void EPDContainer::initORTSessionHandler()
       p2_ort_session->initClassNames(classNames);
       break;
     case 3:
-      p3_ort_session = new Ort::P3OrtBase(
+      p3_ort_session = std::make_unique<Ort::P3OrtBase>(
         ratio, newW, newH, paddedW, paddedH,
         classNames.size(),
         onnx_model_path,
@@ -104,6 +146,104 @@ void EPDContainer::initORTSessionHandler()
       p3_ort_session->initClassNames(classNames);
       break;
   }
+
+  if (hasCascade) {
+    cascade_ort_session = std::make_unique<Ort::P1OrtBase>(
+      ratio, CASCADE_IMG_SIZE, CASCADE_IMG_SIZE, paddedW, paddedH,
+      cascadeClassNames.size(),
+      cascade_model_path,
+      0,
+      std::vector<std::vector<int64_t>>{{1, IMG_CHANNEL, CASCADE_IMG_SIZE, CASCADE_IMG_SIZE}}
+    );
+    cascade_ort_session->initClassNames(cascadeClassNames);
+  }
+  startupPhaseMs[static_cast<size_t>(StartupPhase::SESSIONS)] =
+    std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool EPDContainer::initialize(int width, int height, bool runWarmUp)
+{
+  bool initialized = false;
+  std::call_once(initFlag, [this, width, height, runWarmUp, &initialized]() {
+      this->setFrameDimension(width, height);
+      this->initORTSessionHandler();
+      if (runWarmUp) {
+        this->warmUp();
+      }
+      this->setInitBoolean(true);
+      initialized = true;
+    });
+  return initialized;
+}
+
+void EPDContainer::warmUp()
+{
+  // The warm-up run belongs to no frame, so a frame that is cancelled while
+  // waiting for it must not terminate it.
+  Ort::ScopedRunCanceller noCanceller(nullptr);
+
+  this->timeStartupPhase(StartupPhase::FIRST_RUN, [this]() {
+      const cv::Mat blankFrame = cv::Mat::zeros(frame_height, frame_width, CV_8UC3);
+      switch (precision_level) {
+        case 1:
+          p1_ort_session->infer(blankFrame);
+          break;
+        case 2:
+          p2_ort_session->infer_action(blankFrame);
+          break;
+        case 3:
+          p3_ort_session->infer_action(blankFrame);
+          break;
+      }
+      // A blank frame has no detections to classify, so the cascade session
+      // is warmed up on its own.
+      if (hasCascade) {
+        const cv::Mat blankCrop = cv::Mat::zeros(CASCADE_IMG_SIZE, CASCADE_IMG_SIZE, CV_8UC3);
+        cascade_ort_session->infer(blankCrop);
+      }
+    });
+}
+
+void EPDContainer::classifyDetections(
+  const cv::Mat & img,
+  const EPD::InferenceConfig & config,
+  EPD::EPDObjectDetection & result)
+{
+  result.cascadeNames.clear();
+  if (!hasCascade || result.bboxes.empty()) {
+    return;
+  }
+
+  const cv::Rect imgRect(0, 0, img.cols, img.rows);
+  std::vector<cv::Mat> crops;
+  std::vector<size_t> cropOwners;
+  crops.reserve(result.bboxes.size());
+  cropOwners.reserve(result.bboxes.size());
+
+  for (size_t i = 0; i < result.bboxes.size(); ++i) {
+    const auto & curBbox = result.bboxes[i];
+    cv::Rect objectROI = cv::Rect(cv::Point(curBbox[0], curBbox[1]),
+        cv::Point(curBbox[2], curBbox[3])) & imgRect;
+    // Skip degenerate boxes which cannot be resized for classification.
+    if (objectROI.area() > 0) {
+      crops.emplace_back(img(objectROI));
+      cropOwners.emplace_back(i);
+    }
+  }
+
+  result.cascadeNames.resize(result.bboxes.size());
+  if (crops.empty()) {
+    return;
+  }
+
+  std::vector<EPD::EPDImageClassification> cropResults;
+  cascade_ort_session->infer(crops, config, cropResults);
+  const std::vector<std::string> & cascadeClassNames = cascade_ort_session->getClassNames();
+  for (size_t i = 0; i < cropOwners.size(); ++i) {
+    if (cropResults[i].size() != 0) {
+      result.cascadeNames[cropOwners[i]] = cascadeClassNames[cropResults[i].classIndices[0]];
+    }
+  }
 }
 
 void EPDContainer::setModelConfigFile()
@@ -173,6 +313,71 @@ void EPDContainer::setUseCaseConfigFile()
     }
   }
   infile.close();
+
+  // The config files only set the initial InferenceConfig snapshot, which
+  // Processor may replace at runtime.
+  EPD::InferenceConfig config = *EPD::getInferenceConfig();
+  config.useCaseMode = useCaseMode;
+  config.countClassNames = countClassNames;
+  config.onlyVisualize = onlyVisualize;
+  if (useCaseMode == EPD::COLOR_MATCHING_MODE) {
+    EPD::setColorTemplate(config, template_color_path);
+  }
+  EPD::setInferenceConfig(std::move(config));
+}
+
+void EPDContainer::setCascadeConfigFile()
+{
+  std::string filepath;
+  std::fstream infile;
+  infile.open(PATH_TO_CASCADE_CONFIG);
+
+  // Cascade mode is optional and only enabled when cascade_config.txt exists.
+  if (!infile.is_open()) {
+    return;
+  }
+
+  while (std::getline(infile, filepath)) {
+    if (filepath.empty()) {
+      continue;
+    }
+    if (std::ifstream(filepath)) {
+      if (filepath.substr(filepath.find_last_of(".") + 1) == "onnx") {
+        cascade_model_path = filepath;
+      }
+      if (filepath.substr(filepath.find_last_of(".") + 1) == "txt") {
+        cascade_label_path = filepath;
+      }
+    } else {
+      std::stringstream FILE_DOES_NOT_EXIST;
+      FILE_DOES_NOT_EXIST << filepath << " does not exist.";
+      throw std::runtime_error(FILE_DOES_NOT_EXIST.str().c_str());
+    }
+  }
+  infile.close();
+
+  if (cascade_model_path.empty() || cascade_label_path.empty()) {
+    throw std::runtime_error("Cascade requires a P1 .onnx model and a .txt label list.");
+  }
+  if (precision_level == 1) {
+    throw std::runtime_error("Cascade requires a P2 or P3 ONNX model as detector.");
+  }
+  if (onlyVisualize) {
+    printf("[-Cascade-]= Ignored. Only available for robot output.\n");
+    return;
+  }
+
+  std::string label;
+  infile.open(cascade_label_path);
+  while (std::getline(infile, label)) {
+    cascadeClassNames.emplace_back(label);
+  }
+  infile.close();
+
+  hasCascade = true;
+  std::string cascade_model_filename =
+    cascade_model_path.substr(cascade_model_path.find_last_of("/\\") + 1);
+  printf("[-Cascade ONNX Model-]= %s\n", cascade_model_filename.c_str());
 }
 
 void EPDContainer::setPrecisionLevel()
@@ -188,10 +393,10 @@ void EPDContainer::setPrecisionLevel()
     case 1:
       precision_level = 1;
       break;
-    case 3:
+    case Ort::P2Traits::NUM_OUTPUTS:
       precision_level = 2;
       break;
-    case 4:
+    case Ort::P3Traits::NUM_OUTPUTS:
       precision_level = 3;
       break;
     default:
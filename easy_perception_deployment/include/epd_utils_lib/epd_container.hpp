@@ -16,6 +16,10 @@
 #ifndef EPD_UTILS_LIB__EPD_CONTAINER_HPP_
 #define EPD_UTILS_LIB__EPD_CONTAINER_HPP_
 
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -27,30 +31,77 @@
 
 namespace EPD
 {
+/*! \brief The phases of starting up an EPDContainer, in order. The first
+five run in the constructor. SESSIONS creates the Ort Sessions for the first
+frame dimension and FIRST_RUN warms them up with a blank frame, which includes
+the one-time kernel initialization of the Execution Provider.*/
+enum class StartupPhase : uint8_t
+{
+  CONFIG = 0,
+  PRECISION_PROBE,
+  LABELS,
+  USECASE,
+  CASCADE,
+  SESSIONS,
+  FIRST_RUN,
+  NUM_STARTUP_PHASES
+};
+
+/*! \brief The number of phases of starting up an EPDContainer.*/
+const size_t NUM_STARTUP_PHASES = static_cast<size_t>(StartupPhase::NUM_STARTUP_PHASES);
+
+/*! \brief A Getter function that gets the human-readable name of a startup
+phase.*/
+inline const char * getStartupPhaseName(StartupPhase phase)
+{
+  static const char * STARTUP_PHASE_NAMES[NUM_STARTUP_PHASES] = {
+    "config", "precision_probe", "labels", "usecase",
+    "cascade", "sessions", "first_run"
+  };
+  return (phase < StartupPhase::NUM_STARTUP_PHASES) ?
+         STARTUP_PHASE_NAMES[static_cast<size_t>(phase)] : "unknown";
+}
+
 /*! \class EPDContainer
     \brief An Easy Perception Deployment(EPD) Container class object.
     The EPDContainer class object parses the session_config.txt and
     usecase_config.txt files to determine how an ONNX model can be
-    deployed as an inference engine using the ONNXRuntime library.
+    deployed as an inference engine using the ONNXRuntime library.\n
+    Concurrency: initialize may be called from any number of threads and
+    creates the Ort Sessions exactly once. Once isInit returns true, the
+    sessions and configuration are never modified again, so every const and
+    inference member function, including those of the Ort Sessions, may be
+    called concurrently. Each thread runs with its own buffers. The other
+    Mutator functions are meant for single-threaded setup only.
 */
 class EPDContainer
 {
 public:
-  /*! \brief An pointer for a Precision Level 3 OrtBase object*/
-  Ort::P3OrtBase * p3_ort_session;
-  /*! \brief An pointer for a Precision Level 2 OrtBase object*/
-  Ort::P2OrtBase * p2_ort_session;
-  /*! \brief An pointer for a Precision Level 1 OrtBase object*/
-  Ort::P1OrtBase * p1_ort_session;
+  /*! \brief The owning pointer for a Precision Level 3 OrtBase object*/
+  std::unique_ptr<Ort::P3OrtBase> p3_ort_session;
+  /*! \brief The owning pointer for a Precision Level 2 OrtBase object*/
+  std::unique_ptr<Ort::P2OrtBase> p2_ort_session;
+  /*! \brief The owning pointer for a Precision Level 1 OrtBase object*/
+  std::unique_ptr<Ort::P1OrtBase> p1_ort_session;
+  /*! \brief The owning pointer for a Precision Level 1 OrtBase object that
+  * classifies the detections of a P2/P3 OrtBase object when cascade mode is
+  * enabled.*/
+  std::unique_ptr<Ort::P1OrtBase> cascade_ort_session;
   /*! \brief The determined precision_level for an input ONNX model file,
   * stated by the session_config.txt. */
   unsigned int precision_level;
   /*! \brief A fixed integer for expected RGB 2D images*/
   const int IMG_CHANNEL = 3;
+  /*! \brief The default short side P2 and P3 input frames are resized to.*/
+  static constexpr int DEFAULT_SHORT_SIDE = 800;
   /*! \brief The constant filepath to session_config.txt*/
   const std::string PATH_TO_SESSION_CONFIG = "data/session_config.txt";
   /*! \brief The constant filepath to usecase_config.txt*/
   const std::string PATH_TO_USECASE_CONFIG = "data/usecase_config.txt";
+  /*! \brief The constant filepath to the optional cascade_config.txt*/
+  const std::string PATH_TO_CASCADE_CONFIG = "data/cascade_config.txt";
+  /*! \brief The fixed input image size of the cascade P1 ONNX model.*/
+  const int CASCADE_IMG_SIZE = 224;
   /*! \brief The filepath to a template color image for Color-Matching use-case
   * filter.
   */
@@ -61,6 +112,10 @@ public:
   std::string class_label_path;
   /*! \brief The filepath to an input ONNX model file*/
   std::string onnx_model_path;
+  /*! \brief The filepath to the P1 ONNX model file used in cascade mode*/
+  std::string cascade_model_path;
+  /*! \brief The filepath to the class label list of the cascade P1 ONNX model*/
+  std::string cascade_label_path;
 
   /*! \brief The selected use-case mode. Values can only be 0,1,2.\n
   *  See usecase_config.hpp for more details.\n
@@ -75,6 +130,10 @@ public:
   * label list.
   */
   std::vector<std::string> classNames;
+  /*! \brief A list of human-understandable object text labels from the
+  * cascade P1 label list.
+  */
+  std::vector<std::string> cascadeClassNames;
 
   /*! \brief A Constructor function*/
   EPDContainer(void);
@@ -83,8 +142,11 @@ public:
 
   /*! \brief A Getter function that gets the bool variable, hasInitialized*/
   bool isInit(void);
-  /*! \brief A Getter function that gets the bool variable, onlyVisualize*/
+  /*! \brief A Getter function that gets the bool variable, onlyVisualize, as
+  set by session_config.txt. Processor follows InferenceConfig instead.*/
   bool isVisualize(void);
+  /*! \brief A Getter function that gets the bool variable, hasCascade*/
+  bool isCascade(void);
   /*! \brief A Getter function that gets the int variable, frame_height*/
   int getHeight(void);
   /*! \brief A Getter function that gets the int variable, frame_width*/
@@ -97,14 +159,65 @@ public:
   *   specific OrtBase object.
   */
   void initORTSessionHandler();
+  /*! \brief A thread-safe Mutator function that sets the frame dimension and
+  *   initializes the OrtBase objects once and only once, followed by warmUp
+  *   if runWarmUp is true. Concurrent callers block until the first one is
+  *   done. If it throws, the next call retries. Returns true for the call that
+  *   initialized.
+  */
+  bool initialize(int width, int height, bool runWarmUp = false);
+  /*! \brief A Mutator function that runs a blank frame of the set frame
+  *   dimension through the initialized OrtBase objects once, so that the
+  *   first real frame does not pay for their lazy initialization.
+  */
+  void warmUp();
+  /*! \brief A Getter function that gets the time a startup phase took, in
+  *   ms, or a negative value if it has not run.
+  */
+  double getStartupPhaseMs(StartupPhase phase) const;
+  /*! \brief A Getter function that derives the resized and padded input
+  *   dimensions for P2 and P3 inference from an input frame dimension, with
+  *   the short side resized to shortSide. This allows a single Ort Session to
+  *   serve frames of differing dimensions and input sizes.
+  */
+  static Ort::FrameGeometry computeFrameGeometry(
+    int width, int height, int shortSide = DEFAULT_SHORT_SIDE);
+  /*! \brief A Mutator function that crops every detection of a P2/P3 result
+  *   from its input image and classifies all crops with the cascade P1 Ort
+  *   Session in one batched run, with the inference parameters of config.
+  *   Populates cascadeNames of the result.
+  */
+  void classifyDetections(
+    const cv::Mat & img,
+    const EPD::InferenceConfig & config,
+    EPD::EPDObjectDetection & result);
+  /*! \brief A Getter function that gets the Ort Session of type Session, so
+  *   that callers specialized on a precision level reach their session without
+  *   a runtime switch.
+  */
+  template<typename Session>
+  Session * getSession();
 
 private:
   /*! \brief A boolean to indicate that OrtBase object has been initialized.*/
-  bool hasInitialized;
+  std::atomic<bool> hasInitialized;
+  /*! \brief The flag that runs initialize once and only once.*/
+  std::once_flag initFlag;
   /*! \brief A boolean to determine the type of final user output.*/
   bool onlyVisualize;
+  /*! \brief A boolean to indicate that detections are classified by a
+  * second P1 Ort Session.*/
+  bool hasCascade;
   /*! \brief Expected dimensions of the data provided by an input camera.*/
   int frame_width, frame_height;
+  /*! \brief The time each startup phase took, in ms.*/
+  std::array<double, NUM_STARTUP_PHASES> startupPhaseMs;
+
+  /*! \brief A Mutator function that runs function and records its duration
+  *  as the time of a startup phase.
+  */
+  template<typename Function>
+  void timeStartupPhase(StartupPhase phase, Function function);
 
   /*! \brief A Mutator function that parses the session_config.txt file.*/
   void setModelConfigFile();
@@ -119,8 +232,19 @@ private:
   *  the variable, classNames.
   */
   void setLabelList();
+  /*! \brief A Mutator function that parses the optional cascade_config.txt
+  *  file and its P1 label list into the variable, cascadeClassNames.
+  */
+  void setCascadeConfigFile();
 };
 
+template<>
+inline Ort::P1OrtBase * EPDContainer::getSession<Ort::P1OrtBase>() {return p1_ort_session.get();}
+template<>
+inline Ort::P2OrtBase * EPDContainer::getSession<Ort::P2OrtBase>() {return p2_ort_session.get();}
+template<>
+inline Ort::P3OrtBase * EPDContainer::getSession<Ort::P3OrtBase>() {return p3_ort_session.get();}
+
 }  // namespace EPD
 
 #endif  // EPD_UTILS_LIB__EPD_CONTAINER_HPP_
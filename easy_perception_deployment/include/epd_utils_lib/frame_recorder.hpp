@@ -0,0 +1,125 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef EPD_UTILS_LIB__FRAME_RECORDER_HPP_
+#define EPD_UTILS_LIB__FRAME_RECORDER_HPP_
+
+#include <memory>
+#include <string>
+
+#include "rclcpp/rclcpp.hpp"
+#include "std_msgs/msg/string.hpp"
+#include "sensor_msgs/msg/image.hpp"
+
+#include "epd_utils_lib/frame_recording.hpp"
+
+/*! \class FrameRecorder
+    \brief A FrameRecorder class object.
+    The FrameRecorder class object inherits from the rclcpp::Node object to
+    append every frame sent to the processor into a frame recording, which
+    FrameReplayer can later play back without a camera.
+*/
+class FrameRecorder : public rclcpp::Node
+{
+public:
+  /*! \brief A Constructor function*/
+  FrameRecorder();
+  /*! \brief A Destructor function that reports the frames recorded.*/
+  ~FrameRecorder();
+
+private:
+  /*! \brief The recording frames are appended to.*/
+  std::unique_ptr<EPD::FrameRecordWriter> writer_;
+  /*! \brief The number of frames after which recording stops, or 0 to never
+  stop.*/
+  uint64_t max_frames_;
+  /*! \brief A subscriber member variable to receive images to record.*/
+  rclcpp::Subscription<sensor_msgs::msg::Image>::SharedPtr image_sub_;
+  /*! \brief A subscriber member variable to receive remote calls to shutdown.*/
+  rclcpp::Subscription<std_msgs::msg::String>::SharedPtr state_sub_;
+  /*! \brief A ROS2 callback function utilized by image_sub_.*/
+  void image_callback(const sensor_msgs::msg::Image::SharedPtr msg);
+  /*! \brief A ROS2 callback function utilized by state_sub_.*/
+  void state_callback(const std_msgs::msg::String::SharedPtr msg) const;
+};
+
+FrameRecorder::FrameRecorder()
+: Node("frame_recorder")
+{
+  const std::string input_topic =
+    this->declare_parameter("input_topic", std::string("/processor/image_input"));
+  const std::string output = this->declare_parameter("output", std::string("epd_recording.bin"));
+  max_frames_ = this->declare_parameter("max_frames", 0);
+
+  writer_ = std::make_unique<EPD::FrameRecordWriter>(output);
+  RCLCPP_INFO(this->get_logger(), "Recording %s into %s",
+    input_topic.c_str(), output.c_str());
+
+  image_sub_ = this->create_subscription<sensor_msgs::msg::Image>(
+    input_topic,
+    10,
+    std::bind(&FrameRecorder::image_callback, this, std::placeholders::_1));
+
+  state_sub_ = this->create_subscription<std_msgs::msg::String>(
+    "/frame_recorder/state_input",
+    10,
+    std::bind(&FrameRecorder::state_callback, this, std::placeholders::_1));
+}
+
+FrameRecorder::~FrameRecorder()
+{
+  RCLCPP_INFO(this->get_logger(), "Recorded %zu frames, %zu bytes.",
+    static_cast<size_t>(writer_->getNumFrames()), writer_->getSize());
+}
+
+void FrameRecorder::image_callback(const sensor_msgs::msg::Image::SharedPtr msg)
+{
+  if (max_frames_ > 0 && writer_->getNumFrames() >= max_frames_) {
+    return;
+  }
+  if (msg->data.size() < static_cast<size_t>(msg->step) * msg->height) {
+    RCLCPP_WARN(this->get_logger(), "Skipped a frame with missing image data.");
+    return;
+  }
+
+  try {
+    writer_->append(
+      rclcpp::Time(msg->header.stamp).nanoseconds(),
+      this->now().nanoseconds(),
+      msg->width, msg->height, msg->step,
+      msg->encoding, msg->data.data());
+  } catch (const std::runtime_error & e) {
+    RCLCPP_ERROR(this->get_logger(), "%s", e.what());
+    return;
+  }
+
+  if (max_frames_ > 0 && writer_->getNumFrames() == max_frames_) {
+    RCLCPP_INFO(this->get_logger(), "Recorded the maximum of %zu frames.",
+      static_cast<size_t>(max_frames_));
+  }
+}
+
+void FrameRecorder::state_callback(const std_msgs::msg::String::SharedPtr msg) const
+{
+  std::string requested_state = msg->data.c_str();
+
+  if (requested_state.compare("shutdown") == 0) {
+    rclcpp::shutdown();
+  } else {
+    RCLCPP_WARN(this->get_logger(), "Invalid state requested.");
+  }
+}
+
+#endif  // EPD_UTILS_LIB__FRAME_RECORDER_HPP_
@@ -0,0 +1,389 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef EPD_UTILS_LIB__FRAME_RECORDING_HPP_
+#define EPD_UTILS_LIB__FRAME_RECORDING_HPP_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+/*! \brief An append-only recording of image frames, used to replay the load
+of a live camera without one.\n
+A recording is a pair of files. The data file starts with a
+FrameRecordingHeader, followed by one FrameRecordHeader and the pixel data of
+every frame, each aligned to 64 bytes. The index file, at the path of the data
+file with ".idx" appended, holds one FrameIndexEntry per frame and is only
+appended to once a frame is completely written, so a recording cut short by a
+crash still reads back up to its last indexed frame.
+ */
+namespace EPD
+{
+/*! \brief The identifier written at the start of every recording.*/
+const uint32_t FRAME_RECORDING_MAGIC = 0x45504446;  // "EPDF"
+/*! \brief The version of the recording layout.*/
+const uint32_t FRAME_RECORDING_VERSION = 1;
+/*! \brief The longest image encoding name a recording stores.*/
+const size_t FRAME_ENCODING_SIZE = 32;
+
+/*! \brief The layout at the start of a recording data file.*/
+struct FrameRecordingHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint8_t reserved[56];
+};
+
+/*! \brief The layout in front of the pixel data of every recorded frame.*/
+struct FrameRecordHeader
+{
+  /*! \brief The stamp of the frame header, in nanoseconds.*/
+  int64_t stampNs;
+  /*! \brief The time the frame was received by the recorder, in nanoseconds.*/
+  int64_t receiveNs;
+  uint32_t width;
+  uint32_t height;
+  uint32_t step;
+  uint32_t dataSize;
+  char encoding[FRAME_ENCODING_SIZE];
+};
+
+/*! \brief The layout of every entry of a recording index file.*/
+struct FrameIndexEntry
+{
+  /*! \brief The byte offset of the FrameRecordHeader in the data file.*/
+  uint64_t offset;
+  /*! \brief The time the frame was received by the recorder, in nanoseconds.*/
+  int64_t receiveNs;
+};
+
+/*! \brief A Getter function that rounds a size up to the 64-byte alignment of
+recorded frames.*/
+inline size_t alignFrameRecord(size_t size)
+{
+  return (size + 63) / 64 * 64;
+}
+
+/*! \brief A recorded frame, pointing into a mapped recording.*/
+struct FrameView
+{
+  int64_t stampNs;
+  int64_t receiveNs;
+  uint32_t width;
+  uint32_t height;
+  uint32_t step;
+  std::string encoding;
+  const uint8_t * data;
+  size_t dataSize;
+};
+
+/*! \class FrameRecordWriter
+    \brief A producer of a frame recording.
+    The FrameRecordWriter class object creates a recording and appends frames
+    to it through a memory mapping of the data file, which grows in steps of
+    growBytes.
+*/
+class FrameRecordWriter
+{
+public:
+  /*! \brief A Constructor function that creates, or overwrites, the recording
+  at path.*/
+  explicit FrameRecordWriter(const std::string & path, size_t growBytes = 64 << 20)
+  : m_path(path),
+    m_growBytes(alignFrameRecord(std::max<size_t>(growBytes, 4096))),
+    m_capacity(0),
+    m_used(sizeof(FrameRecordingHeader)),
+    m_numFrames(0),
+    m_base(nullptr)
+  {
+    m_dataFd = open(m_path.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0644);
+    if (m_dataFd < 0) {
+      throw std::runtime_error("Unable to create recording " + m_path);
+    }
+    m_indexFd = open((m_path + ".idx").c_str(), O_CREAT | O_TRUNC | O_WRONLY | O_APPEND, 0644);
+    if (m_indexFd < 0) {
+      close(m_dataFd);
+      throw std::runtime_error("Unable to create recording index " + m_path + ".idx");
+    }
+    try {
+      this->reserve(m_used);
+    } catch (const std::runtime_error &) {
+      close(m_dataFd);
+      close(m_indexFd);
+      throw;
+    }
+
+    FrameRecordingHeader * header = reinterpret_cast<FrameRecordingHeader *>(m_base);
+    memset(header, 0, sizeof(FrameRecordingHeader));
+    header->magic = FRAME_RECORDING_MAGIC;
+    header->version = FRAME_RECORDING_VERSION;
+  }
+
+  /*! \brief A Destructor function that unmaps the data file and trims it to
+  the frames written.*/
+  ~FrameRecordWriter()
+  {
+    munmap(m_base, m_capacity);
+    // Should this fail, the bytes past the last indexed frame are never read.
+    const int result = ftruncate(m_dataFd, m_used);
+    static_cast<void>(result);
+    close(m_dataFd);
+    close(m_indexFd);
+  }
+
+  FrameRecordWriter(const FrameRecordWriter &) = delete;
+  FrameRecordWriter & operator=(const FrameRecordWriter &) = delete;
+
+  /*! \brief A Mutator function that appends a frame of height rows of step
+  bytes each. Returns the index of the frame.*/
+  uint64_t append(
+    int64_t stampNs,
+    int64_t receiveNs,
+    uint32_t width,
+    uint32_t height,
+    uint32_t step,
+    const std::string & encoding,
+    const uint8_t * data)
+  {
+    if (encoding.size() >= FRAME_ENCODING_SIZE) {
+      throw std::runtime_error("Unsupported image encoding " + encoding);
+    }
+    const size_t dataSize = static_cast<size_t>(step) * height;
+    if (dataSize > UINT32_MAX) {
+      throw std::runtime_error("Frame exceeds the recording frame size limit.");
+    }
+    const size_t offset = m_used;
+    this->reserve(offset + alignFrameRecord(sizeof(FrameRecordHeader) + dataSize));
+
+    FrameRecordHeader * header = reinterpret_cast<FrameRecordHeader *>(m_base + offset);
+    memset(header, 0, sizeof(FrameRecordHeader));
+    header->stampNs = stampNs;
+    header->receiveNs = receiveNs;
+    header->width = width;
+    header->height = height;
+    header->step = step;
+    header->dataSize = static_cast<uint32_t>(dataSize);
+    memcpy(header->encoding, encoding.c_str(), encoding.size());
+    memcpy(m_base + offset + sizeof(FrameRecordHeader), data, dataSize);
+    m_used = offset + alignFrameRecord(sizeof(FrameRecordHeader) + dataSize);
+
+    const FrameIndexEntry entry {offset, receiveNs};
+    if (::write(m_indexFd, &entry, sizeof(entry)) != static_cast<ssize_t>(sizeof(entry))) {
+      throw std::runtime_error("Unable to write recording index " + m_path + ".idx");
+    }
+    return m_numFrames++;
+  }
+
+  /*! \brief A Getter function that gets the number of frames appended.*/
+  uint64_t getNumFrames() const {return m_numFrames;}
+
+  /*! \brief A Getter function that gets the number of bytes of the data file
+  in use.*/
+  size_t getSize() const {return m_used;}
+
+private:
+  /*! \brief The path of the data file.*/
+  std::string m_path;
+  /*! \brief The step the data file grows in, in bytes.*/
+  const size_t m_growBytes;
+  /*! \brief The size of the data file and its mapping, in bytes.*/
+  size_t m_capacity;
+  /*! \brief The number of bytes of the data file in use.*/
+  size_t m_used;
+  /*! \brief The number of frames appended.*/
+  uint64_t m_numFrames;
+  /*! \brief The file descriptors of the data and index files.*/
+  int m_dataFd, m_indexFd;
+  /*! \brief The start of the mapping of the data file.*/
+  uint8_t * m_base;
+
+  /*! \brief A Mutator function that grows the data file and its mapping to
+  hold at least size bytes.*/
+  void reserve(size_t size)
+  {
+    if (size <= m_capacity) {
+      return;
+    }
+    const size_t capacity = (size + m_growBytes - 1) / m_growBytes * m_growBytes;
+    if (ftruncate(m_dataFd, capacity) != 0) {
+      throw std::runtime_error("Unable to grow recording " + m_path);
+    }
+    if (m_base != nullptr) {
+      munmap(m_base, m_capacity);
+      m_base = nullptr;
+      m_capacity = 0;
+    }
+    void * addr = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_dataFd, 0);
+    if (addr == MAP_FAILED) {
+      throw std::runtime_error("Unable to map recording " + m_path);
+    }
+    m_base = static_cast<uint8_t *>(addr);
+    m_capacity = capacity;
+  }
+};
+
+/*! \class FrameRecordReader
+    \brief A consumer of a frame recording.
+    The FrameRecordReader class object maps a recording read-only and gets its
+    frames without copying them.
+*/
+class FrameRecordReader
+{
+public:
+  /*! \brief A Constructor function that maps the recording at path.*/
+  explicit FrameRecordReader(const std::string & path)
+  : m_dataSize(0), m_indexSize(0), m_data(nullptr), m_index(nullptr), m_numFrames(0)
+  {
+    m_data = static_cast<const uint8_t *>(mapFile(path, m_dataSize));
+    const FrameRecordingHeader * header =
+      reinterpret_cast<const FrameRecordingHeader *>(m_data);
+    if (m_dataSize < sizeof(FrameRecordingHeader) ||
+      header->magic != FRAME_RECORDING_MAGIC || header->version != FRAME_RECORDING_VERSION)
+    {
+      unmap();
+      throw std::runtime_error("Invalid recording " + path);
+    }
+
+    try {
+      m_index = static_cast<const FrameIndexEntry *>(mapFile(path + ".idx", m_indexSize));
+    } catch (const std::runtime_error &) {
+      unmap();
+      throw;
+    }
+
+    // Only count the frames that are indexed and fully inside the data file.
+    const size_t numEntries = m_indexSize / sizeof(FrameIndexEntry);
+    while (m_numFrames < numEntries && isComplete(m_index[m_numFrames])) {
+      ++m_numFrames;
+    }
+  }
+
+  /*! \brief A Destructor function that unmaps the recording.*/
+  ~FrameRecordReader()
+  {
+    unmap();
+  }
+
+  FrameRecordReader(const FrameRecordReader &) = delete;
+  FrameRecordReader & operator=(const FrameRecordReader &) = delete;
+
+  /*! \brief A Getter function that gets the number of complete frames.*/
+  size_t getNumFrames() const {return m_numFrames;}
+
+  /*! \brief A Getter function that gets the receive time of a frame without
+  touching its pixel data.*/
+  int64_t getReceiveNs(size_t idx) const
+  {
+    if (idx >= m_numFrames) {
+      throw std::out_of_range("Frame index out of range.");
+    }
+    return m_index[idx].receiveNs;
+  }
+
+  /*! \brief A Getter function that gets a frame. Its data points into the
+  mapping and stays valid as long as the FrameRecordReader does.*/
+  FrameView getFrame(size_t idx) const
+  {
+    if (idx >= m_numFrames) {
+      throw std::out_of_range("Frame index out of range.");
+    }
+    const FrameRecordHeader * header =
+      reinterpret_cast<const FrameRecordHeader *>(m_data + m_index[idx].offset);
+
+    FrameView frame;
+    frame.stampNs = header->stampNs;
+    frame.receiveNs = header->receiveNs;
+    frame.width = header->width;
+    frame.height = header->height;
+    frame.step = header->step;
+    frame.encoding = std::string(header->encoding,
+        strnlen(header->encoding, FRAME_ENCODING_SIZE));
+    frame.data = reinterpret_cast<const uint8_t *>(header) + sizeof(FrameRecordHeader);
+    frame.dataSize = header->dataSize;
+    return frame;
+  }
+
+private:
+  /*! \brief The sizes of the data and index mappings in bytes.*/
+  size_t m_dataSize, m_indexSize;
+  /*! \brief The start of the data mapping.*/
+  const uint8_t * m_data;
+  /*! \brief The start of the index mapping.*/
+  const FrameIndexEntry * m_index;
+  /*! \brief The number of complete frames.*/
+  size_t m_numFrames;
+
+  bool isComplete(const FrameIndexEntry & entry) const
+  {
+    if (entry.offset < sizeof(FrameRecordingHeader) ||
+      entry.offset + sizeof(FrameRecordHeader) > m_dataSize)
+    {
+      return false;
+    }
+    const FrameRecordHeader * header =
+      reinterpret_cast<const FrameRecordHeader *>(m_data + entry.offset);
+    return header->dataSize == static_cast<uint64_t>(header->step) * header->height &&
+           entry.offset + sizeof(FrameRecordHeader) + header->dataSize <= m_dataSize;
+  }
+
+  /*! \brief A Mutator function that maps a whole file read-only. An empty
+  file is not mapped.*/
+  static const void * mapFile(const std::string & path, size_t & size)
+  {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("Unable to open recording " + path);
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0) {
+      close(fd);
+      throw std::runtime_error("Unable to open recording " + path);
+    }
+    size = fileStat.st_size;
+    if (size == 0) {
+      close(fd);
+      return nullptr;
+    }
+    void * addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+      throw std::runtime_error("Unable to map recording " + path);
+    }
+    return addr;
+  }
+
+  void unmap()
+  {
+    if (m_data != nullptr) {
+      munmap(const_cast<uint8_t *>(m_data), m_dataSize);
+      m_data = nullptr;
+    }
+    if (m_index != nullptr) {
+      munmap(const_cast<FrameIndexEntry *>(m_index), m_indexSize);
+      m_index = nullptr;
+    }
+  }
+};
+
+}  // namespace EPD
+
+#endif  // EPD_UTILS_LIB__FRAME_RECORDING_HPP_
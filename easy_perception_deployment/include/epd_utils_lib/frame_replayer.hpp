@@ -0,0 +1,246 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef EPD_UTILS_LIB__FRAME_REPLAYER_HPP_
+#define EPD_UTILS_LIB__FRAME_REPLAYER_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "rclcpp/rclcpp.hpp"
+#include "sensor_msgs/msg/image.hpp"
+#include "epd_msgs/msg/epd_image_classification.hpp"
+#include "epd_msgs/msg/epd_object_detection.hpp"
+
+#include "epd_utils_lib/frame_recording.hpp"
+
+/*! \class FrameReplayer
+    \brief A FrameReplayer class object.
+    The FrameReplayer class object inherits from the rclcpp::Node object to
+    publish the frames of a frame recording into the processor, either at
+    their recorded timing, at a fixed rate or as fast as possible. It counts
+    the processor outputs to report the achieved throughput and the frames
+    the processor dropped, then shuts down.
+*/
+class FrameReplayer : public rclcpp::Node
+{
+public:
+  /*! \brief A Constructor function that starts replaying.*/
+  FrameReplayer();
+  /*! \brief A Destructor function that stops replaying.*/
+  ~FrameReplayer();
+
+private:
+  /*! \brief The ways frames are paced.*/
+  enum class ReplayMode {RECORDED, RATE, MAX};
+
+  /*! \brief The recording being replayed.*/
+  std::unique_ptr<EPD::FrameRecordReader> reader_;
+  ReplayMode mode_;
+  /*! \brief The rate of the RATE mode, in frames per second.*/
+  double rate_hz_;
+  /*! \brief The factor the RECORDED mode speeds up the recorded timing by.*/
+  double speed_;
+  /*! \brief The number of times the recording is replayed.*/
+  int loops_;
+  /*! \brief The time waited for the last processor outputs after the last
+  frame is published.*/
+  std::chrono::milliseconds drain_timeout_;
+
+  /*! \brief The number of processor outputs received.*/
+  std::atomic<uint64_t> num_processed_;
+  /*! \brief The time the last processor output was received.*/
+  std::atomic<int64_t> last_processed_ns_;
+  std::atomic<bool> stop_;
+  std::thread replay_thread_;
+
+  rclcpp::Publisher<sensor_msgs::msg::Image>::SharedPtr image_pub_;
+  /*! \brief Subscribers to every output of the processor.*/
+  rclcpp::Subscription<sensor_msgs::msg::Image>::SharedPtr visual_sub_;
+  rclcpp::Subscription<epd_msgs::msg::EPDImageClassification>::SharedPtr p1_sub_;
+  rclcpp::Subscription<epd_msgs::msg::EPDObjectDetection>::SharedPtr p2_sub_;
+  rclcpp::Subscription<epd_msgs::msg::EPDObjectDetection>::SharedPtr p3_sub_;
+
+  /*! \brief A Getter function that gets the time on the clock replay is
+  paced with, in nanoseconds.*/
+  static int64_t now_ns()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+  /*! \brief A ROS2 callback function utilized by every output subscriber.*/
+  void output_callback();
+  /*! \brief A Mutator function that publishes every frame on time, reports
+  the results and shuts down. Runs on replay_thread_.*/
+  void replay();
+};
+
+FrameReplayer::FrameReplayer()
+: Node("frame_replayer"),
+  num_processed_(0),
+  last_processed_ns_(0),
+  stop_(false)
+{
+  const std::string recording =
+    this->declare_parameter("recording", std::string("epd_recording.bin"));
+  const std::string mode = this->declare_parameter("mode", std::string("recorded"));
+  rate_hz_ = this->declare_parameter("rate_hz", 30.0);
+  speed_ = this->declare_parameter("speed", 1.0);
+  loops_ = this->declare_parameter("loops", 1);
+  drain_timeout_ = std::chrono::milliseconds(this->declare_parameter("drain_timeout_ms", 1000));
+  const std::string output_topic =
+    this->declare_parameter("output_topic", std::string("/processor/image_input"));
+  const std::string processor_namespace =
+    this->declare_parameter("processor_namespace", std::string("/processor"));
+
+  if (mode == "recorded") {
+    mode_ = ReplayMode::RECORDED;
+  } else if (mode == "rate") {
+    mode_ = ReplayMode::RATE;
+  } else if (mode == "max") {
+    mode_ = ReplayMode::MAX;
+  } else {
+    throw std::runtime_error("Invalid replay mode " + mode + ". Use recorded, rate or max.");
+  }
+  if ((mode_ == ReplayMode::RATE && rate_hz_ <= 0.0) ||
+    (mode_ == ReplayMode::RECORDED && speed_ <= 0.0))
+  {
+    throw std::runtime_error("Replay rate_hz and speed must be positive.");
+  }
+
+  reader_ = std::make_unique<EPD::FrameRecordReader>(recording);
+  RCLCPP_INFO(this->get_logger(), "Replaying %zu frames of %s in %s mode.",
+    reader_->getNumFrames(), recording.c_str(), mode.c_str());
+
+  image_pub_ = this->create_publisher<sensor_msgs::msg::Image>(output_topic, 10);
+
+  visual_sub_ = this->create_subscription<sensor_msgs::msg::Image>(
+    processor_namespace + "/output", 10,
+    [this](const sensor_msgs::msg::Image::SharedPtr) {this->output_callback();});
+  p1_sub_ = this->create_subscription<epd_msgs::msg::EPDImageClassification>(
+    processor_namespace + "/epd_p1_output", 10,
+    [this](const epd_msgs::msg::EPDImageClassification::SharedPtr) {this->output_callback();});
+  p2_sub_ = this->create_subscription<epd_msgs::msg::EPDObjectDetection>(
+    processor_namespace + "/epd_p2_output", 10,
+    [this](const epd_msgs::msg::EPDObjectDetection::SharedPtr) {this->output_callback();});
+  p3_sub_ = this->create_subscription<epd_msgs::msg::EPDObjectDetection>(
+    processor_namespace + "/epd_p3_output", 10,
+    [this](const epd_msgs::msg::EPDObjectDetection::SharedPtr) {this->output_callback();});
+
+  replay_thread_ = std::thread(&FrameReplayer::replay, this);
+}
+
+FrameReplayer::~FrameReplayer()
+{
+  stop_ = true;
+  if (replay_thread_.joinable()) {
+    replay_thread_.join();
+  }
+}
+
+void FrameReplayer::output_callback()
+{
+  ++num_processed_;
+  last_processed_ns_ = now_ns();
+}
+
+void FrameReplayer::replay()
+{
+  const size_t num_frames = reader_->getNumFrames();
+  if (num_frames == 0) {
+    RCLCPP_WARN(this->get_logger(), "The recording holds no frames.");
+    rclcpp::shutdown();
+    return;
+  }
+
+  // Give the processor time to discover this publisher.
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+
+  const int64_t first_receive_ns = reader_->getReceiveNs(0);
+  // A loop of the recording lasts one average frame gap longer than its span.
+  const int64_t recorded_span_ns = reader_->getReceiveNs(num_frames - 1) - first_receive_ns;
+  const int64_t loop_ns = num_frames > 1 ?
+    recorded_span_ns + recorded_span_ns / static_cast<int64_t>(num_frames - 1) : 0;
+
+  uint64_t num_published = 0;
+  double total_lag_ms = 0.0, max_lag_ms = 0.0;
+  const int64_t start_ns = now_ns();
+
+  for (int loop = 0; loop < loops_ && !stop_; ++loop) {
+    for (size_t i = 0; i < num_frames && !stop_; ++i) {
+      int64_t target_ns = start_ns;
+      if (mode_ == ReplayMode::RECORDED) {
+        target_ns += static_cast<int64_t>(
+          (loop * loop_ns + reader_->getReceiveNs(i) - first_receive_ns) / speed_);
+      } else if (mode_ == ReplayMode::RATE) {
+        target_ns += static_cast<int64_t>(num_published * 1e9 / rate_hz_);
+      }
+
+      if (mode_ != ReplayMode::MAX) {
+        const int64_t wait_ns = target_ns - now_ns();
+        if (wait_ns > 0) {
+          std::this_thread::sleep_for(std::chrono::nanoseconds(wait_ns));
+        }
+        const double lag_ms = (now_ns() - target_ns) / 1e6;
+        total_lag_ms += lag_ms;
+        max_lag_ms = std::max(max_lag_ms, lag_ms);
+      }
+
+      const EPD::FrameView frame = reader_->getFrame(i);
+      auto msg = std::make_unique<sensor_msgs::msg::Image>();
+      msg->header.stamp = this->now();
+      msg->header.frame_id = "frame_replayer";
+      msg->width = frame.width;
+      msg->height = frame.height;
+      msg->step = frame.step;
+      msg->encoding = frame.encoding;
+      msg->data.assign(frame.data, frame.data + frame.dataSize);
+      image_pub_->publish(std::move(msg));
+      ++num_published;
+    }
+  }
+  const int64_t publish_end_ns = now_ns();
+
+  // Wait until no more outputs arrive or every frame is accounted for.
+  while (!stop_ && num_processed_ < num_published &&
+    std::chrono::nanoseconds(now_ns() - std::max(publish_end_ns, last_processed_ns_.load())) <
+    drain_timeout_)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  const uint64_t num_processed = std::min<uint64_t>(num_processed_, num_published);
+  const double publish_sec = (publish_end_ns - start_ns) / 1e9;
+  const double process_sec = (std::max(publish_end_ns, last_processed_ns_.load()) - start_ns) / 1e9;
+
+  RCLCPP_INFO(this->get_logger(), "[-Replay-]= Published %zu frames in %.3f s (%.2f FPS).",
+    static_cast<size_t>(num_published), publish_sec, num_published / publish_sec);
+  if (mode_ != ReplayMode::MAX) {
+    RCLCPP_INFO(this->get_logger(), "[-Replay-]= Schedule lag mean %.3f ms, max %.3f ms.",
+      total_lag_ms / num_published, max_lag_ms);
+  }
+  RCLCPP_INFO(this->get_logger(), "[-Replay-]= Processed %zu frames (%.2f FPS), dropped %zu.",
+    static_cast<size_t>(num_processed), num_processed / process_sec,
+    static_cast<size_t>(num_published - num_processed));
+
+  rclcpp::shutdown();
+}
+
+#endif  // EPD_UTILS_LIB__FRAME_REPLAYER_HPP_
@@ -0,0 +1,120 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef EPD_UTILS_LIB__IMAGE_DECODE_HPP_
+#define EPD_UTILS_LIB__IMAGE_DECODE_HPP_
+
+#include <cstdint>
+#include <vector>
+#include "opencv2/opencv.hpp"
+
+/*! \brief A collection of helpers for decoding compressed input images,
+namely for decoding JPEG images directly at a reduced size using the
+DCT-domain scaling of libjpeg.
+ */
+namespace EPD
+{
+/*! \brief A Getter function that reads the frame dimensions from the start of
+frame (SOFn) marker of a JPEG bitstream without decoding it.\n
+Returns false if the data is not a JPEG bitstream.
+*/
+inline bool readJpegDimensions(
+  const std::vector<uint8_t> & data,
+  int & width,
+  int & height)
+{
+  if (data.size() < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+    return false;
+  }
+
+  size_t i = 2;
+  while (i + 3 < data.size()) {
+    if (data[i] != 0xFF) {
+      return false;
+    }
+    const uint8_t marker = data[i + 1];
+    // Skip fill bytes.
+    if (marker == 0xFF) {
+      i++;
+      continue;
+    }
+    // Standalone markers have no length field.
+    if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) {
+      i += 2;
+      continue;
+    }
+    // Image data starts without any SOFn marker found.
+    if (marker == 0xDA || marker == 0xD9) {
+      return false;
+    }
+
+    const size_t segmentLength = (data[i + 2] << 8) | data[i + 3];
+    // SOF0 to SOF15, except DHT, JPG and DAC which share the same range.
+    if (marker >= 0xC0 && marker <= 0xCF &&
+      marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+    {
+      if (i + 8 >= data.size()) {
+        return false;
+      }
+      height = (data[i + 5] << 8) | data[i + 6];
+      width = (data[i + 7] << 8) | data[i + 8];
+      return width > 0 && height > 0;
+    }
+    i += 2 + segmentLength;
+  }
+  return false;
+}
+
+/*! \brief A Getter function that selects the largest libjpeg scale denominator,
+out of 1, 2, 4 and 8, whose decoded frame still covers the target dimensions.
+*/
+inline int selectJpegScale(int width, int height, int targetW, int targetH)
+{
+  int scale = 1;
+  for (int candidate : {2, 4, 8}) {
+    // libjpeg rounds the scaled dimensions up.
+    if ((width + candidate - 1) / candidate >= targetW &&
+      (height + candidate - 1) / candidate >= targetH)
+    {
+      scale = candidate;
+    }
+  }
+  return scale;
+}
+
+/*! \brief A Mutator function that decodes a compressed image into a BGR image.
+JPEG images are decoded directly at 1/scale of their full dimensions, while
+other formats are always decoded at full dimensions.
+*/
+inline cv::Mat decodeImage(const std::vector<uint8_t> & data, int scale)
+{
+  int flags = cv::IMREAD_COLOR;
+  switch (scale) {
+    case 2:
+      flags = cv::IMREAD_REDUCED_COLOR_2;
+      break;
+    case 4:
+      flags = cv::IMREAD_REDUCED_COLOR_4;
+      break;
+    case 8:
+      flags = cv::IMREAD_REDUCED_COLOR_8;
+      break;
+  }
+  return cv::imdecode(data, flags);
+}
+
+}  // namespace EPD
+
+#endif  // EPD_UTILS_LIB__IMAGE_DECODE_HPP_
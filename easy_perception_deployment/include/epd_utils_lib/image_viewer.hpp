@@ -16,50 +16,183 @@
 #ifndef EPD_UTILS_LIB__IMAGE_VIEWER_HPP_
 #define EPD_UTILS_LIB__IMAGE_VIEWER_HPP_
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
 #include <vector>
 #include <string>
 #include <memory>
+#include <thread>
 
 #include "cv_bridge/cv_bridge.h"
 #include "rclcpp/rclcpp.hpp"
 #include "std_msgs/msg/string.hpp"
 #include "sensor_msgs/msg/image.hpp"
+#include "epd_msgs/msg/epd_image_classification.hpp"
+#include "epd_msgs/msg/epd_label_table.hpp"
+#include "epd_msgs/msg/epd_object_detection.hpp"
 
 #include "opencv2/opencv.hpp"
 
+#include "epd_utils_lib/stamp_matcher.hpp"
+
 /*! \class ImageViewer
     \brief An ImageViewer class object.
     The ImageViewer class object inherits from the rclcpp::Node object to
     provide a localized way of viewing the output inference visualization
-    results.
+    results.\n
+    The window is owned by a display thread that shows the latest image
+    received at most max_display_rate times per second. The subscription only
+    hands images over to it, so a slow display drops images instead of backing
+    up the subscription queue.\n
+    With the overlay parameter set, the input images are raw frames instead.
+    Each frame is shown once the EPDImageClassification or EPDObjectDetection
+    result with the same header stamp is received, with its labels, bounding
+    boxes and masks drawn by the display thread. The Processor may then run
+    in robot mode and leave visualization to the viewers that need it. Class
+    indices are named by the label table the Processor latches, or else by
+    the class_names_path file.
 */
 class ImageViewer : public rclcpp::Node
 {
 public:
   /*! \brief A Constructor function*/
   ImageViewer();
+  /*! \brief A Destructor function that stops the display thread.*/
+  ~ImageViewer();
 
 private:
+  /*! \brief The inference result of a frame to draw over it. Only one of
+  its members is set.*/
+  struct OverlayResult
+  {
+    epd_msgs::msg::EPDImageClassification::ConstSharedPtr classification;
+    epd_msgs::msg::EPDObjectDetection::ConstSharedPtr detection;
+  };
+  typedef EPD::StampMatcher<sensor_msgs::msg::Image, OverlayResult> OverlayMatcher;
+
   /*! \brief A subscriber member variable to receive images to receive.*/
   rclcpp::Subscription<sensor_msgs::msg::Image>::SharedPtr sub_1_;
   /*! \brief A subscriber member variable to receive remote calls to shutdown.*/
   rclcpp::Subscription<std_msgs::msg::String>::SharedPtr sub_2_;
-  /*! \brief A Mutator function that sets the appropriate image encodings for
-  displaying input images.
-  */
-  int encoding2mat_type(const std::string & encoding) const;
+  /*! \brief A subscriber member variable to receive P1 inference results to
+  overlay.*/
+  rclcpp::Subscription<epd_msgs::msg::EPDImageClassification>::SharedPtr sub_3_;
+  /*! \brief A subscriber member variable to receive P2 and P3 inference
+  results to overlay.*/
+  rclcpp::Subscription<epd_msgs::msg::EPDObjectDetection>::SharedPtr sub_4_;
+  /*! \brief A subscriber member variable to receive the class label list of
+  the model.*/
+  rclcpp::Subscription<epd_msgs::msg::EPDLabelTable>::SharedPtr sub_5_;
+  /*! \brief A boolean to indicate that input images are raw frames to draw
+  inference results over.*/
+  bool overlay_;
+  /*! \brief The class names of the model, indexed by class indices. Empty if
+  unknown. Replaced as a whole by sub_5_ and only accessed atomically, since
+  the display thread reads it.*/
+  std::shared_ptr<const std::vector<std::string>> class_names_;
+  /*! \brief The mask value above which a pixel belongs to the object.*/
+  double mask_threshold_;
+  /*! \brief The pairing of raw frames with their inference results. Only
+  touched by the subscription callbacks.*/
+  OverlayMatcher matcher_;
+  /*! \brief The longest time between two refreshes of the window.*/
+  std::chrono::duration<double> display_period_;
+  /*! \brief A mutex that guards latest_frame_ and latest_result_.*/
+  std::mutex frame_mutex_;
+  /*! \brief The latest image received and not shown yet, if any.*/
+  sensor_msgs::msg::Image::ConstSharedPtr latest_frame_;
+  /*! \brief The inference result of latest_frame_ to overlay, if any.*/
+  std::shared_ptr<const OverlayResult> latest_result_;
+  /*! \brief A boolean to indicate that the display thread should keep
+  running.*/
+  std::atomic<bool> running_;
+  /*! \brief The thread that owns the window.*/
+  std::thread display_thread_;
+
   /*! \brief A ROS2 callback function utilized by sub_1.*/
-  void image_callback(const sensor_msgs::msg::Image::SharedPtr msg) const;
+  void image_callback(const sensor_msgs::msg::Image::SharedPtr msg);
   /*! \brief A ROS2 callback function utilized by sub_2.*/
   void state_callback(const std_msgs::msg::String::SharedPtr msg) const;
+  /*! \brief A ROS2 callback function utilized by sub_3.*/
+  void classification_callback(const epd_msgs::msg::EPDImageClassification::SharedPtr msg);
+  /*! \brief A ROS2 callback function utilized by sub_4.*/
+  void detection_callback(const epd_msgs::msg::EPDObjectDetection::SharedPtr msg);
+  /*! \brief A ROS2 callback function utilized by sub_5.*/
+  void label_table_callback(const epd_msgs::msg::EPDLabelTable::SharedPtr msg);
+  /*! \brief A Getter function that gets the name of a class index from
+  class_names, or the index itself if it has none.*/
+  static std::string get_class_name(
+    const std::vector<std::string> & class_names,
+    uint64_t class_idx);
+  /*! \brief A Mutator function that pairs an inference result with the raw
+  frame of the same stamp.*/
+  void add_result(int64_t stamp_ns, std::shared_ptr<const OverlayResult> result);
+  /*! \brief A Mutator function that hands an image and its inference result,
+  if any, over to the display thread.*/
+  void hand_over(
+    sensor_msgs::msg::Image::ConstSharedPtr frame,
+    std::shared_ptr<const OverlayResult> result);
+  /*! \brief A Mutator function that runs on display_thread_ and shows the
+  latest image once per display period.*/
+  void display_loop(void);
+  /*! \brief A Mutator function that shows an image in the window, with its
+  inference result drawn over it if given. Its buffer is never written to.*/
+  void show_frame(
+    const sensor_msgs::msg::Image::ConstSharedPtr & msg,
+    const std::shared_ptr<const OverlayResult> & result,
+    cv::Mat & buffer);
+  /*! \brief A Mutator function that draws the object names of a P1 inference
+  result.*/
+  void draw_classification(
+    cv::Mat & img,
+    const epd_msgs::msg::EPDImageClassification & classification) const;
+  /*! \brief A Mutator function that draws the labels, bounding boxes and
+  masks of a P2 or P3 inference result.*/
+  void draw_detection(
+    cv::Mat & img,
+    const epd_msgs::msg::EPDObjectDetection::ConstSharedPtr & detection) const;
+  /*! \brief A Mutator function that draws a label with its top-left corner at
+  origin.*/
+  static void draw_label(
+    cv::Mat & img,
+    const std::string & label,
+    const cv::Point & origin,
+    const cv::Scalar & color);
 };
 
 ImageViewer::ImageViewer()
-: Node("image_viewer")
+: Node("image_viewer"),
+  overlay_(false),
+  mask_threshold_(0.5),
+  running_(true)
 {
-  cv::namedWindow("image_viewer", cv::WINDOW_AUTOSIZE);
-  cv::moveWindow("image_viewer", 0, 375);
-  cv::waitKey(1);
+  double max_display_rate = this->declare_parameter("max_display_rate", 30.0);
+  if (max_display_rate <= 0.0) {
+    RCLCPP_WARN(this->get_logger(), "Invalid max_display_rate. Using 30.");
+    max_display_rate = 30.0;
+  }
+  display_period_ = std::chrono::duration<double>(1.0 / max_display_rate);
+
+  overlay_ = this->declare_parameter("overlay", false);
+  mask_threshold_ = this->declare_parameter("mask_threshold", 0.5);
+  const std::string class_names_path =
+    this->declare_parameter("class_names_path", std::string(""));
+  auto class_names = std::make_shared<std::vector<std::string>>();
+  if (!class_names_path.empty()) {
+    std::ifstream infile(class_names_path);
+    if (!infile) {
+      RCLCPP_WARN(this->get_logger(), "Unable to open class names file %s.",
+        class_names_path.c_str());
+    }
+    std::string label;
+    while (std::getline(infile, label)) {
+      class_names->emplace_back(label);
+    }
+  }
+  class_names_ = class_names;
 
   size_t depth_ = rmw_qos_profile_default.depth;
   rmw_qos_history_policy_t history_policy_ = rmw_qos_profile_default.history;
@@ -74,43 +207,254 @@ ImageViewer::ImageViewer()
 
   sub_2_ = this->create_subscription<std_msgs::msg::String>("/image_viewer/state_input",
       qos, std::bind(&ImageViewer::state_callback, this, std::placeholders::_1));
+
+  if (overlay_) {
+    sub_3_ = this->create_subscription<epd_msgs::msg::EPDImageClassification>(
+      "/image_viewer/classification_input", qos,
+      std::bind(&ImageViewer::classification_callback, this, std::placeholders::_1));
+    sub_4_ = this->create_subscription<epd_msgs::msg::EPDObjectDetection>(
+      "/image_viewer/detection_input", qos,
+      std::bind(&ImageViewer::detection_callback, this, std::placeholders::_1));
+    // The label table is latched by the Processor.
+    sub_5_ = this->create_subscription<epd_msgs::msg::EPDLabelTable>(
+      "/image_viewer/label_table_input", rclcpp::QoS(1).transient_local(),
+      std::bind(&ImageViewer::label_table_callback, this, std::placeholders::_1));
+  }
+
+  display_thread_ = std::thread(&ImageViewer::display_loop, this);
 }
 
-int ImageViewer::encoding2mat_type(const std::string & encoding) const
-{
-  if (encoding == "mono8") {
-    return CV_8UC1;
-  } else if (encoding == "bgr8") {
-    return CV_8UC3;
-  } else if (encoding == "mono16") {
-    return CV_16SC1;
-  } else if (encoding == "rgba8") {
-    return CV_8UC4;
-  } else if (encoding == "bgra8") {
-    return CV_8UC4;
-  } else if (encoding == "32FC1") {
-    return CV_32FC1;
-  } else if (encoding == "rgb8") {
-    return CV_8UC3;
-  } else {
-    throw std::runtime_error("Unsupported encoding type");
+ImageViewer::~ImageViewer()
+{
+  running_ = false;
+  if (display_thread_.joinable()) {
+    display_thread_.join();
+  }
+}
+
+void ImageViewer::image_callback(const sensor_msgs::msg::Image::SharedPtr msg)
+{
+  if (!overlay_) {
+    this->hand_over(msg, nullptr);
+    return;
   }
+
+  // A raw frame waits for its inference result. Frames the Processor skipped
+  // never get one and are dropped once a later frame is matched.
+  OverlayMatcher::Match match;
+  if (matcher_.addFirst(rclcpp::Time(msg->header.stamp).nanoseconds(), msg, match)) {
+    this->hand_over(match.first, match.second);
+  }
+}
+
+void ImageViewer::classification_callback(
+  const epd_msgs::msg::EPDImageClassification::SharedPtr msg)
+{
+  auto result = std::make_shared<OverlayResult>();
+  result->classification = msg;
+  this->add_result(rclcpp::Time(msg->header.stamp).nanoseconds(), result);
 }
 
-void ImageViewer::image_callback(const sensor_msgs::msg::Image::SharedPtr msg) const
+void ImageViewer::detection_callback(const epd_msgs::msg::EPDObjectDetection::SharedPtr msg)
 {
-  cv::Mat frame(
-    msg->height, msg->width, this->encoding2mat_type(msg->encoding),
-    const_cast<unsigned char *>(msg->data.data()), msg->step);
+  auto result = std::make_shared<OverlayResult>();
+  result->detection = msg;
+  this->add_result(rclcpp::Time(msg->header.stamp).nanoseconds(), result);
+}
+
+void ImageViewer::label_table_callback(const epd_msgs::msg::EPDLabelTable::SharedPtr msg)
+{
+  std::atomic_store(&class_names_,
+    std::shared_ptr<const std::vector<std::string>>(msg, &msg->class_names));
+}
+
+std::string ImageViewer::get_class_name(
+  const std::vector<std::string> & class_names,
+  uint64_t class_idx)
+{
+  return class_idx < class_names.size() ? class_names[class_idx] : std::to_string(class_idx);
+}
+
+void ImageViewer::add_result(int64_t stamp_ns, std::shared_ptr<const OverlayResult> result)
+{
+  OverlayMatcher::Match match;
+  if (matcher_.addSecond(stamp_ns, std::move(result), match)) {
+    this->hand_over(match.first, match.second);
+  }
+}
+
+void ImageViewer::hand_over(
+  sensor_msgs::msg::Image::ConstSharedPtr frame,
+  std::shared_ptr<const OverlayResult> result)
+{
+  // Replaces any image the display thread has not shown yet.
+  std::lock_guard<std::mutex> lock(frame_mutex_);
+  latest_frame_ = std::move(frame);
+  latest_result_ = std::move(result);
+}
+
+void ImageViewer::display_loop()
+{
+  // HighGUI windows are only touched from this thread.
+  cv::namedWindow("image_viewer", cv::WINDOW_AUTOSIZE);
+  cv::moveWindow("image_viewer", 0, 375);
+
+  cv::Mat buffer;
+  auto next_refresh = std::chrono::steady_clock::now();
+  while (running_ && rclcpp::ok()) {
+    sensor_msgs::msg::Image::ConstSharedPtr msg;
+    std::shared_ptr<const OverlayResult> result;
+    {
+      std::lock_guard<std::mutex> lock(frame_mutex_);
+      msg.swap(latest_frame_);
+      result.swap(latest_result_);
+    }
+    if (msg) {
+      this->show_frame(msg, result, buffer);
+    }
+
+    // Wait out the rest of the period inside waitKey, which keeps the window
+    // responsive. A late refresh does not shorten the next period.
+    const auto now = std::chrono::steady_clock::now();
+    next_refresh = std::max(
+      next_refresh + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        display_period_), now);
+    const int wait_ms = static_cast<int>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(next_refresh - now).count());
+    cv::waitKey(std::max(wait_ms, 1));
+  }
+  cv::destroyWindow("image_viewer");
+}
+
+void ImageViewer::show_frame(
+  const sensor_msgs::msg::Image::ConstSharedPtr & msg,
+  const std::shared_ptr<const OverlayResult> & result,
+  cv::Mat & buffer)
+{
+  if (result) {
+    // The overlay is drawn on a copy, so the received image is never written
+    // to.
+    try {
+      buffer = cv_bridge::toCvCopy(msg, "bgr8")->image;
+    } catch (const cv_bridge::Exception & e) {
+      RCLCPP_WARN(this->get_logger(), "Unable to display image: %s", e.what());
+      return;
+    }
+    if (result->classification) {
+      this->draw_classification(buffer, *result->classification);
+    } else if (result->detection) {
+      this->draw_detection(buffer, result->detection);
+    }
+    cv::imshow("image_viewer", buffer);
+    return;
+  }
+
+  cv_bridge::CvImageConstPtr frame;
+  try {
+    frame = cv_bridge::toCvShare(msg);
+  } catch (const cv_bridge::Exception & e) {
+    RCLCPP_WARN(this->get_logger(), "Unable to display image: %s", e.what());
+    return;
+  }
 
   if (msg->encoding == "rgb8") {
-    cv::cvtColor(frame, frame, cv::COLOR_RGB2BGR);
+    cv::cvtColor(frame->image, buffer, cv::COLOR_RGB2BGR);
+    cv::imshow("image_viewer", buffer);
+  } else {
+    cv::imshow("image_viewer", frame->image);
   }
+}
 
-  cv::Mat cvframe = frame;
+void ImageViewer::draw_classification(
+  cv::Mat & img,
+  const epd_msgs::msg::EPDImageClassification & classification) const
+{
+  // Object names are optional, in which case the class indices are named
+  // here.
+  std::vector<std::string> names = classification.object_names;
+  if (names.empty()) {
+    const auto class_names = std::atomic_load(&class_names_);
+    for (const uint64_t class_idx : classification.class_indices) {
+      names.push_back(get_class_name(*class_names, class_idx));
+    }
+  }
+
+  int y = 0;
+  for (const auto & name : names) {
+    int baseLine = 0;
+    const cv::Size labelSize = cv::getTextSize(name, cv::FONT_HERSHEY_COMPLEX,
+        0.35, 1, &baseLine);
+    draw_label(img, name, cv::Point(0, y), cv::Scalar(255, 0, 0));
+    y += static_cast<int>(1.3 * labelSize.height);
+  }
+}
+
+void ImageViewer::draw_detection(
+  cv::Mat & img,
+  const epd_msgs::msg::EPDObjectDetection::ConstSharedPtr & detection) const
+{
+  // Matches the colors and layout of the visualization the Processor draws.
+  const cv::Scalar color(255.0, 0.0, 0.0, 0.0);
+  const cv::Rect imgRect(0, 0, img.cols, img.rows);
+  const auto class_names = std::atomic_load(&class_names_);
+
+  for (size_t i = 0; i < detection->bboxes.size(); ++i) {
+    const auto & roi = detection->bboxes[i];
+    const cv::Rect boxRect(roi.x_offset, roi.y_offset, roi.width, roi.height);
 
-  cv::imshow("image_viewer", cvframe);
-  cv::waitKey(1);
+    std::string label;
+    if (i < detection->cascade_object_names.size() &&
+      !detection->cascade_object_names[i].empty())
+    {
+      label = detection->cascade_object_names[i];
+    } else if (i < detection->class_indices.size()) {
+      label = get_class_name(*class_names, detection->class_indices[i]);
+    }
+
+    // Bounding boxes are rounded onto the frame, so they may cross its
+    // border by a pixel.
+    const cv::Rect visibleRect = boxRect & imgRect;
+    if (i < detection->masks.size() && visibleRect.area() > 0) {
+      cv::Mat curMask;
+      try {
+        cv::resize(cv_bridge::toCvShare(detection->masks[i], detection, "32FC1")->image,
+          curMask, boxRect.size());
+      } catch (const cv_bridge::Exception & e) {
+        RCLCPP_WARN(this->get_logger(), "Unable to draw mask: %s", e.what());
+        continue;
+      }
+      cv::Mat finalMask = (curMask(visibleRect - boxRect.tl()) > mask_threshold_);
+
+      cv::Mat coloredRoi = (0.3 * color + 0.7 * img(visibleRect));
+      coloredRoi.convertTo(coloredRoi, CV_8UC3);
+
+      std::vector<cv::Mat> contours;
+      cv::Mat hierarchy;
+      finalMask.convertTo(finalMask, CV_8U);
+      cv::findContours(finalMask, contours, hierarchy, cv::RETR_TREE, cv::CHAIN_APPROX_SIMPLE);
+      cv::drawContours(coloredRoi, contours, -1, color, 5, cv::LINE_8, hierarchy, 100);
+      coloredRoi.copyTo(img(visibleRect), finalMask);
+    }
+
+    cv::rectangle(img, boxRect.tl(), boxRect.br(), color, 2);
+    draw_label(img, label, boxRect.tl(), color);
+  }
+}
+
+void ImageViewer::draw_label(
+  cv::Mat & img,
+  const std::string & label,
+  const cv::Point & origin,
+  const cv::Scalar & color)
+{
+  int baseLine = 0;
+  const cv::Size labelSize = cv::getTextSize(label, cv::FONT_HERSHEY_COMPLEX,
+      0.35, 1, &baseLine);
+  cv::rectangle(img, origin,
+    cv::Point(origin.x + labelSize.width, origin.y + static_cast<int>(1.3 * labelSize.height)),
+    color, -1);
+  cv::putText(img, label, cv::Point(origin.x, origin.y + labelSize.height),
+    cv::FONT_HERSHEY_COMPLEX, 0.35, cv::Scalar(255, 255, 255));
 }
 
 void ImageViewer::state_callback(const std_msgs::msg::String::SharedPtr msg) const
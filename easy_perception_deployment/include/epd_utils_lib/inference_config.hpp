@@ -0,0 +1,135 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef EPD_UTILS_LIB__INFERENCE_CONFIG_HPP_
+#define EPD_UTILS_LIB__INFERENCE_CONFIG_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "opencv2/opencv.hpp"
+
+/*! \brief The inference parameters that may change while frames are being
+processed, such as thresholds, input means, the use-case filter and the output
+mode.\n
+They are published as immutable InferenceConfig snapshots. A frame takes
+shared ownership of the current snapshot once and uses it throughout, so it
+never sees a half-applied update.
+ */
+namespace EPD
+{
+const unsigned int CLASSIFICATION_MODE = 0;
+const unsigned int COUNTING_MODE = 1;
+const unsigned int COLOR_MATCHING_MODE = 2;
+
+/*! \brief An immutable snapshot of the runtime-reconfigurable inference
+parameters.*/
+struct InferenceConfig
+{
+  /*! \brief The score at or below which P2 and P3 detections are dropped.*/
+  float confThreshold = 0.5f;
+  /*! \brief The mask value above which a pixel of a visualized P3 detection
+  belongs to the object.*/
+  float maskThreshold = 0.5f;
+  /*! \brief The BGR means subtracted from P2 and P3 input frames, in
+  [0, 255].*/
+  std::vector<float> detectionMean = {102.9801f, 115.9465f, 122.7717f};
+  /*! \brief The BGR means subtracted from P1 input frames, in [0, 1].*/
+  std::vector<float> classificationMean = {0.406f, 0.456f, 0.485f};
+  /*! \brief The BGR standard deviations P1 input frames are divided by.*/
+  std::vector<float> classificationStd = {0.225f, 0.224f, 0.229f};
+  /*! \brief The selected use-case mode. See usecase_config.hpp.*/
+  unsigned int useCaseMode = CLASSIFICATION_MODE;
+  /*! \brief The object names kept by the Counting use-case filter.*/
+  std::vector<std::string> countClassNames;
+  /*! \brief The normalized hue-saturation histogram of the template color
+  image of the Color-Matching use-case filter.*/
+  cv::Mat refColorHist;
+  /*! \brief The histogram correlation above which a detection matches the
+  template color image.*/
+  float colorMatchThreshold = 0.8f;
+  /*! \brief A boolean to determine the type of final user output.*/
+  bool onlyVisualize = true;
+};
+
+/*! \brief The process-wide current InferenceConfig snapshot and its version.
+The version is bumped on every update, so readers can tell whether their
+cached snapshot is still current without touching the mutex.*/
+struct InferenceConfigSlot
+{
+  /*! \brief A mutex that guards current. Only taken by updates, and by a
+  reader once per update to refresh its cached snapshot.*/
+  std::mutex mutex;
+  std::shared_ptr<const InferenceConfig> current =
+    std::make_shared<const InferenceConfig>();
+  std::atomic<uint64_t> version {0};
+};
+
+/*! \brief A Getter function that gets the process-wide InferenceConfigSlot.*/
+inline InferenceConfigSlot & getInferenceConfigSlot()
+{
+  static InferenceConfigSlot slot;
+  return slot;
+}
+
+/*! \brief A Getter function that gets the current InferenceConfig snapshot.
+The caller shares ownership of it, so it remains valid, and unchanged, for as
+long as the caller holds it.\n
+Every thread caches the last snapshot it read. While no update happened since,
+which is every frame but the first after an update, this costs one atomic load
+and one reference count increment, and takes no lock. A replaced snapshot is
+freed once no frame holds it and every thread that cached it read again.*/
+inline std::shared_ptr<const InferenceConfig> getInferenceConfig()
+{
+  struct CachedSnapshot
+  {
+    uint64_t version = UINT64_MAX;
+    std::shared_ptr<const InferenceConfig> config;
+  };
+  thread_local CachedSnapshot cached;
+
+  InferenceConfigSlot & slot = getInferenceConfigSlot();
+  if (slot.version.load(std::memory_order_acquire) != cached.version) {
+    std::lock_guard<std::mutex> lock(slot.mutex);
+    cached.config = slot.current;
+    cached.version = slot.version.load(std::memory_order_relaxed);
+  }
+  return cached.config;
+}
+
+/*! \brief A Mutator function that publishes config as the current
+InferenceConfig snapshot and returns it. Frames that hold the previous
+snapshot keep using it.*/
+inline std::shared_ptr<const InferenceConfig> setInferenceConfig(InferenceConfig config)
+{
+  auto snapshot = std::make_shared<const InferenceConfig>(std::move(config));
+  InferenceConfigSlot & slot = getInferenceConfigSlot();
+  // The replaced snapshot is released after the lock, if no frame holds it.
+  std::shared_ptr<const InferenceConfig> replaced;
+  {
+    std::lock_guard<std::mutex> lock(slot.mutex);
+    replaced = std::move(slot.current);
+    slot.current = snapshot;
+    slot.version.fetch_add(1, std::memory_order_release);
+  }
+  return snapshot;
+}
+}  // namespace EPD
+
+#endif  // EPD_UTILS_LIB__INFERENCE_CONFIG_HPP_
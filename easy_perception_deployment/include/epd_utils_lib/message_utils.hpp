@@ -16,6 +16,11 @@
 #ifndef EPD_UTILS_LIB__MESSAGE_UTILS_HPP_
 #define EPD_UTILS_LIB__MESSAGE_UTILS_HPP_
 
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include "opencv2/opencv.hpp"
@@ -25,7 +30,10 @@ namespace EPD
 /*! \class EPDObjectDetection
     \brief An Easy Perception Deployment (EPD) ObjectDetection class object.
     This object functions as a transient container of inference results to
-    transport them for processing in by Processor class object.
+    transport them for processing in by Processor class object.\n
+    Every field is stored as its own array, with all P3 masks stored back to
+    back in maskData. clear() keeps the capacity of every array, so a reused
+    object stops allocating once it has held the largest result seen.
 */
 class EPDObjectDetection
 {
@@ -40,27 +48,242 @@ public:
   corresponding bounding boxes of the same index.
   */
   std::vector<float> scores;
-  /*! \brief A vector of image-encoded 32FC1 greyscale masks for P3 results only.
+  /*! \brief The 32FC1 greyscale masks of P3 results only, each maskHeight x
+  maskWidth floats long, of corresponding bounding boxes of the same index.
   */
-  std::vector<cv::Mat> masks;
+  std::vector<float> maskData;
+  /*! \brief The dimensions of every mask, or 0 for P2 results.*/
+  int maskHeight, maskWidth;
+  /*! \brief A vector of object names given by a cascade P1 classification of
+  the bounding boxes of the same index. Empty unless cascade mode is enabled.
+  */
+  std::vector<std::string> cascadeNames;
 
-  /*! \brief A set size for all vectors in class.*/
+  /*! \brief The number of detections held.*/
   size_t data_size;
 
-  /*! \brief A Constructor function. This object can only be called a known
-  size to minimize memory use for storage.*/
-  explicit EPDObjectDetection(size_t input_size)
+  /*! \brief A Constructor function. Storage for input_size detections is
+  reserved up front.*/
+  explicit EPDObjectDetection(size_t input_size = 0, int mask_height = 0, int mask_width = 0)
+  : maskHeight(mask_height),
+    maskWidth(mask_width),
+    data_size(0)
+  {
+    this->reserve(input_size);
+  }
+
+  /*! \brief A Getter function that gets the number of detections held.*/
+  size_t size() const {return data_size;}
+  /*! \brief A Getter function that checks whether every detection has a mask.*/
+  bool hasMasks() const {return maskHeight > 0 && maskWidth > 0;}
+  /*! \brief A Getter function that gets the number of floats in one mask.*/
+  size_t getMaskSize() const {return static_cast<size_t>(maskHeight) * maskWidth;}
+
+  /*! \brief A Mutator function that reserves storage for num detections.*/
+  void reserve(size_t num)
+  {
+    bboxes.reserve(num);
+    classIndices.reserve(num);
+    scores.reserve(num);
+    maskData.reserve(num * this->getMaskSize());
+  }
+
+  /*! \brief A Mutator function that removes every detection and sets the
+  dimensions of the masks that follow, keeping all storage.*/
+  void clear(int mask_height = 0, int mask_width = 0)
+  {
+    bboxes.clear();
+    classIndices.clear();
+    scores.clear();
+    maskData.clear();
+    cascadeNames.clear();
+    maskHeight = mask_height;
+    maskWidth = mask_width;
+    data_size = 0;
+  }
+
+  /*! \brief A Mutator function that appends a detection. mask must point to
+  getMaskSize() floats when hasMasks() is true and is ignored otherwise.*/
+  void add(
+    const std::array<float, 4> & bbox,
+    uint64_t classIdx,
+    float score,
+    const float * mask = nullptr)
+  {
+    bboxes.push_back(bbox);
+    classIndices.push_back(classIdx);
+    scores.push_back(score);
+    if (this->hasMasks()) {
+      maskData.insert(maskData.end(), mask, mask + this->getMaskSize());
+    }
+    ++data_size;
+  }
+
+  /*! \brief A Getter function that gets the mask of detection idx. The
+  returned Mat shares its data with this object, so it is only valid until
+  this object is next modified.*/
+  cv::Mat getMask(size_t idx) const
   {
-    data_size = input_size;
+    return cv::Mat(maskHeight, maskWidth, CV_32FC1,
+             const_cast<float *>(maskData.data()) + idx * this->getMaskSize());
+  }
+
+  /*! \brief A Mutator function that keeps only the detections for which
+  keep(idx) returns true, in their original order. keep is called once per
+  detection in increasing order of idx, before any detection is moved, and
+  the detections are compacted in place.*/
+  template<typename Predicate>
+  void filter(Predicate keep)
+  {
+    const size_t maskSize = this->getMaskSize();
+    const bool hasCascadeNames = cascadeNames.size() == data_size;
+    size_t kept = 0;
+    for (size_t i = 0; i < data_size; ++i) {
+      if (!keep(i)) {
+        continue;
+      }
+      if (kept != i) {
+        bboxes[kept] = bboxes[i];
+        classIndices[kept] = classIndices[i];
+        scores[kept] = scores[i];
+        if (maskSize > 0) {
+          std::memcpy(maskData.data() + kept * maskSize,
+            maskData.data() + i * maskSize, maskSize * sizeof(float));
+        }
+        if (hasCascadeNames) {
+          cascadeNames[kept].swap(cascadeNames[i]);
+        }
+      }
+      ++kept;
+    }
+    bboxes.resize(kept);
+    classIndices.resize(kept);
+    scores.resize(kept);
+    maskData.resize(kept * maskSize);
+    if (hasCascadeNames) {
+      cascadeNames.resize(kept);
+    }
+    data_size = kept;
+  }
+};
+
+/*! \class EPDImageClassification
+    \brief An Easy Perception Deployment (EPD) ImageClassification class object.
+    This object holds the top classes of a P1 inference result by index into
+    the class label list, so that a result is built without copying any
+    object name. clear() keeps the capacity of every array.
+*/
+class EPDImageClassification
+{
+public:
+  /*! \brief A vector of the class indices of the top classes, in descending
+  order of score.*/
+  std::vector<uint64_t> classIndices;
+  /*! \brief A vector of the confidence scores of the classes of the same
+  index.*/
+  std::vector<float> scores;
 
-    bboxes.reserve(input_size);
-    classIndices.reserve(input_size);
-    scores.reserve(input_size);
-    masks.reserve(input_size);
+  /*! \brief A Getter function that gets the number of classes held.*/
+  size_t size() const {return classIndices.size();}
+
+  /*! \brief A Mutator function that removes every class, keeping all
+  storage.*/
+  void clear()
+  {
+    classIndices.clear();
+    scores.clear();
+  }
+
+  /*! \brief A Mutator function that appends a class.*/
+  void add(uint64_t classIdx, float score)
+  {
+    classIndices.push_back(classIdx);
+    scores.push_back(score);
+  }
+};
+
+class EPDObjectDetectionPool;
+
+/*! \brief A deleter that hands an EPDObjectDetection back to the
+EPDObjectDetectionPool it was acquired from.*/
+struct EPDObjectDetectionRecycler
+{
+  EPDObjectDetectionPool * pool;
+  void operator()(EPDObjectDetection * detection) const;
+};
+
+/*! \brief An EPDObjectDetection acquired from an EPDObjectDetectionPool,
+which returns to the pool when released.*/
+using PooledDetection = std::unique_ptr<EPDObjectDetection, EPDObjectDetectionRecycler>;
+
+/*! \class EPDObjectDetectionPool
+    \brief A small pool of reusable EPDObjectDetection objects.
+    Results are acquired once per frame and recycled once published. Since
+    recycled results keep their storage, a warm pool serves every frame
+    without heap allocations. The pool grows when every result is in use and
+    must outlive all results acquired from it. It is safe to use from
+    several threads.
+*/
+class EPDObjectDetectionPool
+{
+public:
+  /*! \brief A Constructor function that creates initial_size results.*/
+  explicit EPDObjectDetectionPool(size_t initial_size = 2)
+  {
+    for (size_t i = 0; i < initial_size; ++i) {
+      m_all.emplace_back(new EPDObjectDetection());
+      m_free.push_back(m_all.back().get());
+    }
+  }
+
+  EPDObjectDetectionPool(const EPDObjectDetectionPool &) = delete;
+  EPDObjectDetectionPool & operator=(const EPDObjectDetectionPool &) = delete;
+
+  /*! \brief A Mutator function that gets an empty result, creating a new
+  one if every result is in use.*/
+  PooledDetection acquire()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_free.empty()) {
+      m_all.emplace_back(new EPDObjectDetection());
+      m_free.reserve(m_all.size());
+      m_free.push_back(m_all.back().get());
+    }
+    EPDObjectDetection * detection = m_free.back();
+    m_free.pop_back();
+    detection->clear();
+    return PooledDetection(detection, EPDObjectDetectionRecycler{this});
+  }
+
+  /*! \brief A Getter function that gets the number of results created,
+  whether in use or not.*/
+  size_t getNumCreated()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_all.size();
   }
 
 private:
+  friend struct EPDObjectDetectionRecycler;
+
+  /*! \brief A Mutator function that makes a released result available again.*/
+  void recycle(EPDObjectDetection * detection)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_free.push_back(detection);
+  }
+
+  std::mutex m_mutex;
+  /*! \brief Every result created by this pool.*/
+  std::vector<std::unique_ptr<EPDObjectDetection>> m_all;
+  /*! \brief The results not in use.*/
+  std::vector<EPDObjectDetection *> m_free;
 };
+
+inline void EPDObjectDetectionRecycler::operator()(EPDObjectDetection * detection) const
+{
+  pool->recycle(detection);
+}
 }  // namespace EPD
 
 #endif  // EPD_UTILS_LIB__MESSAGE_UTILS_HPP_
@@ -17,10 +17,15 @@
 #ifndef EPD_UTILS_LIB__PROCESSOR_HPP_
 #define EPD_UTILS_LIB__PROCESSOR_HPP_
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <string>
 #include <memory>
+#include <mutex>
 #include <functional>
+#include <utility>
+#include <vector>
 
 // OpenCV LIB
 #include "opencv2/opencv.hpp"
@@ -28,101 +33,931 @@
 // ROS2 LIB
 #include "cv_bridge/cv_bridge.h"
 #include "rclcpp/rclcpp.hpp"
+#include "rcl_interfaces/msg/set_parameters_result.hpp"
 #include "std_msgs/msg/string.hpp"
 #include "sensor_msgs/msg/image.hpp"
+#include "sensor_msgs/msg/compressed_image.hpp"
 #include "sensor_msgs/msg/region_of_interest.hpp"
 
 // EPD_UTILS LIB
 #include "epd_utils_lib/epd_container.hpp"
 #include "epd_msgs/msg/epd_image_classification.hpp"
 #include "epd_msgs/msg/epd_object_detection.hpp"
+#include "epd_msgs/msg/epd_frame_slot.hpp"
+#include "epd_msgs/msg/epd_skip_report.hpp"
+#include "epd_msgs/msg/epd_label_table.hpp"
+#include "epd_msgs/srv/infer_image.hpp"
+#include "epd_utils_lib/deadline_scheduler.hpp"
 #include "epd_utils_lib/message_utils.hpp"
+#include "epd_utils_lib/image_decode.hpp"
+#include "epd_utils_lib/inference_config.hpp"
+#include "epd_utils_lib/resolution_controller.hpp"
+#include "epd_utils_lib/shm_frame_ring.hpp"
+#include "epd_utils_lib/stage_observer.hpp"
+#include "epd_utils_lib/trace_recorder.hpp"
+#include "epd_utils_lib/usecase_config.hpp"
 
 /*! \class Processor
     \brief An Processor class object.
     This class object inherits rclcpp::Node object and acts the main bridge
     between the ROS2 interface and the underlying ort_cpp_lib library that is
-    based on ONNXRuntime Library.
+    based on ONNXRuntime Library.\n
+    A single Processor can serve several input cameras listed by the
+    input_topics parameter. All cameras share one Ort Session while each keeps
+    its own frame geometry and publishes on its own output topics.\n
+    Every camera also accepts sensor_msgs/CompressedImage frames on the
+    <input_topic>/compressed topic. JPEG frames are decoded directly at a
+    reduced size that still covers the model input size.\n
+    Co-located camera drivers can instead write frames into a shared-memory
+    frame ring and send only an EPDFrameSlot on the <input_topic>/shm topic.
+    Such frames are read in place from the ring. The result of a frame that
+    the driver overwrites while it is processed is dropped.\n
+    Setting the trace_capacity parameter records the stages of every frame
+    into a TraceRecorder. A "dump_trace" request on /processor/state_input
+    writes them to trace_output as Chrome trace JSON.\n
+    Setting the adaptive_resolution parameter lets a P2/P3 Processor resize
+    frames to a smaller short side from resolution_levels while processing a
+    frame takes longer than target_latency_ms, trading some small-object
+    recall for keeping up with the cameras. The input size of each camera is
+    only switched between frames and the Ort Session is not reloaded.\n
+    Setting the latency_budget_ms parameter gives every camera frame a
+    deadline of its stamp plus the budget. A frame that has missed its
+    deadline, or is predicted to miss it from the running latency of every
+    stage, is skipped before it is decoded and reported on the
+    <output_namespace>/skipped topic. After max_consecutive_skips predicted
+    misses in a row, a frame is processed anyway to refresh the prediction.
+    Frame stamps must come from the same clock as the Processor. A frame whose
+    deadline passes while it is being processed has its Ort Session run
+    terminated and is reported as well.\n
+    Setting the cancel_stale_runs parameter processes only the latest frame of
+    every camera. A newer frame terminates the run of the frame in flight and
+    replaces any frame still waiting. Shutting down terminates every run in
+    flight.\n
+    The callbacks of every camera run in their own callback group, so that
+    under a MultiThreadedExecutor the cameras are processed in parallel while
+    the frames of one camera stay in order.\n
+    The inference parameters, namely conf_threshold, mask_threshold,
+    detection_mean, classification_mean, classification_std, usecase_mode,
+    count_class_names, color_template_path, color_match_threshold and
+    output_mode, start from the config files and may be set at runtime. Every
+    accepted change publishes a new InferenceConfig snapshot, which applies
+    from the next frame on. With a cascade configured, output_mode can only
+    be switched to robot if session_config.txt selects robot output.
 */
 class Processor : public rclcpp::Node
 {
 public:
   /*! \brief A Constructor function*/
   Processor(void);
+  /*! \brief A Destructor function*/
+  ~Processor(void);
 
 private:
+  /*! \brief The frame a camera is processing and the one waiting after it,
+  shared by every callback of that camera.*/
+  struct FrameDispatch
+  {
+    /*! \brief A mutex that guards busy and pending, and orders deadline
+    cancellations against the switch to the next frame.*/
+    std::mutex mutex;
+    /*! \brief A boolean to indicate that a frame is being processed.*/
+    bool busy = false;
+    /*! \brief The latest frame waiting to be processed, wrapped in the
+    callback that processes it.*/
+    std::function<void()> pending;
+    /*! \brief The header of the pending frame.*/
+    std_msgs::msg::Header pendingHeader;
+    /*! \brief The RunCanceller bound while a frame is being processed.*/
+    Ort::RunCanceller canceller;
+    /*! \brief The deadline of the frame being processed, in ns on
+    std::chrono::steady_clock, or 0 if it has none.*/
+    std::atomic<int64_t> deadlineNs{0};
+    /*! \brief The EPDSkipReport reason of the last cancellation, or -1 if it
+    was not cancelled for a reason to report.*/
+    std::atomic<int> cancelReason{-1};
+    /*! \brief The number of frames of the camera skipped since startup,
+    which frames of the camera may report concurrently.*/
+    std::atomic<uint64_t> totalSkipped{0};
+  };
+
+  /*! \brief A bundle of the input subscriber, output publishers and frame
+  geometry that belongs to a single input camera.*/
+  struct CameraStream
+  {
+    /*! \brief The camera name used to namespace the output topics.*/
+    std::string name;
+    /*! \brief The callback group of the callbacks of this camera.*/
+    rclcpp::callback_group::CallbackGroup::SharedPtr callback_group;
+    /*! \brief The frame dispatch that serializes the frames of this camera.*/
+    std::unique_ptr<FrameDispatch> dispatch;
+    /*! \brief A subscriber member variable to receive images to receive.*/
+    rclcpp::Subscription<sensor_msgs::msg::Image>::SharedPtr image_sub;
+    /*! \brief A subscriber member variable to receive compressed images to
+    receive.*/
+    rclcpp::Subscription<sensor_msgs::msg::CompressedImage>::SharedPtr compressed_sub;
+    /*! \brief A subscriber member variable to receive shared-memory frame
+    slots to receive.*/
+    rclcpp::Subscription<epd_msgs::msg::EPDFrameSlot>::SharedPtr shm_sub;
+    /*! \brief The shared-memory frame ring last named by shm_sub.*/
+    std::unique_ptr<EPD::ShmFrameReader> shm_reader;
+    /*! \brief A boolean to indicate that the frame being processed is read in
+    place from shm_reader, at shmSlot and shmSequence.*/
+    bool inShmRing = false;
+    /*! \brief The ring slot of the frame being processed in place.*/
+    uint32_t shmSlot = 0;
+    /*! \brief The sequence number of the frame being processed in place.*/
+    uint64_t shmSequence = 0;
+    /*! \brief A publisher member variable to output visualization of inference
+    results*/
+    rclcpp::Publisher<sensor_msgs::msg::Image>::SharedPtr visual_pub;
+    /*! \brief A publisher member variable to output Precision-Level 1 (P1)
+    specific inference output suitable for external agents.*/
+    rclcpp::Publisher<epd_msgs::msg::EPDImageClassification>::SharedPtr p1_pub;
+    /*! \brief A publisher member variable to output Precision-Level 2 (P2)
+    specific inference output suitable for external agents.*/
+    rclcpp::Publisher<epd_msgs::msg::EPDObjectDetection>::SharedPtr p2_pub;
+    /*! \brief A publisher member variable to output Precision-Level 3 (P3)
+    specific inference output suitable for external agents.*/
+    rclcpp::Publisher<epd_msgs::msg::EPDObjectDetection>::SharedPtr p3_pub;
+    /*! \brief A publisher member variable to report the frames skipped for
+    missing their deadline.*/
+    rclcpp::Publisher<epd_msgs::msg::EPDSkipReport>::SharedPtr skip_pub;
+    /*! \brief The number of frames skipped in a row because they were
+    predicted to miss their deadline.*/
+    int consecutiveSkips = 0;
+    /*! \brief Dimensions of the last frame received from this camera.*/
+    int width = 0, height = 0;
+    /*! \brief The P2 and P3 input frame geometry of the current frame.*/
+    Ort::FrameGeometry geometry;
+    /*! \brief The P2 and P3 input frame geometry derived from width and
+    height for every level of resolution.*/
+    std::vector<Ort::FrameGeometry> geometries;
+    /*! \brief The controller that picks the level of resolution of the next
+    frame from the latency of the previous ones.*/
+    EPD::ResolutionController resolution{{EPD::EPDContainer::DEFAULT_SHORT_SIDE}};
+    /*! \brief The factor that maps results on a reduced decoded frame back
+    onto the full camera frame.*/
+    float outputScale = 1.0;
+    /*! \brief A boolean to indicate that a frame is waiting to be batched.
+    The pending members are guarded by batch_mutex_.*/
+    bool hasPendingFrame = false;
+    /*! \brief The latest frame waiting to be batched.*/
+    cv::Mat pendingFrame;
+    /*! \brief The header of the latest frame waiting to be batched.*/
+    std_msgs::msg::Header pendingHeader;
+    /*! \brief The P2/P3 output message, reused across frames so that its
+    arrays keep their storage.*/
+    epd_msgs::msg::EPDObjectDetection detectionMsg;
+    /*! \brief The P1 inference result, reused across frames.*/
+    EPD::EPDImageClassification classification;
+    /*! \brief The P1 output message, reused across frames so that its
+    arrays keep their storage.*/
+    epd_msgs::msg::EPDImageClassification classificationMsg;
+  };
+
   /*! \brief A subscriber member variable to receive remote calls to shutdown.*/
   rclcpp::Subscription<std_msgs::msg::String>::SharedPtr status_sub;
-  /*! \brief A subscriber member variable to receive images to receive.*/
-  rclcpp::Subscription<sensor_msgs::msg::Image>::SharedPtr image_sub;
-  /*! \brief A publisher member variable to output visualization of inference
-  results*/
-  rclcpp::Publisher<sensor_msgs::msg::Image>::SharedPtr visual_pub;
-  /*! \brief A publisher member variable to output Precision-Level 1 (P1)
-  specific inference output suitable for external agents.*/
-  rclcpp::Publisher<epd_msgs::msg::EPDImageClassification>::SharedPtr p1_pub;
-  /*! \brief A publisher member variable to output Precision-Level 2 (P2)
-  specific inference output suitable for external agents.*/
-  rclcpp::Publisher<epd_msgs::msg::EPDObjectDetection>::SharedPtr p2_pub;
-  /*! \brief A publisher member variable to output Precision-Level 3 (P3)
-  specific inference output suitable for external agents.*/
-  rclcpp::Publisher<epd_msgs::msg::EPDObjectDetection>::SharedPtr p3_pub;
+  /*! \brief A publisher member variable that latches the class label lists
+  of the model, which map the class indices of every output message to
+  object names.*/
+  rclcpp::Publisher<epd_msgs::msg::EPDLabelTable>::SharedPtr label_table_pub;
+  /*! \brief A service member variable to run inference on a single image on
+  demand.*/
+  rclcpp::Service<epd_msgs::srv::InferImage>::SharedPtr infer_srv;
+  /*! \brief A timer member variable that flushes incomplete P1 batches when
+  some cameras are slower than others.*/
+  rclcpp::TimerBase::SharedPtr batch_timer;
+  /*! \brief A timer member variable that terminates the runs of frames past
+  their deadline.*/
+  rclcpp::TimerBase::SharedPtr deadline_timer;
+  /*! \brief The callback group of status_sub and deadline_timer, so that
+  neither waits behind a frame or an infer_srv request.*/
+  rclcpp::callback_group::CallbackGroup::SharedPtr control_group_;
+  /*! \brief The callback group of infer_srv, so that requests neither wait
+  behind nor hold up the frames of the cameras.*/
+  rclcpp::callback_group::CallbackGroup::SharedPtr service_group_;
+  /*! \brief A list of all input cameras served by this Processor.*/
+  std::vector<CameraStream> cameras_;
   /*! \brief A EPDContainer member object that serves as the aforementioned
   bridge.*/
-  mutable EPD::EPDContainer ortAgent_;
+  EPD::EPDContainer ortAgent_;
+  /*! \brief A pool of P2/P3 inference results, each recycled as soon as its
+  output message is built.*/
+  EPD::EPDObjectDetectionPool detection_pool_;
+  /*! \brief The type of the process_frame specialization for one precision
+  level.*/
+  using FrameHandler = void (Processor::*)(
+    CameraStream &, const cv::Mat &, const std_msgs::msg::Header &);
+  /*! \brief The process_frame specialization for the precision level of
+  ortAgent_, selected once on construction.*/
+  FrameHandler process_frame_ = nullptr;
+  /*! \brief The type of the infer_image specialization for one precision
+  level.*/
+  using ImageHandler = void (Processor::*)(
+    const cv::Mat &, const EPD::InferenceConfig &, const std_msgs::msg::Header &,
+    epd_msgs::srv::InferImage::Response &);
+  /*! \brief The infer_image specialization for the precision level of
+  ortAgent_, selected once on construction.*/
+  ImageHandler infer_image_ = nullptr;
+  /*! \brief The type of the get_ort_session specialization for one
+  precision level.*/
+  using SessionGetter = Ort::OrtBase * (Processor::*)();
+  /*! \brief The get_ort_session specialization for the precision level of
+  ortAgent_, selected once on construction.*/
+  SessionGetter get_ort_session_ = nullptr;
+  /*! \brief A mutex that guards the pending frames of all cameras when P1
+  frames are batched.*/
+  std::mutex batch_mutex_;
+  /*! \brief A TraceRecorder member object that records the stages of every
+  frame when tracing is enabled.*/
+  std::unique_ptr<EPD::TraceRecorder> trace_recorder_;
+  /*! \brief The filepath the recorded trace is written to.*/
+  std::string trace_output_;
+  /*! \brief The controller every camera starts with, configured by the
+  adaptive_resolution parameters.*/
+  EPD::ResolutionController resolution_{{EPD::EPDContainer::DEFAULT_SHORT_SIDE}};
+  /*! \brief A DeadlineScheduler member object that predicts the latency of
+  every frame when a latency budget is set.*/
+  std::unique_ptr<EPD::DeadlineScheduler> deadline_scheduler_;
+  /*! \brief The latency budget of every frame from its stamp, in ms.*/
+  double latency_budget_ms_ = 0.0;
+  /*! \brief The number of predicted misses of a camera in a row after which
+  a frame is processed anyway.*/
+  int max_consecutive_skips_ = 10;
+  /*! \brief A boolean to indicate that a newer frame of a camera replaces its
+  frame in flight.*/
+  bool cancel_stale_runs_ = false;
+  /*! \brief A boolean to indicate that P1 output messages carry object names
+  in addition to class indices.*/
+  bool publish_object_names_ = true;
+  /*! \brief A mutex that serializes the updates of the InferenceConfig
+  snapshot. Frames read the snapshot without it.*/
+  std::mutex config_mutex_;
+  /*! \brief The handle that keeps apply_config registered as the parameter
+  callback.*/
+  rclcpp::Node::OnSetParametersCallbackHandle::SharedPtr config_callback_handle_;
 
-  /*! \brief A ROS2 callback function utilized by image_sub.\n
+  /*! \brief A Mutator function that validates the inference parameters among
+  parameters and, if all are valid and any changed, publishes them as a new
+  InferenceConfig snapshot. Utilized as the parameter callback.*/
+  rcl_interfaces::msg::SetParametersResult apply_config(
+    const std::vector<rclcpp::Parameter> & parameters);
+  /*! \brief A Getter function that checks that the frame camera is
+  processing was not overwritten in its shared-memory frame ring, so that its
+  result may be published.*/
+  bool is_frame_intact(const CameraStream & camera);
+  /*! \brief A Mutator function that creates the subscriber and publishers for
+  one input camera.*/
+  void add_camera(
+    const std::string & name,
+    const std::string & input_topic,
+    const std::string & output_namespace);
+  /*! \brief A ROS2 callback function utilized by image_sub of every camera.\n
   It gets ortAgent_ to initialize once and only once when the first input image
   is received.\n
   It also populates the appropriate ROS messages with EPDImageClassification/
   EPDObjectDetection when the onlyVisualize boolean flag is set to false.\n
   */
-  void topic_callback(const sensor_msgs::msg::Image::SharedPtr msg) const;
+  void topic_callback(const sensor_msgs::msg::Image::SharedPtr msg, size_t camera_idx);
+  /*! \brief A ROS2 callback function utilized by compressed_sub of every
+  camera. It decodes the frame at a reduced size where possible before passing
+  it on like topic_callback does.*/
+  void compressed_callback(
+    const sensor_msgs::msg::CompressedImage::SharedPtr msg,
+    size_t camera_idx);
+  /*! \brief A ROS2 callback function utilized by shm_sub of every camera. It
+  wraps the frame in the named shared-memory ring without copying it before
+  passing it on like topic_callback does.*/
+  void shm_callback(
+    const epd_msgs::msg::EPDFrameSlot::SharedPtr msg,
+    size_t camera_idx);
+  /*! \brief A Mutator function that decides whether a camera frame with the
+  given header can still be processed before its deadline. A skipped frame is
+  reported on the skip_pub of the camera.\n
+  Returns true if the frame is to be processed.
+  */
+  bool admit_frame(CameraStream & camera, const std_msgs::msg::Header & header);
+  /*! \brief A Mutator function that publishes an EPDSkipReport for a camera
+  frame with the given header.*/
+  void report_skip(
+    CameraStream & camera,
+    const std_msgs::msg::Header & header,
+    uint8_t reason,
+    double waited_ms);
+  /*! \brief A Getter function that gets how long ago a frame was stamped, in
+  ms, or 0 if it has no stamp.*/
+  double get_waited_ms(const std_msgs::msg::Header & header);
+  /*! \brief A Mutator function that runs work, which processes one frame of
+  a camera with the given header, with the RunCanceller of that camera bound.
+  If the camera is already processing a frame, work waits for it instead and,
+  when cancel_stale_runs is set, terminates it. A frame that was waiting
+  already is reported as superseded.*/
+  void dispatch_frame(
+    size_t camera_idx,
+    const std_msgs::msg::Header & header,
+    std::function<void()> work);
+  /*! \brief A ROS2 callback function utilized by deadline_timer.*/
+  void deadline_callback(void);
+  /*! \brief A Mutator function that initializes ortAgent_, updates the frame
+  geometry of a camera and then either batches or processes a decoded frame.*/
+  void handle_frame(
+    size_t camera_idx,
+    const cv::Mat & img,
+    const std_msgs::msg::Header & header);
   /*! \brief A ROS2 callback function utilized by status_sub.*/
-  void state_callback(const std_msgs::msg::String::SharedPtr msg) const;
+  void state_callback(const std_msgs::msg::String::SharedPtr msg);
+  /*! \brief A Mutator function that writes the recorded trace, merged with
+  the ONNXRuntime profiling events of the active Ort Session and of its
+  cascade Ort Session if any, to trace_output_. ONNXRuntime profiling stops
+  after the first dump.*/
+  void dump_trace(void);
+  /*! \brief A ROS2 callback function utilized by infer_srv.\n
+  It runs the same Ort Session as the image subscribers on the requested image
+  and returns EPDImageClassification/EPDObjectDetection results directly,
+  regardless of the onlyVisualize boolean flag.
+  */
+  void infer_image_callback(
+    const std::shared_ptr<epd_msgs::srv::InferImage::Request> request,
+    std::shared_ptr<epd_msgs::srv::InferImage::Response> response);
+  /*! \brief A Mutator function that gets ortAgent_ to initialize and warm up
+  once and only once, using the dimensions of the first image received, and
+  logs how long every startup phase took. Safe to call from concurrent
+  callbacks.*/
+  void ensure_initialized(const cv::Mat & img);
+  /*! \brief An Accessor function that returns true if handle_frame holds P1
+  frames for a batched run instead of processing them right away.*/
+  bool batches_frames(void) const;
+  /*! \brief A Mutator function that populates an EPDImageClassification
+  message, which may be reused across frames, with a P1 inference result.*/
+  void fill_classification(
+    const EPD::EPDImageClassification & result,
+    const std_msgs::msg::Header & header,
+    epd_msgs::msg::EPDImageClassification & output_msg) const;
+  /*! \brief A Mutator function that runs P2/P3 inference on a single frame
+  with session and the InferenceConfig snapshot of the frame and populates an
+  EPDObjectDetection message, which may be reused across frames, with the
+  result.*/
+  template<typename Traits>
+  void infer_detection(
+    Ort::DetectionOrtBase<Traits> & session,
+    const cv::Mat & img,
+    const Ort::FrameGeometry & geometry,
+    const EPD::InferenceConfig & config,
+    const std_msgs::msg::Header & header,
+    epd_msgs::msg::EPDObjectDetection & output_msg,
+    float output_scale = 1.0);
+  /*! \brief A Mutator function that selects the specializations of
+  process_frame, infer_image and get_ort_session for the Ort Session of type
+  Session. Every other precision-level dependent call goes through them.*/
+  template<typename Session>
+  void select_session(void);
+  /*! \brief A Getter function that gets the Ort Session of type Session as
+  its OrtBase.*/
+  template<typename Session>
+  Ort::OrtBase * get_ort_session(void);
+  /*! \brief A Mutator function that runs inference on a single image with the
+  Ort Session of type Session and writes the result into response.*/
+  template<typename Session>
+  void infer_image(
+    const cv::Mat & img,
+    const EPD::InferenceConfig & config,
+    const std_msgs::msg::Header & header,
+    epd_msgs::srv::InferImage::Response & response);
+  /*! \brief A Mutator function that runs P1 inference on a single image and
+  writes the result into response.*/
+  void fill_response(
+    Ort::P1OrtBase & session,
+    const cv::Mat & img,
+    const EPD::InferenceConfig & config,
+    const std_msgs::msg::Header & header,
+    epd_msgs::srv::InferImage::Response & response);
+  /*! \brief A Mutator function that runs P2/P3 inference on a single image
+  and writes the result into response.*/
+  template<typename Traits>
+  void fill_response(
+    Ort::DetectionOrtBase<Traits> & session,
+    const cv::Mat & img,
+    const EPD::InferenceConfig & config,
+    const std_msgs::msg::Header & header,
+    epd_msgs::srv::InferImage::Response & response);
+  /*! \brief A Mutator function that runs inference on a single frame with
+  the Ort Session of type Session and publishes the result on the output
+  topics of the given camera. Every stage is dispatched statically.\n
+  The InferenceConfig snapshot is taken once here and used by every stage of
+  the frame.*/
+  template<typename Session>
+  void process_frame(
+    CameraStream & camera,
+    const cv::Mat & img,
+    const std_msgs::msg::Header & header);
+  /*! \brief A Mutator function that runs P1 inference on a single frame and
+  publishes the result.*/
+  void run_session(
+    Ort::P1OrtBase & session,
+    CameraStream & camera,
+    const cv::Mat & img,
+    const EPD::InferenceConfig & config,
+    const std_msgs::msg::Header & header);
+  /*! \brief A Mutator function that runs P2/P3 inference on a single frame
+  and publishes the result.*/
+  template<typename Traits>
+  void run_session(
+    Ort::DetectionOrtBase<Traits> & session,
+    CameraStream & camera,
+    const cv::Mat & img,
+    const EPD::InferenceConfig & config,
+    const std_msgs::msg::Header & header);
+  /*! \brief A Mutator function that runs a single P1 inference over all pending
+  camera frames and publishes each result on the output topic of its camera.*/
+  void flush_p1_batch(void);
 };
 
 Processor::Processor(void)
 : Node("processer")
 {
-  // Creating subscriber
-  image_sub = this->create_subscription<sensor_msgs::msg::Image>(
-    "/processor/image_input",
-    10,
-    std::bind(&Processor::topic_callback, this, std::placeholders::_1));
+  std::vector<std::string> input_topics =
+    this->declare_parameter("input_topics", std::vector<std::string>());
+  std::vector<std::string> camera_names =
+    this->declare_parameter("camera_names", std::vector<std::string>());
+  int batch_timeout_ms = this->declare_parameter("batch_timeout_ms", 20);
+  int trace_capacity = this->declare_parameter("trace_capacity", 0);
+  bool trace_ort_profile = this->declare_parameter("trace_ort_profile", false);
+  trace_output_ = this->declare_parameter("trace_output", std::string("epd_trace.json"));
+  bool adaptive_resolution = this->declare_parameter("adaptive_resolution", false);
+  std::vector<int64_t> resolution_levels =
+    this->declare_parameter("resolution_levels", std::vector<int64_t>({480, 640, 800}));
+  double target_latency_ms = this->declare_parameter("target_latency_ms", 100.0);
+  int resolution_hold_frames = this->declare_parameter("resolution_hold_frames", 10);
+  latency_budget_ms_ = this->declare_parameter("latency_budget_ms", 0.0);
+  max_consecutive_skips_ = this->declare_parameter("max_consecutive_skips", 10);
+  int deadline_check_ms = this->declare_parameter("deadline_check_ms", 5);
+  cancel_stale_runs_ = this->declare_parameter("cancel_stale_runs", false);
+  publish_object_names_ = this->declare_parameter("publish_object_names", true);
+
+  // The inference parameters default to the snapshot of the config files.
+  const EPD::InferenceConfig config = *EPD::getInferenceConfig();
+  const std::vector<std::string> config_names = {
+    "conf_threshold", "mask_threshold", "detection_mean", "classification_mean",
+    "classification_std", "usecase_mode", "count_class_names", "color_template_path",
+    "color_match_threshold", "output_mode"};
+  this->declare_parameter("conf_threshold", static_cast<double>(config.confThreshold));
+  this->declare_parameter("mask_threshold", static_cast<double>(config.maskThreshold));
+  this->declare_parameter("detection_mean",
+    std::vector<double>(config.detectionMean.begin(), config.detectionMean.end()));
+  this->declare_parameter("classification_mean",
+    std::vector<double>(config.classificationMean.begin(), config.classificationMean.end()));
+  this->declare_parameter("classification_std",
+    std::vector<double>(config.classificationStd.begin(), config.classificationStd.end()));
+  this->declare_parameter("usecase_mode", static_cast<int>(config.useCaseMode));
+  this->declare_parameter("count_class_names", config.countClassNames);
+  this->declare_parameter("color_template_path", ortAgent_.template_color_path);
+  this->declare_parameter("color_match_threshold",
+    static_cast<double>(config.colorMatchThreshold));
+  this->declare_parameter("output_mode",
+    std::string(config.onlyVisualize ? "visualize" : "robot"));
+
+  rcl_interfaces::msg::SetParametersResult config_result =
+    this->apply_config(this->get_parameters(config_names));
+  if (!config_result.successful) {
+    throw std::runtime_error("Invalid inference parameters. " + config_result.reason);
+  }
+  config_callback_handle_ = this->add_on_set_parameters_callback(
+    std::bind(&Processor::apply_config, this, std::placeholders::_1));
+
+  if (adaptive_resolution) {
+    if (ortAgent_.precision_level == 1) {
+      RCLCPP_WARN(this->get_logger(),
+        "Adaptive resolution only applies to P2 and P3 models. Ignoring.");
+    } else {
+      resolution_ = EPD::ResolutionController(
+        std::vector<int>(resolution_levels.begin(), resolution_levels.end()),
+        target_latency_ms, resolution_hold_frames);
+    }
+  }
+
+  switch (ortAgent_.precision_level) {
+    case 1:
+      this->select_session<Ort::P1OrtBase>();
+      break;
+    case 2:
+      this->select_session<Ort::P2OrtBase>();
+      break;
+    case 3:
+      this->select_session<Ort::P3OrtBase>();
+      break;
+  }
 
+  // Tracing must be set up before the first frame creates the Ort Session.
+  if (trace_capacity > 0) {
+    trace_recorder_ = std::make_unique<EPD::TraceRecorder>(trace_capacity);
+    EPD::addStageObserver(trace_recorder_.get());
+    if (trace_ort_profile) {
+      Ort::OrtBase::setProfilingPrefix("epd_ort_profile");
+    }
+  }
+
+  if (latency_budget_ms_ > 0.0) {
+    deadline_scheduler_ = std::make_unique<EPD::DeadlineScheduler>();
+    EPD::addStageObserver(deadline_scheduler_.get());
+  }
+
+  // A shutdown must not wait for the runs in flight to complete.
+  rclcpp::on_shutdown([]() {Ort::OrtBase::terminateAll();});
+
+  control_group_ = this->create_callback_group(
+    rclcpp::callback_group::CallbackGroupType::MutuallyExclusive);
+  service_group_ = this->create_callback_group(
+    rclcpp::callback_group::CallbackGroupType::MutuallyExclusive);
+
+  // Creating subscribers and publishers
+  if (input_topics.empty()) {
+    this->add_camera("", "/processor/image_input", "/processor");
+  } else {
+    cameras_.reserve(input_topics.size());
+    for (size_t i = 0; i < input_topics.size(); i++) {
+      std::string name = (i < camera_names.size()) ?
+        camera_names[i] : "camera_" + std::to_string(i);
+      this->add_camera(name, input_topics[i], "/processor/" + name);
+    }
+  }
+
+  rclcpp::SubscriptionOptions control_options;
+  control_options.callback_group = control_group_;
   status_sub = this->create_subscription<std_msgs::msg::String>(
     "/processor/state_input",
     10,
-    std::bind(&Processor::state_callback, this, std::placeholders::_1));
+    std::bind(&Processor::state_callback, this, std::placeholders::_1),
+    control_options);
+
+  if (deadline_scheduler_) {
+    deadline_timer = this->create_wall_timer(
+      std::chrono::milliseconds(deadline_check_ms),
+      std::bind(&Processor::deadline_callback, this),
+      control_group_);
+  }
+
+  // Latched, so that late subscribers map class indices to object names
+  // without every output message carrying them.
+  label_table_pub = this->create_publisher<epd_msgs::msg::EPDLabelTable>(
+    "/processor/label_table",
+    rclcpp::QoS(1).transient_local());
+  epd_msgs::msg::EPDLabelTable label_table;
+  label_table.header.stamp = this->now();
+  label_table.class_names = ortAgent_.classNames;
+  label_table.cascade_class_names = ortAgent_.cascadeClassNames;
+  label_table_pub->publish(label_table);
+
+  infer_srv = this->create_service<epd_msgs::srv::InferImage>(
+    "/processor/infer_image",
+    std::bind(&Processor::infer_image_callback, this,
+    std::placeholders::_1, std::placeholders::_2),
+    rmw_qos_profile_services_default,
+    service_group_);
+
+  // P1 frames from several cameras can be classified in one batched run.
+  if (ortAgent_.precision_level == 1 && cameras_.size() > 1) {
+    batch_timer = this->create_wall_timer(
+      std::chrono::milliseconds(batch_timeout_ms),
+      std::bind(&Processor::flush_p1_batch, this));
+  }
+}
+
+Processor::~Processor(void)
+{
+  if (trace_recorder_) {
+    EPD::removeStageObserver(trace_recorder_.get());
+  }
+  if (deadline_scheduler_) {
+    EPD::removeStageObserver(deadline_scheduler_.get());
+  }
+}
+
+rcl_interfaces::msg::SetParametersResult Processor::apply_config(
+  const std::vector<rclcpp::Parameter> & parameters)
+{
+  rcl_interfaces::msg::SetParametersResult result;
+  result.successful = true;
+
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  EPD::InferenceConfig config = *EPD::getInferenceConfig();
+  bool hasChanged = false;
+
+  auto toFloats = [&result](const rclcpp::Parameter & parameter, std::vector<float> & dst) {
+      const std::vector<double> values = parameter.as_double_array();
+      if (values.size() != 3) {
+        result.successful = false;
+        result.reason = parameter.get_name() + " requires one value per BGR channel.";
+        return;
+      }
+      dst.assign(values.begin(), values.end());
+    };
+
+  try {
+    for (const rclcpp::Parameter & parameter : parameters) {
+      const std::string & name = parameter.get_name();
+      if (name == "conf_threshold") {
+        config.confThreshold = parameter.as_double();
+      } else if (name == "mask_threshold") {
+        config.maskThreshold = parameter.as_double();
+      } else if (name == "detection_mean") {
+        toFloats(parameter, config.detectionMean);
+      } else if (name == "classification_mean") {
+        toFloats(parameter, config.classificationMean);
+      } else if (name == "classification_std") {
+        toFloats(parameter, config.classificationStd);
+      } else if (name == "usecase_mode") {
+        const int64_t mode = parameter.as_int();
+        if (mode < EPD::CLASSIFICATION_MODE || mode > EPD::COLOR_MATCHING_MODE) {
+          result.successful = false;
+          result.reason = "Invalid Use Case. Can only be [0, 1, 2].";
+        }
+        config.useCaseMode = static_cast<unsigned int>(mode);
+      } else if (name == "count_class_names") {
+        config.countClassNames = parameter.as_string_array();
+      } else if (name == "color_template_path") {
+        if (parameter.as_string().empty()) {
+          config.refColorHist = cv::Mat();
+        } else {
+          EPD::setColorTemplate(config, parameter.as_string());
+        }
+      } else if (name == "color_match_threshold") {
+        config.colorMatchThreshold = parameter.as_double();
+      } else if (name == "output_mode") {
+        if (parameter.as_string() != "visualize" && parameter.as_string() != "robot") {
+          result.successful = false;
+          result.reason = "output_mode can only be visualize or robot.";
+        }
+        config.onlyVisualize = parameter.as_string() == "visualize";
+      } else {
+        continue;
+      }
+      hasChanged = true;
+    }
+  } catch (const std::runtime_error & e) {
+    // A parameter set to another type, or an unreadable template color image.
+    result.successful = false;
+    result.reason = e.what();
+  }
+
+  if (result.successful && config.useCaseMode == EPD::COLOR_MATCHING_MODE &&
+    config.refColorHist.empty())
+  {
+    result.successful = false;
+    result.reason = "Color-Matching requires a color_template_path.";
+  }
+  // The cascade session is only built when the config files select robot
+  // output, so robot output cannot be switched to without it.
+  if (result.successful && !config.onlyVisualize &&
+    !ortAgent_.cascade_model_path.empty() && !ortAgent_.isCascade())
+  {
+    result.successful = false;
+    result.reason = "The configured cascade was not built, since session_config.txt "
+      "selects visualize output. Restart with robot output to use it.";
+  }
+
+  if (result.successful && hasChanged) {
+    EPD::setInferenceConfig(std::move(config));
+  }
+  return result;
+}
+
+void Processor::add_camera(
+  const std::string & name,
+  const std::string & input_topic,
+  const std::string & output_namespace)
+{
+  const size_t camera_idx = cameras_.size();
+  cameras_.emplace_back();
+  CameraStream & camera = cameras_.back();
+  camera.name = name;
+  camera.resolution = resolution_;
+  camera.dispatch = std::make_unique<FrameDispatch>();
+  // A reentrant group lets a newer frame reach dispatch_frame while the
+  // previous one is still being processed.
+  camera.callback_group = this->create_callback_group(cancel_stale_runs_ ?
+    rclcpp::callback_group::CallbackGroupType::Reentrant :
+    rclcpp::callback_group::CallbackGroupType::MutuallyExclusive);
+
+  rclcpp::SubscriptionOptions options;
+  options.callback_group = camera.callback_group;
+
+  camera.image_sub = this->create_subscription<sensor_msgs::msg::Image>(
+    input_topic,
+    10,
+    [this, camera_idx](const sensor_msgs::msg::Image::SharedPtr msg) {
+      this->dispatch_frame(camera_idx, msg->header, [this, msg, camera_idx]() {
+        this->topic_callback(msg, camera_idx);
+      });
+    },
+    options);
+
+  camera.compressed_sub = this->create_subscription<sensor_msgs::msg::CompressedImage>(
+    input_topic + "/compressed",
+    10,
+    [this, camera_idx](const sensor_msgs::msg::CompressedImage::SharedPtr msg) {
+      this->dispatch_frame(camera_idx, msg->header, [this, msg, camera_idx]() {
+        this->compressed_callback(msg, camera_idx);
+      });
+    },
+    options);
+
+  camera.shm_sub = this->create_subscription<epd_msgs::msg::EPDFrameSlot>(
+    input_topic + "/shm",
+    10,
+    [this, camera_idx](const epd_msgs::msg::EPDFrameSlot::SharedPtr msg) {
+      this->dispatch_frame(camera_idx, msg->header, [this, msg, camera_idx]() {
+        this->shm_callback(msg, camera_idx);
+      });
+    },
+    options);
 
-  // Creating publisher
-  visual_pub = this->create_publisher<sensor_msgs::msg::Image>(
-    "/processor/output",
+  camera.visual_pub = this->create_publisher<sensor_msgs::msg::Image>(
+    output_namespace + "/output",
     10);
-  p1_pub = this->create_publisher<epd_msgs::msg::EPDImageClassification>(
-    "/processor/epd_p1_output",
+  camera.p1_pub = this->create_publisher<epd_msgs::msg::EPDImageClassification>(
+    output_namespace + "/epd_p1_output",
     10);
-  p2_pub = this->create_publisher<epd_msgs::msg::EPDObjectDetection>(
-    "/processor/epd_p2_output",
+  camera.p2_pub = this->create_publisher<epd_msgs::msg::EPDObjectDetection>(
+    output_namespace + "/epd_p2_output",
     10);
-  p3_pub = this->create_publisher<epd_msgs::msg::EPDObjectDetection>(
-    "/processor/epd_p3_output",
+  camera.p3_pub = this->create_publisher<epd_msgs::msg::EPDObjectDetection>(
+    output_namespace + "/epd_p3_output",
+    10);
+  camera.skip_pub = this->create_publisher<epd_msgs::msg::EPDSkipReport>(
+    output_namespace + "/skipped",
     10);
 }
 
-void Processor::state_callback(const std_msgs::msg::String::SharedPtr msg) const
+void Processor::state_callback(const std_msgs::msg::String::SharedPtr msg)
 {
   std::string requested_state = msg->data.c_str();
 
   if (requested_state.compare("shutdown") == 0) {
     rclcpp::shutdown();
+  } else if (requested_state.compare("dump_trace") == 0) {
+    this->dump_trace();
   } else {
     RCLCPP_WARN(this->get_logger(), "Invalid state requested.");
   }
 }
 
-void Processor::topic_callback(const sensor_msgs::msg::Image::SharedPtr msg) const
+void Processor::dump_trace()
+{
+  if (!trace_recorder_) {
+    RCLCPP_WARN(this->get_logger(), "Tracing is disabled. Set trace_capacity to enable it.");
+    return;
+  }
+
+  std::vector<Ort::OrtBase *> ort_sessions;
+  if (ortAgent_.isInit() && get_ort_session_ != nullptr) {
+    ort_sessions.push_back((this->*get_ort_session_)());
+    ort_sessions.push_back(ortAgent_.cascade_ort_session.get());
+  }
+
+  std::vector<EPD::OrtProfile> ort_profiles;
+  for (Ort::OrtBase * ort_session : ort_sessions) {
+    if (ort_session != nullptr) {
+      ort_profiles.push_back({ort_session->endProfiling(), ort_session->getProfilingStartNs()});
+    }
+  }
+
+  if (trace_recorder_->dumpChromeTrace(trace_output_, ort_profiles)) {
+    RCLCPP_INFO(this->get_logger(), "Trace written to %s", trace_output_.c_str());
+  } else {
+    RCLCPP_WARN(this->get_logger(), "Unable to write trace to %s", trace_output_.c_str());
+  }
+}
+
+void Processor::ensure_initialized(const cv::Mat & img)
+{
+  // The warm-up run keeps the one-time kernel initialization out of the
+  // latency of the first frame, and so out of the latency estimates of the
+  // deadline scheduler and the resolution controllers.
+  if (!ortAgent_.isInit() && ortAgent_.initialize(img.cols, img.rows, true)) {
+    double total_ms = 0.0;
+    for (size_t p = 0; p < EPD::NUM_STARTUP_PHASES; ++p) {
+      const EPD::StartupPhase phase = static_cast<EPD::StartupPhase>(p);
+      const double phase_ms = ortAgent_.getStartupPhaseMs(phase);
+      RCLCPP_INFO(this->get_logger(), "[-Startup-] %s = %.2f ms",
+        EPD::getStartupPhaseName(phase), phase_ms);
+      total_ms += std::max(phase_ms, 0.0);
+    }
+    RCLCPP_INFO(this->get_logger(), "[-Startup-] total = %.2f ms", total_ms);
+  }
+}
+
+bool Processor::batches_frames(void) const
+{
+  return batch_timer && ortAgent_.p1_ort_session &&
+         ortAgent_.p1_ort_session->hasDynamicBatch();
+}
+
+void Processor::infer_image_callback(
+  const std::shared_ptr<epd_msgs::srv::InferImage::Request> request,
+  std::shared_ptr<epd_msgs::srv::InferImage::Response> response)
+{
+  response->success = false;
+  response->precision_level = ortAgent_.precision_level;
+
+  // Requests are not camera frames, so they run outside any frame and stay
+  // out of the latency estimates of the deadline scheduler.
+  {
+    EPD::ScopedStage receive_stage(EPD::Stage::RECEIVE);
+    if (request->image.height == 0) {
+      RCLCPP_WARN(this->get_logger(), "Requested image empty. Discarding.");
+      return;
+    }
+  }
+
+  // Convert ROS Image message to cv::Mat for processing.
+  cv::Mat img;
+  {
+    EPD::ScopedStage stage(EPD::Stage::CONVERT);
+    img = cv_bridge::toCvCopy(request->image, "bgr8")->image;
+  }
+
+  this->ensure_initialized(img);
+
+  const std::shared_ptr<const EPD::InferenceConfig> config = EPD::getInferenceConfig();
+  try {
+    (this->*infer_image_)(img, *config, request->image.header, *response);
+  } catch (const Ort::RunTerminated &) {
+    RCLCPP_WARN(this->get_logger(), "Inference terminated by shutdown.");
+    return;
+  }
+  response->success = true;
+}
+
+void Processor::fill_classification(
+  const EPD::EPDImageClassification & result,
+  const std_msgs::msg::Header & header,
+  epd_msgs::msg::EPDImageClassification & output_msg) const
+{
+  output_msg.header = header;
+  output_msg.class_indices.assign(result.classIndices.begin(), result.classIndices.end());
+  output_msg.scores.assign(result.scores.begin(), result.scores.end());
+  // Assigning to the strings of a reused message keeps their storage.
+  output_msg.object_names.resize(publish_object_names_ ? result.size() : 0);
+  for (size_t i = 0; i < output_msg.object_names.size(); i++) {
+    output_msg.object_names[i] = ortAgent_.classNames[result.classIndices[i]];
+  }
+}
+
+template<typename Traits>
+void Processor::infer_detection(
+  Ort::DetectionOrtBase<Traits> & session,
+  const cv::Mat & img,
+  const Ort::FrameGeometry & geometry,
+  const EPD::InferenceConfig & config,
+  const std_msgs::msg::Header & header,
+  epd_msgs::msg::EPDObjectDetection & output_msg,
+  float output_scale)
+{
+  EPD::PooledDetection result = detection_pool_.acquire();
+  session.infer_action(img, geometry, config, *result);
+
+  output_msg.header = header;
+  output_msg.cascade_object_names.clear();
+  if (ortAgent_.isCascade()) {
+    ortAgent_.classifyDetections(img, config, *result);
+    output_msg.cascade_object_names = result->cascadeNames;
+  }
+
+  // Resize rather than clear, so that a reused message keeps the storage of
+  // its bounding boxes and masks.
+  const size_t numDetections = result->size();
+  output_msg.class_indices.assign(result->classIndices.begin(), result->classIndices.end());
+  output_msg.scores.assign(result->scores.begin(), result->scores.end());
+  output_msg.bboxes.resize(numDetections);
+  output_msg.masks.resize(Traits::HAS_MASKS ? numDetections : 0);
+
+  for (size_t i = 0; i < numDetections; i++) {
+    const auto & curBbox = result->bboxes[i];
+    sensor_msgs::msg::RegionOfInterest & roi = output_msg.bboxes[i];
+    roi.x_offset = output_scale * curBbox[0];
+    roi.y_offset = output_scale * curBbox[1];
+    roi.width = output_scale * (curBbox[2] - curBbox[0]);
+    roi.height = output_scale * (curBbox[3] - curBbox[1]);
+    roi.do_rectify = false;
+
+    if (Traits::HAS_MASKS) {
+      sensor_msgs::msg::Image & mask = output_msg.masks[i];
+      const size_t maskBytes = result->getMaskSize() * sizeof(float);
+      const uint8_t * maskData = reinterpret_cast<const uint8_t *>(
+        result->maskData.data()) + i * maskBytes;
+      mask.height = result->maskHeight;
+      mask.width = result->maskWidth;
+      mask.encoding = "32FC1";
+      mask.is_bigendian = false;
+      mask.step = result->maskWidth * sizeof(float);
+      mask.data.assign(maskData, maskData + maskBytes);
+    }
+  }
+}
+
+void Processor::topic_callback(
+  const sensor_msgs::msg::Image::SharedPtr msg,
+  size_t camera_idx)
 {
   // RCLCPP_INFO(this->get_logger(), "Image received");
 
@@ -130,113 +965,556 @@ void Processor::topic_callback(const sensor_msgs::msg::Image::SharedPtr msg) con
   If empty, discard image and don't process.
   Otherwise, proceed with processing.
   */
-  if (msg->height == 0) {
-    RCLCPP_WARN(this->get_logger(), "Input image empty. Discarding.");
-    return;
+  EPD::ScopedFrame frame(deadline_scheduler_.get());
+  {
+    EPD::ScopedStage receive_stage(EPD::Stage::RECEIVE);
+    if (msg->height == 0) {
+      RCLCPP_WARN(this->get_logger(), "Input image empty. Discarding.");
+      return;
+    }
+    if (!this->admit_frame(cameras_[camera_idx], msg->header)) {
+      return;
+    }
   }
 
   // Convert ROS Image message to cv::Mat for processing.
-  std::shared_ptr<cv_bridge::CvImage> imgptr = cv_bridge::toCvCopy(msg, "bgr8");
-  cv::Mat img = imgptr->image;
+  cv::Mat img;
+  {
+    EPD::ScopedStage stage(EPD::Stage::CONVERT);
+    img = cv_bridge::toCvCopy(msg, "bgr8")->image;
+  }
 
-  if (!ortAgent_.isInit()) {
-    ortAgent_.setFrameDimension(img.cols, img.rows);
-    ortAgent_.initORTSessionHandler();
-    ortAgent_.setInitBoolean(true);
-  } else {
-    // TODO(cardboardcode) Implement auto reinitialization of Ort Session.
-    /*
-    Check if height and width has changed or not.
-    If either dim changed, throw runtime error.
-    Otherwise, proceed.
-    */
-    if (ortAgent_.getWidth() != img.cols && ortAgent_.getHeight() != img.rows) {
-      throw std::runtime_error("Input camera changed. Please restart.");
+  cameras_[camera_idx].outputScale = 1.0;
+  this->handle_frame(camera_idx, img, msg->header);
+}
+
+void Processor::compressed_callback(
+  const sensor_msgs::msg::CompressedImage::SharedPtr msg,
+  size_t camera_idx)
+{
+  EPD::ScopedFrame frame(deadline_scheduler_.get());
+  {
+    EPD::ScopedStage receive_stage(EPD::Stage::RECEIVE);
+    if (msg->data.empty()) {
+      RCLCPP_WARN(this->get_logger(), "Input image empty. Discarding.");
+      return;
+    }
+    if (!this->admit_frame(cameras_[camera_idx], msg->header)) {
+      return;
     }
   }
-  // DEBUG
-  // Initialize timer
-  std::chrono::high_resolution_clock::time_point begin = std::chrono::high_resolution_clock::now();
 
-  cv::Mat resultImg;
-  switch (ortAgent_.precision_level) {
-    case 1:
-      {
-        epd_msgs::msg::EPDImageClassification output_msg;
-        output_msg.object_names = ortAgent_.p1_ort_session->infer(img);
+  /* Pick the smallest JPEG decode size that still covers the model input.
+  P1 inputs are always resized to 224x224, while P2/P3 inputs are resized to
+  the frame geometry of the full frame. */
+  int full_width = 0, full_height = 0, scale = 1;
+  if (EPD::readJpegDimensions(msg->data, full_width, full_height)) {
+    int target_width = 224, target_height = 224;
+    if (ortAgent_.precision_level != 1) {
+      // Cover the largest level of resolution, so that the decoded frame
+      // size does not change along with the level.
+      Ort::FrameGeometry full_geometry = EPD::EPDContainer::computeFrameGeometry(
+        full_width, full_height, cameras_[camera_idx].resolution.getShortSides().back());
+      target_width = full_geometry.newW;
+      target_height = full_geometry.newH;
+    }
+    scale = EPD::selectJpegScale(full_width, full_height, target_width, target_height);
+  }
+
+  cv::Mat img;
+  {
+    EPD::ScopedStage stage(EPD::Stage::CONVERT);
+    img = EPD::decodeImage(msg->data, scale);
+  }
+  if (img.empty()) {
+    RCLCPP_WARN(this->get_logger(), "Input image cannot be decoded. Discarding.");
+    return;
+  }
 
-        // TODO(cardboardcode) Populate header information with timestamp
-        // output_msg.header = std_msgs::msg::Header();
+  cameras_[camera_idx].outputScale = (scale == 1) ?
+    1.0 : static_cast<float>(full_width) / img.cols;
+  this->handle_frame(camera_idx, img, msg->header);
+}
 
-        p1_pub->publish(output_msg);
-        break;
+void Processor::shm_callback(
+  const epd_msgs::msg::EPDFrameSlot::SharedPtr msg,
+  size_t camera_idx)
+{
+  CameraStream & camera = cameras_[camera_idx];
+
+  EPD::ScopedFrame frame(deadline_scheduler_.get());
+  {
+    EPD::ScopedStage receive_stage(EPD::Stage::RECEIVE);
+    if (msg->height == 0 || msg->width == 0) {
+      RCLCPP_WARN(this->get_logger(), "Input image empty. Discarding.");
+      return;
+    }
+    if (msg->encoding != "bgr8") {
+      RCLCPP_WARN(this->get_logger(), "Shared-memory frames must be bgr8. Discarding.");
+      return;
+    }
+    if (!this->admit_frame(camera, msg->header)) {
+      return;
+    }
+
+    if (!camera.shm_reader || camera.shm_reader->getName() != msg->shm_name) {
+      try {
+        camera.shm_reader = std::make_unique<EPD::ShmFrameReader>(msg->shm_name);
+      } catch (const std::runtime_error & e) {
+        camera.shm_reader.reset();
+        RCLCPP_WARN(this->get_logger(), "%s. Discarding.", e.what());
+        return;
       }
-    case 2:
-      {
-        if (ortAgent_.isVisualize()) {
-          resultImg = ortAgent_.p2_ort_session->infer_visualize(img);
-          sensor_msgs::msg::Image::SharedPtr output_msg =
-            cv_bridge::CvImage(std_msgs::msg::Header(), "bgr8", resultImg).toImageMsg();
-          visual_pub->publish(*output_msg);
-        } else {
-          EPD::EPDObjectDetection result = ortAgent_.p2_ort_session->infer_action(img);
-          epd_msgs::msg::EPDObjectDetection output_msg;
-          for (size_t i = 0; i < result.data_size; i++) {
-            output_msg.class_indices.push_back(result.classIndices[i]);
-
-            output_msg.scores.push_back(result.scores[i]);
-
-            sensor_msgs::msg::RegionOfInterest roi;
-            roi.x_offset = result.bboxes[i][0];
-            roi.y_offset = result.bboxes[i][1];
-            roi.width = result.bboxes[i][2] - result.bboxes[i][0];
-            roi.height = result.bboxes[i][3] - result.bboxes[i][1];
-            roi.do_rectify = false;
-            output_msg.bboxes.push_back(roi);
-          }
-          p2_pub->publish(output_msg);
-        }
+    }
+  }
+
+  cv::Mat img;
+  {
+    EPD::ScopedStage stage(EPD::Stage::CONVERT);
+    img = camera.shm_reader->view(msg->slot, msg->sequence,
+        msg->width, msg->height, msg->step, CV_8UC3);
+  }
+  if (img.empty()) {
+    RCLCPP_WARN(this->get_logger(), "Shared-memory frame overwritten before use. Discarding.");
+    return;
+  }
+  // Whether the frame is batched depends on the model loaded by the first frame.
+  this->ensure_initialized(img);
+
+  // Clears inShmRing however handle_frame returns.
+  struct ShmRingGuard
+  {
+    CameraStream & camera;
+    ~ShmRingGuard()
+    {
+      camera.inShmRing = false;
+    }
+  } shm_ring_guard{camera};
+
+  // A batched frame outlives this callback, so it cannot stay in the ring.
+  if (this->batches_frames()) {
+    img = img.clone();
+  } else {
+    // The frame is read in place, so its result is only published if the
+    // driver has not overwritten it in the meantime.
+    camera.inShmRing = true;
+    camera.shmSlot = msg->slot;
+    camera.shmSequence = msg->sequence;
+  }
+
+  camera.outputScale = 1.0;
+  this->handle_frame(camera_idx, img, msg->header);
+}
+
+bool Processor::is_frame_intact(const CameraStream & camera)
+{
+  if (!camera.inShmRing || camera.shm_reader->isFrameIntact(camera.shmSlot, camera.shmSequence)) {
+    return true;
+  }
+  RCLCPP_WARN(this->get_logger(),
+    "Shared-memory frame overwritten during processing. Discarding. Use more ring slots.");
+  return false;
+}
+
+bool Processor::admit_frame(CameraStream & camera, const std_msgs::msg::Header & header)
+{
+  // Frames from drivers that do not stamp them carry no deadline.
+  if (!deadline_scheduler_ || (header.stamp.sec == 0 && header.stamp.nanosec == 0)) {
+    return true;
+  }
+
+  const double waited_ms = this->get_waited_ms(header);
+  EPD::FrameDecision decision = deadline_scheduler_->decide(waited_ms, latency_budget_ms_);
+  if (decision == EPD::FrameDecision::SKIP_PREDICTED_MISS &&
+    camera.consecutiveSkips >= max_consecutive_skips_)
+  {
+    decision = EPD::FrameDecision::PROCESS;
+  }
+
+  if (decision == EPD::FrameDecision::PROCESS) {
+    camera.consecutiveSkips = 0;
+    // Terminate the run of this frame if it outlives the remaining budget.
+    const int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+    camera.dispatch->deadlineNs = now_ns +
+      static_cast<int64_t>((latency_budget_ms_ - waited_ms) * 1e6);
+    return true;
+  }
+
+  if (decision == EPD::FrameDecision::SKIP_PREDICTED_MISS) {
+    camera.consecutiveSkips++;
+  }
+  this->report_skip(camera, header,
+    (decision == EPD::FrameDecision::SKIP_EXPIRED) ?
+    epd_msgs::msg::EPDSkipReport::REASON_EXPIRED :
+    epd_msgs::msg::EPDSkipReport::REASON_PREDICTED_MISS,
+    waited_ms);
+  return false;
+}
 
-        break;
+void Processor::report_skip(
+  CameraStream & camera,
+  const std_msgs::msg::Header & header,
+  uint8_t reason,
+  double waited_ms)
+{
+  epd_msgs::msg::EPDSkipReport report;
+  report.header = header;
+  report.camera_name = camera.name;
+  report.reason = reason;
+  report.waited_ms = waited_ms;
+  report.predicted_ms = deadline_scheduler_ ? deadline_scheduler_->getPredictedLatencyMs() : 0.0;
+  report.budget_ms = latency_budget_ms_;
+  report.total_skipped = camera.dispatch->totalSkipped.fetch_add(1) + 1;
+  camera.skip_pub->publish(report);
+
+  RCLCPP_DEBUG(this->get_logger(),
+    "Input camera [%s] skipped a frame that waited %f ms, predicted %f ms more.",
+    camera.name.c_str(), report.waited_ms, report.predicted_ms);
+}
+
+double Processor::get_waited_ms(const std_msgs::msg::Header & header)
+{
+  if (header.stamp.sec == 0 && header.stamp.nanosec == 0) {
+    return 0.0;
+  }
+  return (this->now() - rclcpp::Time(header.stamp)).seconds() * 1000.0;
+}
+
+void Processor::dispatch_frame(
+  size_t camera_idx,
+  const std_msgs::msg::Header & header,
+  std::function<void()> work)
+{
+  CameraStream & camera = cameras_[camera_idx];
+  FrameDispatch & dispatch = *camera.dispatch;
+  {
+    std::unique_lock<std::mutex> lock(dispatch.mutex);
+    if (dispatch.busy) {
+      // Only reachable with cancel_stale_runs, through the reentrant group.
+      // The newer frame replaces both the waiting frame and the one in flight.
+      const bool replaced = static_cast<bool>(dispatch.pending);
+      const std_msgs::msg::Header replaced_header = dispatch.pendingHeader;
+      dispatch.pending = std::move(work);
+      dispatch.pendingHeader = header;
+      dispatch.cancelReason = epd_msgs::msg::EPDSkipReport::REASON_SUPERSEDED;
+      dispatch.canceller.cancel();
+      lock.unlock();
+      if (replaced) {
+        this->report_skip(camera, replaced_header,
+          epd_msgs::msg::EPDSkipReport::REASON_SUPERSEDED,
+          this->get_waited_ms(replaced_header));
       }
-    case 3:
-      {
-        if (ortAgent_.isVisualize()) {
-          resultImg = ortAgent_.p3_ort_session->infer_visualize(img);
-          sensor_msgs::msg::Image::SharedPtr output_msg =
-            cv_bridge::CvImage(std_msgs::msg::Header(), "bgr8", resultImg).toImageMsg();
-          visual_pub->publish(*output_msg);
-        } else {
-          EPD::EPDObjectDetection result = ortAgent_.p3_ort_session->infer_action(img);
-          epd_msgs::msg::EPDObjectDetection output_msg;
-          for (size_t i = 0; i < result.data_size; i++) {
-            output_msg.class_indices.push_back(result.classIndices[i]);
-
-            output_msg.scores.push_back(result.scores[i]);
-
-            sensor_msgs::msg::RegionOfInterest roi;
-            roi.x_offset = result.bboxes[i][0];
-            roi.y_offset = result.bboxes[i][1];
-            roi.width = result.bboxes[i][2] - result.bboxes[i][0];
-            roi.height = result.bboxes[i][3] - result.bboxes[i][1];
-            roi.do_rectify = false;
-            output_msg.bboxes.push_back(roi);
-
-            sensor_msgs::msg::Image::SharedPtr mask =
-              cv_bridge::CvImage(std_msgs::msg::Header(), "32FC1", result.masks[i]).toImageMsg();
-            output_msg.masks.push_back(*mask);
-          }
-          p3_pub->publish(output_msg);
-        }
+      return;
+    }
+    dispatch.busy = true;
+    dispatch.cancelReason = -1;
+    dispatch.canceller.reset();
+  }
 
-        break;
+  // Frees the camera for its next frames if work throws anything but a
+  // terminated run, which handle_frame already catches.
+  struct BusyGuard
+  {
+    FrameDispatch & dispatch;
+    bool released;
+    ~BusyGuard()
+    {
+      if (!released) {
+        std::lock_guard<std::mutex> lock(dispatch.mutex);
+        dispatch.busy = false;
+        dispatch.pending = nullptr;
+        dispatch.deadlineNs = 0;
       }
+    }
+  } busy_guard{dispatch, false};
+
+  Ort::ScopedRunCanceller bound_canceller(&dispatch.canceller);
+  while (true) {
+    work();
+
+    // Switch to the next frame under the lock, so that neither a deadline
+    // cancellation of this frame nor a cancellation meant for the next frame
+    // lands on the wrong one.
+    std::lock_guard<std::mutex> lock(dispatch.mutex);
+    dispatch.deadlineNs = 0;
+    if (!dispatch.pending) {
+      dispatch.busy = false;
+      busy_guard.released = true;
+      return;
+    }
+    work = std::move(dispatch.pending);
+    dispatch.pending = nullptr;
+    dispatch.cancelReason = -1;
+    dispatch.canceller.reset();
+  }
+}
+
+void Processor::deadline_callback()
+{
+  const int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+  for (CameraStream & camera : cameras_) {
+    FrameDispatch & dispatch = *camera.dispatch;
+    // The lock keeps the frame from being switched between the check and the
+    // cancellation, and keeps a superseded frame reported as such.
+    std::lock_guard<std::mutex> lock(dispatch.mutex);
+    const int64_t deadline_ns = dispatch.deadlineNs;
+    if (dispatch.busy && deadline_ns != 0 && now_ns > deadline_ns &&
+      !dispatch.canceller.isCancelled())
+    {
+      dispatch.cancelReason = epd_msgs::msg::EPDSkipReport::REASON_EXPIRED;
+      dispatch.canceller.cancel();
+    }
+  }
+}
+
+void Processor::handle_frame(
+  size_t camera_idx,
+  const cv::Mat & img,
+  const std_msgs::msg::Header & header)
+{
+  CameraStream & camera = cameras_[camera_idx];
+
+  this->ensure_initialized(img);
+
+  /*
+  Check if height and width of this camera has changed or not.
+  If either dim changed, derive a new frame geometry for it.
+  The shared Ort Session takes the geometry per run, so no restart is needed.
+  */
+  if (camera.width != img.cols || camera.height != img.rows) {
+    if (camera.width != 0) {
+      RCLCPP_INFO(this->get_logger(), "Input camera [%s] changed dimension.",
+        camera.name.c_str());
+    }
+    camera.width = img.cols;
+    camera.height = img.rows;
+    camera.geometries.clear();
+    for (int short_side : camera.resolution.getShortSides()) {
+      camera.geometries.push_back(
+        EPD::EPDContainer::computeFrameGeometry(img.cols, img.rows, short_side));
+    }
   }
+  // The level of resolution only changes between frames.
+  camera.geometry = camera.geometries[camera.resolution.getLevel()];
 
-  // DEBUG
-  std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
-  auto elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds>(end - begin);
-  RCLCPP_INFO(this->get_logger(), "[-FPS-]= %f\n", 1000.0 / elapsedTime.count());
+  if (this->batches_frames()) {
+    // Hold the latest frame until every camera has one or the batch timer fires.
+    bool allPending = false;
+    {
+      std::lock_guard<std::mutex> lock(batch_mutex_);
+      camera.pendingFrame = img;
+      camera.pendingHeader = header;
+      camera.hasPendingFrame = true;
+
+      allPending = std::all_of(cameras_.begin(), cameras_.end(),
+          [](const CameraStream & elem) {return elem.hasPendingFrame;});
+    }
+    if (allPending) {
+      this->flush_p1_batch();
+    }
+    return;
+  }
+
+  try {
+    (this->*process_frame_)(camera, img, header);
+  } catch (const Ort::RunTerminated &) {
+    if (deadline_scheduler_) {
+      deadline_scheduler_->discardFrame();
+    }
+    // Runs terminated by a shutdown are not reported.
+    const int reason = camera.dispatch->cancelReason;
+    if (reason >= 0) {
+      this->report_skip(camera, header, static_cast<uint8_t>(reason),
+        this->get_waited_ms(header));
+    }
+  }
+}
+
+void Processor::flush_p1_batch()
+{
+  if (!ortAgent_.isInit()) {
+    return;
+  }
+
+  // Take the pending frames, so that cameras can queue their next frames
+  // while this batch runs.
+  std::vector<cv::Mat> frames;
+  std::vector<std_msgs::msg::Header> headers;
+  std::vector<size_t> frame_owners;
+  frames.reserve(cameras_.size());
+  headers.reserve(cameras_.size());
+  frame_owners.reserve(cameras_.size());
+  {
+    std::lock_guard<std::mutex> lock(batch_mutex_);
+    for (size_t i = 0; i < cameras_.size(); i++) {
+      CameraStream & camera = cameras_[i];
+      if (camera.hasPendingFrame) {
+        frames.push_back(camera.pendingFrame);
+        headers.push_back(camera.pendingHeader);
+        frame_owners.push_back(i);
+        camera.hasPendingFrame = false;
+        camera.pendingFrame.release();
+      }
+    }
+  }
+
+  if (frames.empty()) {
+    return;
+  }
+
+  std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+
+  // A batch flushed by batch_timer runs outside any camera frame, so it is
+  // measured as a frame of its own. One flushed by the last camera to queue a
+  // frame is part of that frame.
+  EPD::ScopedFrame batch_frame(deadline_scheduler_.get());
+
+  // A batch serves several cameras, so no single camera may cancel it.
+  std::vector<EPD::EPDImageClassification> batch_output;
+  try {
+    Ort::ScopedRunCanceller no_canceller(nullptr);
+    ortAgent_.p1_ort_session->infer(frames, *EPD::getInferenceConfig(), batch_output);
+  } catch (const Ort::RunTerminated &) {
+    if (deadline_scheduler_) {
+      deadline_scheduler_->discardFrame();
+    }
+    return;
+  }
+
+  // Concurrent batches may serve the same camera, so the message is not the
+  // one reused by the camera.
+  epd_msgs::msg::EPDImageClassification output_msg;
+  for (size_t i = 0; i < frame_owners.size(); i++) {
+    CameraStream & camera = cameras_[frame_owners[i]];
+    this->fill_classification(batch_output[i], headers[i], output_msg);
+
+    EPD::ScopedStage stage(EPD::Stage::PUBLISH);
+    camera.p1_pub->publish(output_msg);
+  }
+
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+  const double elapsed_ms = std::chrono::duration<double, std::milli>(end - begin).count();
+  RCLCPP_DEBUG(this->get_logger(), "Batch of %zu frames took %f ms.",
+    frames.size(), elapsed_ms);
+}
+
+template<typename Session>
+void Processor::select_session()
+{
+  process_frame_ = &Processor::process_frame<Session>;
+  infer_image_ = &Processor::infer_image<Session>;
+  get_ort_session_ = &Processor::get_ort_session<Session>;
+}
+
+template<typename Session>
+Ort::OrtBase * Processor::get_ort_session()
+{
+  return ortAgent_.getSession<Session>();
+}
+
+template<typename Session>
+void Processor::infer_image(
+  const cv::Mat & img,
+  const EPD::InferenceConfig & config,
+  const std_msgs::msg::Header & header,
+  epd_msgs::srv::InferImage::Response & response)
+{
+  this->fill_response(*ortAgent_.getSession<Session>(), img, config, header, response);
+}
+
+void Processor::fill_response(
+  Ort::P1OrtBase & session,
+  const cv::Mat & img,
+  const EPD::InferenceConfig & config,
+  const std_msgs::msg::Header & header,
+  epd_msgs::srv::InferImage::Response & response)
+{
+  EPD::EPDImageClassification result;
+  session.infer(img, config, result);
+  this->fill_classification(result, header, response.classification);
+}
+
+template<typename Traits>
+void Processor::fill_response(
+  Ort::DetectionOrtBase<Traits> & session,
+  const cv::Mat & img,
+  const EPD::InferenceConfig & config,
+  const std_msgs::msg::Header & header,
+  epd_msgs::srv::InferImage::Response & response)
+{
+  this->infer_detection(session, img,
+    EPD::EPDContainer::computeFrameGeometry(img.cols, img.rows), config,
+    header, response.detection);
+}
+
+template<typename Session>
+void Processor::process_frame(
+  CameraStream & camera,
+  const cv::Mat & img,
+  const std_msgs::msg::Header & header)
+{
+  std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+
+  const std::shared_ptr<const EPD::InferenceConfig> config = EPD::getInferenceConfig();
+  this->run_session(*ortAgent_.getSession<Session>(), camera, img, *config, header);
+
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+  const double elapsed_ms = std::chrono::duration<double, std::milli>(end - begin).count();
+  RCLCPP_DEBUG(this->get_logger(), "Input camera [%s] frame took %f ms.",
+    camera.name.c_str(), elapsed_ms);
+
+  if (camera.resolution.update(elapsed_ms)) {
+    RCLCPP_INFO(this->get_logger(), "Input camera [%s] switched to a short side of %d px.",
+      camera.name.c_str(), camera.resolution.getShortSide());
+  }
+}
+
+void Processor::run_session(
+  Ort::P1OrtBase & session,
+  CameraStream & camera,
+  const cv::Mat & img,
+  const EPD::InferenceConfig & config,
+  const std_msgs::msg::Header & header)
+{
+  session.infer(img, config, camera.classification);
+  if (!this->is_frame_intact(camera)) {
+    return;
+  }
+  this->fill_classification(camera.classification, header, camera.classificationMsg);
+
+  EPD::ScopedStage stage(EPD::Stage::PUBLISH);
+  camera.p1_pub->publish(camera.classificationMsg);
+}
+
+template<typename Traits>
+void Processor::run_session(
+  Ort::DetectionOrtBase<Traits> & session,
+  CameraStream & camera,
+  const cv::Mat & img,
+  const EPD::InferenceConfig & config,
+  const std_msgs::msg::Header & header)
+{
+  if (config.onlyVisualize) {
+    cv::Mat resultImg = session.infer_visualize(img, camera.geometry, config);
+    EPD::ScopedStage stage(EPD::Stage::PUBLISH);
+    // Without detections, resultImg is img itself, so it is checked once copied.
+    sensor_msgs::msg::Image::SharedPtr output_msg =
+      cv_bridge::CvImage(header, "bgr8", resultImg).toImageMsg();
+    if (!this->is_frame_intact(camera)) {
+      return;
+    }
+    camera.visual_pub->publish(*output_msg);
+  } else {
+    this->infer_detection(session, img, camera.geometry, config, header, camera.detectionMsg,
+      camera.outputScale);
+    if (!this->is_frame_intact(camera)) {
+      return;
+    }
+    EPD::ScopedStage stage(EPD::Stage::PUBLISH);
+    (Traits::HAS_MASKS ? camera.p3_pub : camera.p2_pub)->publish(camera.detectionMsg);
+  }
 }
 
 #endif  // EPD_UTILS_LIB__PROCESSOR_HPP_
@@ -0,0 +1,129 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef EPD_UTILS_LIB__RESOLUTION_CONTROLLER_HPP_
+#define EPD_UTILS_LIB__RESOLUTION_CONTROLLER_HPP_
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace EPD
+{
+/*! \class ResolutionController
+    \brief A controller that picks the P2/P3 input size, given as the short
+    side of the resized frame, from a fixed set of levels so that the measured
+    latency per frame stays within a target.\n
+    It starts at the largest level. Once the smoothed latency exceeds the
+    target, it steps down one level. Once the latency predicted for the next
+    level up, scaled by its pixel count, fits in the target with some
+    headroom, it steps back up. After every switch it holds the level for a
+    number of frames, so that it does not oscillate. The caller applies the
+    level between frames.
+*/
+class ResolutionController
+{
+public:
+  /*! \brief The fraction of the target latency that the predicted latency of
+  the next level up must fit in before stepping up.*/
+  static constexpr double UPSCALE_HEADROOM = 0.85;
+
+  /*! \brief A Constructor function. A target latency of 0 disables
+  switching.*/
+  explicit ResolutionController(
+    std::vector<int> shortSides,
+    double targetLatencyMs = 0.0,
+    int holdFrames = 10,
+    double smoothing = 0.2)
+  : m_shortSides(std::move(shortSides)),
+    m_targetLatencyMs(targetLatencyMs),
+    m_holdFrames(std::max(holdFrames, 2)),
+    m_smoothing(smoothing),
+    m_latencyMs(0.0),
+    m_framesSinceSwitch(0)
+  {
+    std::sort(m_shortSides.begin(), m_shortSides.end());
+    m_shortSides.erase(
+      std::unique(m_shortSides.begin(), m_shortSides.end()), m_shortSides.end());
+    if (m_shortSides.empty() || m_shortSides.front() <= 0) {
+      throw std::runtime_error("Resolution levels must be a non-empty list of positive sizes.");
+    }
+    m_level = m_shortSides.size() - 1;
+  }
+
+  /*! \brief A Getter function that gets every level, in ascending order.*/
+  const std::vector<int> & getShortSides() const {return m_shortSides;}
+  /*! \brief A Getter function that gets the index of the current level.*/
+  size_t getLevel() const {return m_level;}
+  /*! \brief A Getter function that gets the short side of the current
+  level.*/
+  int getShortSide() const {return m_shortSides[m_level];}
+  /*! \brief A Getter function that gets the smoothed latency measured at the
+  current level, in milliseconds.*/
+  double getLatencyMs() const {return m_latencyMs;}
+
+  /*! \brief A Mutator function that adds the latency of a frame processed at
+  the current level and switches level if needed.\n
+  Returns true if the level changed.
+  */
+  bool update(double latencyMs)
+  {
+    // The first frame at a new input size includes one-off allocations by
+    // ONNXRuntime, so it is not measured.
+    if (m_framesSinceSwitch++ == 0) {
+      return false;
+    }
+    m_latencyMs = (m_framesSinceSwitch == 2) ?
+      latencyMs : m_latencyMs + m_smoothing * (latencyMs - m_latencyMs);
+
+    if (m_targetLatencyMs <= 0.0 || m_framesSinceSwitch < m_holdFrames) {
+      return false;
+    }
+
+    if (m_latencyMs > m_targetLatencyMs && m_level > 0) {
+      --m_level;
+    } else if (m_level + 1 < m_shortSides.size()) {
+      const double scale = static_cast<double>(m_shortSides[m_level + 1]) / getShortSide();
+      if (m_latencyMs * scale * scale >= UPSCALE_HEADROOM * m_targetLatencyMs) {
+        return false;
+      }
+      ++m_level;
+    } else {
+      return false;
+    }
+    m_framesSinceSwitch = 0;
+    return true;
+  }
+
+private:
+  /*! \brief The short side of every level, in ascending order.*/
+  std::vector<int> m_shortSides;
+  /*! \brief The latency per frame to stay within, in milliseconds.*/
+  double m_targetLatencyMs;
+  /*! \brief The number of frames a level is held after a switch.*/
+  int m_holdFrames;
+  /*! \brief The weight of a new latency in the smoothed latency.*/
+  double m_smoothing;
+  /*! \brief The index of the current level.*/
+  size_t m_level;
+  /*! \brief The smoothed latency at the current level, in milliseconds.*/
+  double m_latencyMs;
+  /*! \brief The number of frames processed since the last switch.*/
+  int m_framesSinceSwitch;
+};
+}  // namespace EPD
+
+#endif  // EPD_UTILS_LIB__RESOLUTION_CONTROLLER_HPP_
@@ -0,0 +1,300 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef EPD_UTILS_LIB__SHM_FRAME_RING_HPP_
+#define EPD_UTILS_LIB__SHM_FRAME_RING_HPP_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "opencv2/opencv.hpp"
+
+/*! \brief A POSIX shared-memory ring buffer of image frames, used to pass frames
+between processes on the same host without serializing them. Only the slot
+index and a sequence number need to be sent over ROS.
+ */
+namespace EPD
+{
+/*! \brief The identifier written at the start of every frame ring.*/
+const uint32_t SHM_RING_MAGIC = 0x45504452;  // "EPDR"
+
+/*! \brief The layout at the start of a shared-memory frame ring.*/
+struct ShmRingHeader
+{
+  uint32_t magic;
+  uint32_t slotCount;
+  uint64_t slotCapacity;
+  std::atomic<uint64_t> lastSequence;
+};
+
+/*! \brief The layout at the start of every slot of a shared-memory frame ring.
+The sequence is odd while a frame is being written into the slot and equal to
+twice the frame sequence number once the frame is complete.
+*/
+struct ShmSlotHeader
+{
+  std::atomic<uint64_t> sequence;
+};
+
+/*! \brief A Getter function that gets the byte offset of a slot in a ring.*/
+inline size_t shmSlotOffset(uint32_t slot, uint64_t slotCapacity)
+{
+  const size_t headerSize = (sizeof(ShmRingHeader) + 63) / 64 * 64;
+  const size_t slotStride = 64 + (slotCapacity + 63) / 64 * 64;
+  return headerSize + slot * slotStride;
+}
+
+/*! \class ShmFrameWriter
+    \brief A producer of a shared-memory frame ring.
+    The ShmFrameWriter class object creates a named POSIX shared-memory object
+    and copies frames into its slots in a round-robin manner.
+*/
+class ShmFrameWriter
+{
+public:
+  /*! \brief A Constructor function that creates the named ring of slotCount
+  slots of slotCapacity bytes each.*/
+  ShmFrameWriter(const std::string & name, uint32_t slotCount, uint64_t slotCapacity)
+  : m_name(name), m_sequence(0)
+  {
+    if (slotCount == 0) {
+      throw std::runtime_error("Frame ring requires at least one slot.");
+    }
+    m_size = shmSlotOffset(slotCount, slotCapacity);
+
+    int fd = shm_open(m_name.c_str(), O_CREAT | O_RDWR, 0600);
+    if (fd < 0) {
+      throw std::runtime_error("Unable to create frame ring " + m_name);
+    }
+    if (ftruncate(fd, m_size) != 0) {
+      close(fd);
+      shm_unlink(m_name.c_str());
+      throw std::runtime_error("Unable to size frame ring " + m_name);
+    }
+    void * addr = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+      shm_unlink(m_name.c_str());
+      throw std::runtime_error("Unable to map frame ring " + m_name);
+    }
+    m_base = static_cast<uint8_t *>(addr);
+
+    ShmRingHeader * header = reinterpret_cast<ShmRingHeader *>(m_base);
+    header->slotCount = slotCount;
+    header->slotCapacity = slotCapacity;
+    header->lastSequence.store(0);
+    for (uint32_t i = 0; i < slotCount; ++i) {
+      slotHeader(i)->sequence.store(0);
+    }
+    // Publish magic last so readers never see a partially initialized ring.
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = SHM_RING_MAGIC;
+  }
+
+  /*! \brief A Destructor function that unmaps and removes the named ring.*/
+  ~ShmFrameWriter()
+  {
+    munmap(m_base, m_size);
+    shm_unlink(m_name.c_str());
+  }
+
+  ShmFrameWriter(const ShmFrameWriter &) = delete;
+  ShmFrameWriter & operator=(const ShmFrameWriter &) = delete;
+
+  /*! \brief A Mutator function that copies a frame into the next slot.\n
+  Returns the sequence number of the frame and sets the slot it occupies.
+  */
+  uint64_t write(const cv::Mat & frame, uint32_t & slot)
+  {
+    const ShmRingHeader * header = reinterpret_cast<const ShmRingHeader *>(m_base);
+    const size_t rowBytes = frame.cols * frame.elemSize();
+    if (rowBytes * frame.rows > header->slotCapacity) {
+      throw std::runtime_error("Frame exceeds frame ring slot capacity.");
+    }
+
+    const uint64_t sequence = ++m_sequence;
+    slot = static_cast<uint32_t>((sequence - 1) % header->slotCount);
+
+    ShmSlotHeader * curSlot = slotHeader(slot);
+    curSlot->sequence.store(2 * sequence - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    uint8_t * dst = slotData(slot);
+    for (int i = 0; i < frame.rows; ++i) {
+      memcpy(dst + i * rowBytes, frame.ptr(i), rowBytes);
+    }
+
+    curSlot->sequence.store(2 * sequence, std::memory_order_release);
+    reinterpret_cast<ShmRingHeader *>(m_base)->lastSequence.store(sequence);
+    return sequence;
+  }
+
+private:
+  /*! \brief The name of the POSIX shared-memory object.*/
+  std::string m_name;
+  /*! \brief The sequence number of the last frame written.*/
+  uint64_t m_sequence;
+  /*! \brief The size of the mapping in bytes.*/
+  size_t m_size;
+  /*! \brief The start of the mapping.*/
+  uint8_t * m_base;
+
+  ShmSlotHeader * slotHeader(uint32_t slot)
+  {
+    const ShmRingHeader * header = reinterpret_cast<const ShmRingHeader *>(m_base);
+    return reinterpret_cast<ShmSlotHeader *>(m_base + shmSlotOffset(slot, header->slotCapacity));
+  }
+
+  uint8_t * slotData(uint32_t slot)
+  {
+    return reinterpret_cast<uint8_t *>(slotHeader(slot)) + 64;
+  }
+};
+
+/*! \class ShmFrameReader
+    \brief A consumer of a shared-memory frame ring.
+    The ShmFrameReader class object maps an existing named ring read-only and
+    wraps its slots as cv::Mat without copying them.
+*/
+class ShmFrameReader
+{
+public:
+  /*! \brief A Constructor function that maps an existing named ring.*/
+  explicit ShmFrameReader(const std::string & name)
+  : m_name(name)
+  {
+    int fd = shm_open(m_name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+      throw std::runtime_error("Unable to open frame ring " + m_name);
+    }
+    struct stat ringStat;
+    if (fstat(fd, &ringStat) != 0 || ringStat.st_size < static_cast<off_t>(sizeof(ShmRingHeader))) {
+      close(fd);
+      throw std::runtime_error("Invalid frame ring " + m_name);
+    }
+    m_size = ringStat.st_size;
+    void * addr = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+      throw std::runtime_error("Unable to map frame ring " + m_name);
+    }
+    m_base = static_cast<const uint8_t *>(addr);
+
+    const ShmRingHeader * header = reinterpret_cast<const ShmRingHeader *>(m_base);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (header->magic != SHM_RING_MAGIC ||
+      shmSlotOffset(header->slotCount, header->slotCapacity) > m_size)
+    {
+      munmap(const_cast<uint8_t *>(m_base), m_size);
+      throw std::runtime_error("Invalid frame ring " + m_name);
+    }
+  }
+
+  /*! \brief A Destructor function that unmaps the ring.*/
+  ~ShmFrameReader()
+  {
+    munmap(const_cast<uint8_t *>(m_base), m_size);
+  }
+
+  ShmFrameReader(const ShmFrameReader &) = delete;
+  ShmFrameReader & operator=(const ShmFrameReader &) = delete;
+
+  /*! \brief A Getter function that gets the name of the mapped ring.*/
+  const std::string & getName() const {return m_name;}
+
+  /*! \brief A Getter function that checks if a slot holds the complete frame
+  of the given sequence number before it is read.*/
+  bool isValid(uint32_t slot, uint64_t sequence) const
+  {
+    const ShmRingHeader * header = reinterpret_cast<const ShmRingHeader *>(m_base);
+    if (slot >= header->slotCount) {
+      return false;
+    }
+    return slotHeader(slot)->sequence.load(std::memory_order_acquire) == 2 * sequence;
+  }
+
+  /*! \brief A Getter function that checks if a slot still held the complete
+  frame of the given sequence number while it was read.\n
+  Callers must use it, not isValid, once done reading a frame. The fence keeps
+  the reads of the frame from being reordered after the sequence check.
+  */
+  bool isFrameIntact(uint32_t slot, uint64_t sequence) const
+  {
+    const ShmRingHeader * header = reinterpret_cast<const ShmRingHeader *>(m_base);
+    if (slot >= header->slotCount) {
+      return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slotHeader(slot)->sequence.load(std::memory_order_relaxed) == 2 * sequence;
+  }
+
+  /*! \brief A Getter function that wraps the frame in a slot as a read-only
+  cv::Mat without copying it.\n
+  Returns an empty cv::Mat if the slot no longer holds the frame, or if the
+  frame dimensions, which come from the producer, are inconsistent or do not
+  fit the slot. Check isFrameIntact once done reading, since the producer may
+  overwrite the slot at any time.
+  */
+  cv::Mat view(
+    uint32_t slot,
+    uint64_t sequence,
+    uint32_t width,
+    uint32_t height,
+    size_t step,
+    int type) const
+  {
+    const ShmRingHeader * header = reinterpret_cast<const ShmRingHeader *>(m_base);
+    // A row must fit its step, and all rows must fit the slot.
+    const size_t rowBytes = static_cast<size_t>(width) * CV_ELEM_SIZE(type);
+    if (!isValid(slot, sequence) || width == 0 || height == 0 ||
+      width > static_cast<uint32_t>(INT_MAX) || height > static_cast<uint32_t>(INT_MAX) ||
+      step == 0 || step < rowBytes || height > header->slotCapacity / step)
+    {
+      return cv::Mat();
+    }
+    // The mapping is read-only, so the cv::Mat must never be written into.
+    return cv::Mat(static_cast<int>(height), static_cast<int>(width), type,
+             const_cast<uint8_t *>(reinterpret_cast<const uint8_t *>(slotHeader(slot)) + 64),
+             step);
+  }
+
+private:
+  /*! \brief The name of the POSIX shared-memory object.*/
+  std::string m_name;
+  /*! \brief The size of the mapping in bytes.*/
+  size_t m_size;
+  /*! \brief The start of the mapping.*/
+  const uint8_t * m_base;
+
+  const ShmSlotHeader * slotHeader(uint32_t slot) const
+  {
+    const ShmRingHeader * header = reinterpret_cast<const ShmRingHeader *>(m_base);
+    return reinterpret_cast<const ShmSlotHeader *>(
+      m_base + shmSlotOffset(slot, header->slotCapacity));
+  }
+};
+
+}  // namespace EPD
+
+#endif  // EPD_UTILS_LIB__SHM_FRAME_RING_HPP_
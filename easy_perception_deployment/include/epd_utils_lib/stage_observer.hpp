@@ -0,0 +1,216 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef EPD_UTILS_LIB__STAGE_OBSERVER_HPP_
+#define EPD_UTILS_LIB__STAGE_OBSERVER_HPP_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/*! \brief A collection of hooks that let benchmarks and diagnostics observe the
+stages every frame goes through, without the pipeline depending on them.
+When no StageObserver is registered, a stage costs a single atomic load.
+ */
+namespace EPD
+{
+/*! \brief The stages of processing a single frame.*/
+enum class Stage : uint8_t
+{
+  RECEIVE = 0,
+  CONVERT,
+  PREPROCESS,
+  INFERENCE,
+  DECODE,
+  USECASE,
+  VISUALIZE,
+  PUBLISH,
+  NUM_STAGES
+};
+
+/*! \brief The number of stages of processing a single frame.*/
+const size_t NUM_STAGES = static_cast<size_t>(Stage::NUM_STAGES);
+
+/*! \brief A Getter function that gets the human-readable name of a stage.*/
+inline const char * getStageName(Stage stage)
+{
+  static const char * STAGE_NAMES[NUM_STAGES] = {
+    "receive", "convert", "preprocess", "inference",
+    "decode", "usecase", "visualize", "publish"
+  };
+  return (stage < Stage::NUM_STAGES) ? STAGE_NAMES[static_cast<size_t>(stage)] : "unknown";
+}
+
+/*! \class StageObserver
+    \brief An interface for objects that are notified whenever a stage of
+    processing a frame begins or ends on the calling thread.
+*/
+class StageObserver
+{
+public:
+  /*! \brief A Destructor function*/
+  virtual ~StageObserver() = default;
+  /*! \brief A callback function called when a stage begins.*/
+  virtual void onStageBegin(Stage stage) = 0;
+  /*! \brief A callback function called when a stage ends.*/
+  virtual void onStageEnd(Stage stage) = 0;
+};
+
+/*! \brief The maximum number of StageObserver objects registered at once.*/
+const size_t MAX_STAGE_OBSERVERS = 4;
+
+/*! \brief A Getter function that gets the process-wide registered observers.*/
+inline std::array<std::atomic<StageObserver *>, MAX_STAGE_OBSERVERS> & getStageObservers()
+{
+  static std::array<std::atomic<StageObserver *>, MAX_STAGE_OBSERVERS> observers {};
+  return observers;
+}
+
+/*! \brief A Getter function that gets the number of registered observers.*/
+inline std::atomic<size_t> & getNumStageObservers()
+{
+  static std::atomic<size_t> numObservers {0};
+  return numObservers;
+}
+
+/*! \brief A Mutator function that registers an observer for all stages.\n
+Returns false if MAX_STAGE_OBSERVERS observers are already registered.
+*/
+inline bool addStageObserver(StageObserver * observer)
+{
+  for (auto & slot : getStageObservers()) {
+    StageObserver * expected = nullptr;
+    if (slot.compare_exchange_strong(expected, observer)) {
+      getNumStageObservers().fetch_add(1);
+      return true;
+    }
+  }
+  return false;
+}
+
+/*! \brief A Mutator function that unregisters an observer. The observer must
+not be destroyed while a stage may still be notifying it.*/
+inline void removeStageObserver(StageObserver * observer)
+{
+  for (auto & slot : getStageObservers()) {
+    StageObserver * expected = observer;
+    if (slot.compare_exchange_strong(expected, nullptr)) {
+      getNumStageObservers().fetch_sub(1);
+    }
+  }
+}
+
+/*! \brief A Mutator function that notifies all observers of a stage begin.*/
+inline void notifyStageBegin(Stage stage)
+{
+  if (getNumStageObservers().load(std::memory_order_relaxed) == 0) {
+    return;
+  }
+  for (auto & slot : getStageObservers()) {
+    StageObserver * observer = slot.load(std::memory_order_acquire);
+    if (observer != nullptr) {
+      observer->onStageBegin(stage);
+    }
+  }
+}
+
+/*! \brief A Mutator function that notifies all observers of a stage end.*/
+inline void notifyStageEnd(Stage stage)
+{
+  if (getNumStageObservers().load(std::memory_order_relaxed) == 0) {
+    return;
+  }
+  for (auto & slot : getStageObservers()) {
+    StageObserver * observer = slot.load(std::memory_order_acquire);
+    if (observer != nullptr) {
+      observer->onStageEnd(stage);
+    }
+  }
+}
+
+/*! \class ScopedStage
+    \brief A guard that marks the lifetime of a scope as one stage.
+*/
+class ScopedStage
+{
+public:
+  /*! \brief A Constructor function that begins a stage.*/
+  explicit ScopedStage(Stage stage)
+  : m_stage(stage)
+  {
+    notifyStageBegin(m_stage);
+  }
+  /*! \brief A Destructor function that ends the stage.*/
+  ~ScopedStage()
+  {
+    notifyStageEnd(m_stage);
+  }
+
+  ScopedStage(const ScopedStage &) = delete;
+  ScopedStage & operator=(const ScopedStage &) = delete;
+
+private:
+  /*! \brief The stage this guard marks.*/
+  const Stage m_stage;
+};
+
+/*! \class StageClock
+    \brief A StageObserver that accumulates the wall-clock time spent in every
+    stage since it was last reset. It is meant to be used by a single thread.
+*/
+class StageClock : public StageObserver
+{
+public:
+  /*! \brief A Constructor function*/
+  StageClock()
+  {
+    this->reset();
+  }
+
+  /*! \brief A Mutator function that zeroes the time of all stages.*/
+  void reset()
+  {
+    m_elapsed.fill(std::chrono::steady_clock::duration::zero());
+  }
+
+  /*! \brief A Getter function that gets the time spent in a stage in ms.*/
+  double getElapsedMs(Stage stage) const
+  {
+    return std::chrono::duration<double, std::milli>(
+      m_elapsed[static_cast<size_t>(stage)]).count();
+  }
+
+  void onStageBegin(Stage stage) override
+  {
+    m_begin[static_cast<size_t>(stage)] = std::chrono::steady_clock::now();
+  }
+
+  void onStageEnd(Stage stage) override
+  {
+    m_elapsed[static_cast<size_t>(stage)] +=
+      std::chrono::steady_clock::now() - m_begin[static_cast<size_t>(stage)];
+  }
+
+private:
+  /*! \brief The time each stage last began.*/
+  std::array<std::chrono::steady_clock::time_point, NUM_STAGES> m_begin;
+  /*! \brief The accumulated time of each stage.*/
+  std::array<std::chrono::steady_clock::duration, NUM_STAGES> m_elapsed;
+};
+
+}  // namespace EPD
+
+#endif  // EPD_UTILS_LIB__STAGE_OBSERVER_HPP_
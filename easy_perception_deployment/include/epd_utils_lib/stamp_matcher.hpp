@@ -0,0 +1,136 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef EPD_UTILS_LIB__STAMP_MATCHER_HPP_
+#define EPD_UTILS_LIB__STAMP_MATCHER_HPP_
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <utility>
+
+namespace EPD
+{
+/*! \class StampMatcher
+    \brief A StampMatcher class object.
+    The StampMatcher class object pairs messages of two streams that carry the
+    same header stamp, such as an input image and the inference result the
+    Processor published for it.\n
+    Each stream keeps at most capacity messages that have not been matched yet,
+    dropping the oldest first. Once a pair is matched, the messages of either
+    stream older than it are dropped, since streams are received in stamp order
+    and they can no longer be matched.
+*/
+template<typename First, typename Second>
+class StampMatcher
+{
+public:
+  /*! \brief A pair of messages that carry the same stamp.*/
+  struct Match
+  {
+    int64_t stampNs;
+    std::shared_ptr<const First> first;
+    std::shared_ptr<const Second> second;
+  };
+
+  /*! \brief A Constructor function*/
+  explicit StampMatcher(size_t capacity = 30)
+  : m_capacity(capacity > 0 ? capacity : 1)
+  {
+  }
+
+  /*! \brief A Mutator function that adds a message of the first stream.
+  It returns true and fills match if a message of the second stream carries
+  the same stamp.*/
+  bool addFirst(int64_t stampNs, std::shared_ptr<const First> first, Match & match)
+  {
+    if (!take(m_second, m_first, stampNs, first, match.second)) {
+      return false;
+    }
+    match.stampNs = stampNs;
+    match.first = std::move(first);
+    return true;
+  }
+
+  /*! \brief A Mutator function that adds a message of the second stream.
+  It returns true and fills match if a message of the first stream carries
+  the same stamp.*/
+  bool addSecond(int64_t stampNs, std::shared_ptr<const Second> second, Match & match)
+  {
+    if (!take(m_first, m_second, stampNs, second, match.first)) {
+      return false;
+    }
+    match.stampNs = stampNs;
+    match.second = std::move(second);
+    return true;
+  }
+
+  /*! \brief A Getter function that gets the number of messages of the first
+  stream waiting for a match.*/
+  size_t getNumPendingFirst() const
+  {
+    return m_first.size();
+  }
+
+  /*! \brief A Getter function that gets the number of messages of the second
+  stream waiting for a match.*/
+  size_t getNumPendingSecond() const
+  {
+    return m_second.size();
+  }
+
+private:
+  template<typename T>
+  using Pending = std::deque<std::pair<int64_t, std::shared_ptr<const T>>>;
+
+  /*! \brief The most messages each stream keeps waiting for a match.*/
+  size_t m_capacity;
+  /*! \brief The unmatched messages of the first stream, oldest first.*/
+  Pending<First> m_first;
+  /*! \brief The unmatched messages of the second stream, oldest first.*/
+  Pending<Second> m_second;
+
+  /*! \brief A Mutator function that looks for stampNs among the pending
+  messages of the other stream. On a match, it takes the message out of others
+  and drops the older messages of both streams. Otherwise, it keeps msg in
+  own.*/
+  template<typename Other, typename Own>
+  bool take(
+    Pending<Other> & others,
+    Pending<Own> & own,
+    int64_t stampNs,
+    const std::shared_ptr<const Own> & msg,
+    std::shared_ptr<const Other> & matched)
+  {
+    for (auto it = others.begin(); it != others.end(); ++it) {
+      if (it->first == stampNs) {
+        matched = std::move(it->second);
+        others.erase(others.begin(), it + 1);
+        while (!own.empty() && own.front().first < stampNs) {
+          own.pop_front();
+        }
+        return true;
+      }
+    }
+    own.emplace_back(stampNs, msg);
+    if (own.size() > m_capacity) {
+      own.pop_front();
+    }
+    return false;
+  }
+};
+}  // namespace EPD
+
+#endif  // EPD_UTILS_LIB__STAMP_MATCHER_HPP_
@@ -0,0 +1,255 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef EPD_UTILS_LIB__TRACE_RECORDER_HPP_
+#define EPD_UTILS_LIB__TRACE_RECORDER_HPP_
+
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "epd_utils_lib/stage_observer.hpp"
+
+namespace EPD
+{
+/*! \brief A profiling file written by an Ort Session, along with the time, on
+std::chrono::steady_clock, at which that Ort Session started profiling.*/
+struct OrtProfile
+{
+  std::string path;
+  int64_t startNs;
+};
+
+/*! \class TraceRecorder
+    \brief A StageObserver that records the begin and end of every stage, on
+    every thread, into a fixed-size lock-free ring buffer. Once the ring is
+    full, the oldest events are overwritten.\n
+    The recorded events can be written out as a Chrome trace JSON file, which
+    chrome://tracing and ui.perfetto.dev display as a per-thread timeline,
+    optionally merged with the profiling events of an Ort Session.
+*/
+class TraceRecorder : public StageObserver
+{
+public:
+  /*! \brief A Constructor function that allocates room for capacity events.*/
+  explicit TraceRecorder(size_t capacity)
+  : m_capacity(capacity > 0 ? capacity : 1),
+    m_slots(new Slot[m_capacity]),
+    m_head(0)
+  {
+    for (size_t i = 0; i < m_capacity; ++i) {
+      m_slots[i].sequence.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  /*! \brief A Getter function that gets the time on the clock every event is
+  stamped with, in nanoseconds.*/
+  static int64_t now()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  /*! \brief A Getter function that gets the number of events recorded so far,
+  including those already overwritten.*/
+  uint64_t getNumRecorded() const
+  {
+    return m_head.load(std::memory_order_relaxed);
+  }
+
+  void onStageBegin(Stage stage) override
+  {
+    this->record(stage, 'B');
+  }
+
+  void onStageEnd(Stage stage) override
+  {
+    this->record(stage, 'E');
+  }
+
+  /*! \brief A Getter function that writes all events still in the ring as
+  Chrome trace JSON.\n
+  The events of every profiling file in ortProfiles, such as those of a
+  detection and a cascade Ort Session, are merged in.
+  */
+  void writeChromeTrace(
+    std::ostream & os,
+    const std::vector<OrtProfile> & ortProfiles = {}) const
+  {
+    const int pid = getpid();
+    const uint64_t head = m_head.load(std::memory_order_acquire);
+    const uint64_t tail = (head > m_capacity) ? head - m_capacity : 0;
+
+    // Timestamps are in microseconds and need to keep sub-microsecond digits.
+    const std::ios_base::fmtflags flags = os.flags();
+    const std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(3);
+
+    os << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    bool first = true;
+
+    // A wrapped ring may start in the middle of a stage. Its end is dropped.
+    std::map<uint32_t, int> openStages;
+    for (uint64_t idx = tail; idx < head; ++idx) {
+      const Slot & slot = m_slots[idx % m_capacity];
+      const uint64_t expected = 2 * idx + 2;
+      if (slot.sequence.load(std::memory_order_acquire) != expected) {
+        continue;
+      }
+      const int64_t timestampNs = slot.timestampNs.load(std::memory_order_relaxed);
+      const uint64_t info = slot.info.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.sequence.load(std::memory_order_relaxed) != expected) {
+        continue;
+      }
+
+      const uint32_t threadId = static_cast<uint32_t>(info >> 16);
+      const Stage stage = static_cast<Stage>((info >> 8) & 0xff);
+      const char phase = static_cast<char>(info & 0xff);
+      int & depth = openStages[threadId];
+      if (phase == 'E') {
+        if (depth == 0) {
+          continue;
+        }
+        --depth;
+      } else {
+        ++depth;
+      }
+
+      os << (first ? "\n" : ",\n") << "{\"name\": \"" << getStageName(stage) <<
+        "\", \"cat\": \"epd\", \"ph\": \"" << phase << "\", \"pid\": " << pid <<
+        ", \"tid\": " << threadId << ", \"ts\": " << timestampNs / 1000.0 << "}";
+      first = false;
+    }
+
+    for (const OrtProfile & ortProfile : ortProfiles) {
+      if (!ortProfile.path.empty()) {
+        writeOrtProfileEvents(os, ortProfile, first);
+      }
+    }
+    os << "\n]}\n";
+    os.flags(flags);
+    os.precision(precision);
+  }
+
+  /*! \brief A Getter function that writes all events still in the ring as a
+  Chrome trace JSON file. Returns false if the file cannot be written.*/
+  bool dumpChromeTrace(
+    const std::string & path,
+    const std::vector<OrtProfile> & ortProfiles = {}) const
+  {
+    std::ofstream outfile(path);
+    if (!outfile) {
+      return false;
+    }
+    this->writeChromeTrace(outfile, ortProfiles);
+    return outfile.good();
+  }
+
+private:
+  /*! \brief A single event of the ring. sequence is odd while the event is
+  being written and 2 * (index + 1) once event index is complete.*/
+  struct Slot
+  {
+    std::atomic<uint64_t> sequence;
+    std::atomic<int64_t> timestampNs;
+    /*! \brief The thread id, stage and phase packed as tid:48|stage:8|phase:8.*/
+    std::atomic<uint64_t> info;
+  };
+
+  /*! \brief The number of events the ring holds.*/
+  const size_t m_capacity;
+  /*! \brief The ring of events.*/
+  std::unique_ptr<Slot[]> m_slots;
+  /*! \brief The index of the next event to be recorded.*/
+  std::atomic<uint64_t> m_head;
+
+  /*! \brief A Getter function that gets a small, stable id for the calling
+  thread.*/
+  static uint32_t getThreadId()
+  {
+    static std::atomic<uint32_t> nextThreadId {1};
+    thread_local uint32_t threadId = nextThreadId.fetch_add(1);
+    return threadId;
+  }
+
+  /*! \brief A Mutator function that claims the next slot of the ring and
+  writes an event into it.*/
+  void record(Stage stage, char phase)
+  {
+    const int64_t timestampNs = now();
+    const uint64_t idx = m_head.fetch_add(1, std::memory_order_relaxed);
+    Slot & slot = m_slots[idx % m_capacity];
+
+    slot.sequence.store(2 * idx + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.timestampNs.store(timestampNs, std::memory_order_relaxed);
+    slot.info.store(
+      (static_cast<uint64_t>(getThreadId()) << 16) |
+      (static_cast<uint64_t>(stage) << 8) |
+      static_cast<uint8_t>(phase), std::memory_order_relaxed);
+    slot.sequence.store(2 * idx + 2, std::memory_order_release);
+  }
+
+  /*! \brief A Getter function that appends the events of an Ort profiling
+  file, shifting their timestamps onto the clock of now().\n
+  Ort writes one event object per line, with a "ts" in microseconds since it
+  started profiling.
+  */
+  static void writeOrtProfileEvents(
+    std::ostream & os,
+    const OrtProfile & ortProfile,
+    bool & first)
+  {
+    std::ifstream infile(ortProfile.path);
+    static const std::regex TIMESTAMP("\"ts\"\\s*:\\s*([0-9]+)");
+    const double offsetUs = ortProfile.startNs / 1000.0;
+
+    std::string line;
+    while (std::getline(infile, line)) {
+      const size_t begin = line.find('{');
+      const size_t end = line.rfind('}');
+      if (begin == std::string::npos || end == std::string::npos) {
+        continue;
+      }
+      const std::string event = line.substr(begin, end - begin + 1);
+
+      std::smatch match;
+      if (!std::regex_search(event, match, TIMESTAMP)) {
+        continue;
+      }
+      std::ostringstream shifted;
+      shifted << std::fixed << std::setprecision(3) << "\"ts\": " << offsetUs + std::stod(match[1]);
+
+      os << (first ? "\n" : ",\n") << match.prefix() << shifted.str() << match.suffix();
+      first = false;
+    }
+  }
+};
+
+}  // namespace EPD
+
+#endif  // EPD_UTILS_LIB__TRACE_RECORDER_HPP_
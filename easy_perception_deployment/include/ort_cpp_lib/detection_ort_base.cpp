@@ -0,0 +1,352 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "p2_ort_base.hpp"
+#include "p3_ort_base.hpp"
+#include "epd_utils_lib/usecase_config.hpp"
+#include "epd_utils_lib/stage_observer.hpp"
+
+namespace Ort
+{
+// Constructor
+template<typename Traits>
+DetectionOrtBase<Traits>::DetectionOrtBase(
+  float ratio,
+  int newW,
+  int newH,
+  int paddedW,
+  int paddedH,
+  const uint16_t numClasses,
+  const std::string & modelPath,
+  const boost::optional<size_t> & gpuIdx,
+  const boost::optional<std::vector<std::vector<int64_t>>> & inputShapes)
+: OrtBase(modelPath, gpuIdx, inputShapes),
+  m_numClasses(numClasses),
+  m_geometry{ratio, newW, newH, paddedW, paddedH}
+{}
+
+// Destructor
+template<typename Traits>
+DetectionOrtBase<Traits>::~DetectionOrtBase()
+{}
+
+// Mutator 4
+template<typename Traits>
+cv::Mat DetectionOrtBase<Traits>::infer_visualize(const cv::Mat & inputImg)
+{
+  return this->infer_visualize(inputImg, m_geometry);
+}
+
+// Mutator 4
+template<typename Traits>
+EPD::EPDObjectDetection DetectionOrtBase<Traits>::infer_action(const cv::Mat & inputImg)
+{
+  return this->infer_action(inputImg, m_geometry);
+}
+
+template<typename Traits>
+cv::Mat DetectionOrtBase<Traits>::infer_visualize(
+  const cv::Mat & inputImg,
+  const FrameGeometry & geometry)
+{
+  return this->infer_visualize(inputImg, geometry, *EPD::getInferenceConfig());
+}
+
+template<typename Traits>
+EPD::EPDObjectDetection DetectionOrtBase<Traits>::infer_action(
+  const cv::Mat & inputImg,
+  const FrameGeometry & geometry)
+{
+  EPD::EPDObjectDetection result;
+  this->run(inputImg, geometry, *EPD::getInferenceConfig(), result);
+  return result;
+}
+
+template<typename Traits>
+void DetectionOrtBase<Traits>::infer_action(
+  const cv::Mat & inputImg,
+  const FrameGeometry & geometry,
+  EPD::EPDObjectDetection & result)
+{
+  this->run(inputImg, geometry, *EPD::getInferenceConfig(), result);
+}
+
+template<typename Traits>
+cv::Mat DetectionOrtBase<Traits>::infer_visualize(
+  const cv::Mat & inputImg,
+  const FrameGeometry & geometry,
+  const EPD::InferenceConfig & config)
+{
+  EPD::EPDObjectDetection & detection = getRunBuffers().detection;
+  this->run(inputImg, geometry, config, detection);
+
+  if (detection.size() == 0) {
+    return inputImg;
+  }
+
+  EPD::ScopedStage stage(EPD::Stage::VISUALIZE);
+  return visualize(inputImg, detection, this->getClassNames(), config.maskThreshold);
+}
+
+template<typename Traits>
+void DetectionOrtBase<Traits>::infer_action(
+  const cv::Mat & inputImg,
+  const FrameGeometry & geometry,
+  const EPD::InferenceConfig & config,
+  EPD::EPDObjectDetection & result)
+{
+  this->run(inputImg, geometry, config, result);
+}
+
+// Mutator 3
+template<typename Traits>
+void DetectionOrtBase<Traits>::initClassNames(const std::vector<std::string> & classNames)
+{
+  if (classNames.size() != m_numClasses) {
+    throw std::runtime_error("Mismatch number of classes\n");
+  }
+  m_classNames = classNames;
+}
+
+template<typename Traits>
+typename DetectionOrtBase<Traits>::RunBuffers & DetectionOrtBase<Traits>::getRunBuffers()
+{
+  thread_local RunBuffers buffers;
+  return buffers;
+}
+
+// Mutator 1
+template<typename Traits>
+void DetectionOrtBase<Traits>::preprocess(
+  float * dst,
+  const float * src,
+  const int64_t targetImgWidth,
+  const int64_t targetImgHeight,
+  const int numChannels)
+{
+  for (int c = 0; c < numChannels; ++c) {
+    for (int i = 0; i < targetImgHeight; ++i) {
+      for (int j = 0; j < targetImgWidth; ++j) {
+        dst[c * targetImgHeight * targetImgWidth +
+          i * targetImgWidth + j] =
+          src[i * targetImgWidth * numChannels + j * numChannels + c];
+      }
+    }
+  }
+}
+
+// Mutator 2
+template<typename Traits>
+void DetectionOrtBase<Traits>::preprocess(
+  float * dst,
+  const cv::Mat & imgSrc,
+  const int64_t targetImgWidth,
+  const int64_t targetImgHeight,
+  const int numChannels)
+{
+  for (int i = 0; i < targetImgHeight; ++i) {
+    for (int j = 0; j < targetImgWidth; ++j) {
+      for (int c = 0; c < numChannels; ++c) {
+        dst[c * targetImgHeight * targetImgWidth +
+          i * targetImgWidth + j] =
+          imgSrc.ptr<float>(i, j)[c];
+      }
+    }
+  }
+}
+
+// Mutator 2
+template<typename Traits>
+void DetectionOrtBase<Traits>::preprocess(
+  const cv::Mat & inputImg,
+  const FrameGeometry & geometry,
+  const std::vector<float> & mean,
+  std::vector<float> & inputData)
+{
+  RunBuffers & buffers = getRunBuffers();
+  inputData.resize(3 * geometry.paddedH * geometry.paddedW);
+
+  cv::resize(inputImg, buffers.resizedImg, cv::Size(geometry.newW, geometry.newH));
+
+  buffers.resizedImg.convertTo(buffers.floatImg, CV_32FC3);
+  buffers.floatImg -= cv::Scalar(mean[0], mean[1], mean[2]);
+
+  buffers.paddedImg.create(geometry.paddedH, geometry.paddedW, CV_32FC3);
+  buffers.paddedImg.setTo(cv::Scalar(0, 0, 0));
+  buffers.floatImg.copyTo(buffers.paddedImg(cv::Rect(0, 0, geometry.newW, geometry.newH)));
+
+  preprocess(inputData.data(), buffers.paddedImg, geometry.paddedW, geometry.paddedH, 3);
+}
+
+// Mutator 4
+template<typename Traits>
+void DetectionOrtBase<Traits>::run(
+  const cv::Mat & inputImg,
+  const FrameGeometry & geometry,
+  const EPD::InferenceConfig & config,
+  EPD::EPDObjectDetection & result)
+{
+  RunBuffers & buffers = getRunBuffers();
+  {
+    EPD::ScopedStage stage(EPD::Stage::PREPROCESS);
+    preprocess(inputImg, geometry, config.detectionMean, buffers.inputData);
+  }
+  float * dst = buffers.inputData.data();
+
+  // boxes, labels, scores and any further outputs of Traits
+  std::vector<DataOutputType> inferenceOutput;
+  {
+    EPD::ScopedStage stage(EPD::Stage::INFERENCE);
+    inferenceOutput = (*this)({dst}, {{3, geometry.paddedH, geometry.paddedW}});
+  }
+
+  {
+    EPD::ScopedStage stage(EPD::Stage::DECODE);
+    decode(
+      inferenceOutput, geometry.ratio, inputImg.cols, inputImg.rows, config.confThreshold,
+      result);
+  }
+
+  if (result.size() == 0) {
+    return;
+  }
+
+  EPD::ScopedStage stage(EPD::Stage::USECASE);
+  EPD::activateUseCase(inputImg, result, this->getClassNames(), config);
+}
+
+// Mutator 5
+template<typename Traits>
+void DetectionOrtBase<Traits>::decode(
+  const std::vector<DataOutputType> & inferenceOutput,
+  float ratio,
+  int imgWidth,
+  int imgHeight,
+  float confThresh,
+  EPD::EPDObjectDetection & result)
+{
+  assert(inferenceOutput.size() == Traits::NUM_OUTPUTS);
+  assert(inferenceOutput[1].second.size() == 1);
+  size_t nBoxes = inferenceOutput[1].second[0];
+  const int64_t * labels = reinterpret_cast<const int64_t *>(inferenceOutput[1].first);
+
+  Traits::prepare(inferenceOutput, result);
+  result.reserve(nBoxes);
+  const size_t maskSize = result.getMaskSize();
+
+  for (size_t i = 0; i < nBoxes; ++i) {
+    if (inferenceOutput[2].first[i] > confThresh) {
+      float xmin = inferenceOutput[0].first[i * 4 + 0] / ratio;
+      float ymin = inferenceOutput[0].first[i * 4 + 1] / ratio;
+      float xmax = inferenceOutput[0].first[i * 4 + 2] / ratio;
+      float ymax = inferenceOutput[0].first[i * 4 + 3] / ratio;
+
+      xmin = std::max<float>(xmin, 0);
+      ymin = std::max<float>(ymin, 0);
+      xmax = std::min<float>(xmax, imgWidth);
+      ymax = std::min<float>(ymax, imgHeight);
+
+      result.add({xmin, ymin, xmax, ymax}, labels[i], inferenceOutput[2].first[i],
+        Traits::getMask(inferenceOutput, i, maskSize));
+    }
+  }
+}
+
+template<typename Traits>
+cv::Mat DetectionOrtBase<Traits>::visualize(
+  const cv::Mat & img,
+  const EPD::EPDObjectDetection & detection,
+  const std::vector<std::string> & allClassNames,
+  const float maskThreshold)
+{
+  const auto & bboxes = detection.bboxes;
+  const auto & classIndices = detection.classIndices;
+  if (!allClassNames.empty() && !classIndices.empty()) {
+    assert(allClassNames.size() > *std::max_element(classIndices.begin(), classIndices.end()));
+  }
+
+  cv::Scalar allColors(255.0, 0.0, 0.0, 0.0);
+
+  cv::Mat result = img.clone();
+
+  for (size_t i = 0; i < bboxes.size(); ++i) {
+    const auto & curBbox = bboxes[i];
+    const uint64_t classIdx = classIndices[i];
+    const cv::Scalar & curColor = allColors;
+    const std::string curLabel = allClassNames.empty() ?
+      std::to_string(classIdx) : allClassNames[classIdx];
+
+    cv::rectangle(result, cv::Point(curBbox[0], curBbox[1]),
+      cv::Point(curBbox[2], curBbox[3]), curColor, 2);
+
+    int baseLine = 0;
+    cv::Size labelSize = cv::getTextSize(curLabel, cv::FONT_HERSHEY_COMPLEX,
+        0.35, 1, &baseLine);
+    cv::rectangle(result, cv::Point(curBbox[0], curBbox[1]),
+      cv::Point(curBbox[0] + labelSize.width, curBbox[1] +
+      static_cast<int>(1.3 * labelSize.height)),
+      curColor, -1);
+    cv::putText(result, curLabel, cv::Point(curBbox[0], curBbox[1] + labelSize.height),
+      cv::FONT_HERSHEY_COMPLEX,
+      0.35, cv::Scalar(255, 255, 255));
+
+    const cv::Rect curBoxRect(cv::Point(curBbox[0], curBbox[1]),
+      cv::Point(curBbox[2], curBbox[3]));
+    drawMask(result, detection, i, curBoxRect, curColor, maskThreshold,
+      std::integral_constant<bool, Traits::HAS_MASKS>());
+  }
+  return result;
+}
+
+template<typename Traits>
+void DetectionOrtBase<Traits>::drawMask(
+  cv::Mat & img,
+  const EPD::EPDObjectDetection & detection,
+  size_t idx,
+  const cv::Rect & boxRect,
+  const cv::Scalar & color,
+  float maskThreshold,
+  std::true_type)
+{
+  cv::Mat curMask;
+  cv::resize(detection.getMask(idx), curMask, boxRect.size());
+
+  cv::Mat finalMask = (curMask > maskThreshold);
+
+  cv::Mat coloredRoi = (0.3 * color + 0.7 * img(boxRect));
+
+  coloredRoi.convertTo(coloredRoi, CV_8UC3);
+
+  std::vector<cv::Mat> contours;
+  cv::Mat hierarchy;
+  finalMask.convertTo(finalMask, CV_8U);
+
+  cv::findContours(finalMask, contours, hierarchy, cv::RETR_TREE, cv::CHAIN_APPROX_SIMPLE);
+  cv::drawContours(coloredRoi, contours, -1, color, 5, cv::LINE_8, hierarchy, 100);
+  coloredRoi.copyTo(img(boxRect), finalMask);
+}
+
+// Every model family is compiled once here. A new family adds its Traits
+// header above and a line below.
+template class DetectionOrtBase<P2Traits>;
+template class DetectionOrtBase<P3Traits>;
+}  // namespace Ort
@@ -0,0 +1,225 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ORT_CPP_LIB__DETECTION_ORT_BASE_HPP_
+#define ORT_CPP_LIB__DETECTION_ORT_BASE_HPP_
+
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+#include "ort_cpp_lib/ort_base.hpp"
+#include "epd_utils_lib/inference_config.hpp"
+#include "epd_utils_lib/message_utils.hpp"
+
+namespace Ort
+{
+/*! \class DetectionOrtBase
+    \brief An object detection ONNXRuntime (Ort) Base class template.
+    This class template instantiates an Ort Session which takes an ONNX model
+    used for object detection and runs an inference engine. Everything that
+    differs between model families is given at compile time by Traits, so
+    every stage is dispatched statically and can be inlined. Traits must
+    provide:\n
+    NUM_OUTPUTS, the number of outputs of the ONNX model, whose first three
+    outputs are the boxes, labels and scores.\n
+    HAS_MASKS, whether every detection has a mask to decode and visualize.\n
+    prepare(inferenceOutput, result), which clears result for the masks of
+    inferenceOutput.\n
+    getMask(inferenceOutput, idx, maskSize), which gets the mask of
+    detection idx, or nullptr.\n
+    See P2Traits and P3Traits. A new model family only needs a Traits struct
+    and an explicit instantiation in detection_ort_base.cpp.\n
+    Every inference Mutator function may be called by several threads at
+    once, as each thread runs with its own buffers.
+*/
+template<typename Traits>
+class DetectionOrtBase : public OrtBase
+{
+public:
+  /*! \brief A fixed minimal image size needed for a lower bound requirement
+  for image classification of adequate result.*/
+  static constexpr int64_t MIN_IMAGE_SIZE = 800;
+  /*! \brief A Constructor function*/
+  DetectionOrtBase(
+    float ratio,
+    int newW,
+    int newH,
+    int paddedW,
+    int paddedH,
+    const uint16_t numClasses,
+    const std::string & modelPath,
+    const boost::optional<size_t> & gpuIdx = boost::none,
+    const boost::optional<std::vector<std::vector<int64_t>>> &
+    inputShapes = boost::none);
+  /*! \brief A Destructor function*/
+  ~DetectionOrtBase();
+  /*! \brief A auxillary Mutator function that calls the internal
+  infer_visualize function.*/
+  cv::Mat infer_visualize(const cv::Mat & inputImg);
+  /*! \brief A auxillary Mutator function that calls the internal run
+  function.*/
+  EPD::EPDObjectDetection infer_action(const cv::Mat & inputImg);
+  /*! \brief A auxillary Mutator function that calls the internal
+  infer_visualize function using a given input frame geometry instead of the
+  one the Ort Session was created with.*/
+  cv::Mat infer_visualize(const cv::Mat & inputImg, const FrameGeometry & geometry);
+  /*! \brief A auxillary Mutator function that calls the internal run
+  function using a given input frame geometry instead of the one the Ort
+  Session was created with.*/
+  EPD::EPDObjectDetection infer_action(const cv::Mat & inputImg, const FrameGeometry & geometry);
+  /*! \brief A Mutator function that calls the internal run function using a
+  given input frame geometry and writes the inference result into a reused
+  result object, such as one acquired from an EPDObjectDetectionPool.*/
+  void infer_action(
+    const cv::Mat & inputImg,
+    const FrameGeometry & geometry,
+    EPD::EPDObjectDetection & result);
+  /*! \brief A Mutator function that calls the internal infer_visualize
+  function using a given input frame geometry and the inference parameters of
+  config, the snapshot a frame took.*/
+  cv::Mat infer_visualize(
+    const cv::Mat & inputImg,
+    const FrameGeometry & geometry,
+    const EPD::InferenceConfig & config);
+  /*! \brief A Mutator function that calls the internal run function using a
+  given input frame geometry and the inference parameters of config, the
+  snapshot a frame took, and writes the inference result into a reused result
+  object.*/
+  void infer_action(
+    const cv::Mat & inputImg,
+    const FrameGeometry & geometry,
+    const EPD::InferenceConfig & config,
+    EPD::EPDObjectDetection & result);
+
+  /*! \brief A Mutator function that converts a 3-layered 2D RGB input image
+  into a 1D input data tensor to be passed to the Ort Session for processing.\n
+  This variant takes a generic input image represented by a float pointer.
+  */
+  static void preprocess(
+    float * dst,
+    const float * src,
+    const int64_t targetImgWidth,
+    const int64_t targetImgHeight,
+    const int numChannels);
+
+  /*! \brief A Mutator function that converts a 3-layered 2D RGB input image
+  into a 1D input data tensor to be passed to the Ort Session for processing.\n
+  This variant takes a generic input image represented by a conventional opencv
+  Matrix.
+  */
+  static void preprocess(
+    float * dst,
+    const cv::Mat & imgSrc,
+    const int64_t targetImgWidth,
+    const int64_t targetImgHeight,
+    const int numChannels);
+
+  /*! \brief A Mutator function that resizes inputImg to the input size of
+  geometry, subtracts the BGR means, pads it and converts it into inputData,
+  the input data tensor of a run.*/
+  static void preprocess(
+    const cv::Mat & inputImg,
+    const FrameGeometry & geometry,
+    const std::vector<float> & mean,
+    std::vector<float> & inputData);
+
+  /*! \brief A Mutator function that decodes raw inference outputs into the
+  bounding boxes, classIndices, scores and, if Traits has masks, masks of
+  result on the input image frame, dropping detections with a score below
+  confThresh. Any previous content of result is cleared.*/
+  static void decode(
+    const std::vector<DataOutputType> & inferenceOutput,
+    float ratio,
+    int imgWidth,
+    int imgHeight,
+    float confThresh,
+    EPD::EPDObjectDetection & result);
+
+  /*! \brief A Mutator function that takes inference outputs and illustrates
+  derived bounding boxes and, if Traits has masks, masks with corresponding
+  object labels for visualization purposes.*/
+  static cv::Mat visualize(
+    const cv::Mat & img,
+    const EPD::EPDObjectDetection & detection,
+    const std::vector<std::string> & allClassNames,
+    const float maskThreshold = 0.5);
+
+  /*! \brief A Getter function that gets the number of object names used for an
+  ongoing session.*/
+  uint16_t getNumClasses() const {return m_numClasses;}
+  /*! \brief A Getter function that gets the list of object text labels which
+  will be used for outputting visualized inference result or for specific use-case
+  filters.*/
+  const std::vector<std::string> & getClassNames() const {return m_classNames;}
+  /*! \brief A Mutator function that sets the list of object text labels to be
+  used for the Ort Session.*/
+  void initClassNames(const std::vector<std::string> & classNames);
+
+private:
+  /*! \brief The number of object text labels given an input label list.*/
+  const uint16_t m_numClasses;
+  /*! \brief The frame geometry the Ort Session was created with, derived from
+  the dimension of the first input image received by Processor.*/
+  FrameGeometry m_geometry;
+  /*! \brief A vector of object text labels given an input label list.*/
+  std::vector<std::string> m_classNames;
+
+  /*! \brief The buffers of a run, reused across frames by each thread to
+  avoid heap allocations per frame.*/
+  struct RunBuffers
+  {
+    /*! \brief The input data tensor.*/
+    std::vector<float> inputData;
+    /*! \brief The intermediate images of preprocessing.*/
+    cv::Mat resizedImg, floatImg, paddedImg;
+    /*! \brief The inference result of infer_visualize.*/
+    EPD::EPDObjectDetection detection;
+  };
+  /*! \brief A Getter function that gets the RunBuffers of the calling
+  thread.*/
+  static RunBuffers & getRunBuffers();
+
+  /*! \brief A Mutator function that runs the Ort Session on an input image
+  with the inference parameters of config and writes the result, after the
+  use-case filter, into result.*/
+  void run(
+    const cv::Mat & inputImg,
+    const FrameGeometry & geometry,
+    const EPD::InferenceConfig & config,
+    EPD::EPDObjectDetection & result);
+
+  /*! \brief A Mutator function that overlays the mask of detection idx onto
+  its bounding box in img. Only called if Traits has masks.*/
+  static void drawMask(
+    cv::Mat & img,
+    const EPD::EPDObjectDetection & detection,
+    size_t idx,
+    const cv::Rect & boxRect,
+    const cv::Scalar & color,
+    float maskThreshold,
+    std::true_type hasMasks);
+  /*! \brief A Mutator function that does nothing for Traits without masks.*/
+  static void drawMask(
+    cv::Mat &, const EPD::EPDObjectDetection &, size_t, const cv::Rect &,
+    const cv::Scalar &, float, std::false_type) {}
+};
+
+template<typename Traits>
+constexpr int64_t DetectionOrtBase<Traits>::MIN_IMAGE_SIZE;
+}  // namespace Ort
+
+#endif  // ORT_CPP_LIB__DETECTION_ORT_BASE_HPP_
@@ -14,13 +14,19 @@
 // limitations under the License.
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <functional>
 #include <utility>
 #include <cassert>
 #include <numeric>
 #include <sstream>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "ort_base.hpp"
@@ -46,6 +52,155 @@ std::ostream & operator<<(std::ostream & os, const Container<T> & container)
 namespace Ort
 {
 
+/* All Ort sessions in a process share one Env and the global thread pools it
+owns, so that co-resident sessions, such as a cascade of a P2/P3 and a P1
+session, do not each spawn their own set of threads.
+The shared settings may be set while other threads create sessions, so they
+are guarded by sharedConfigMutex. */
+static std::mutex sharedConfigMutex;
+static int sharedNumThreads = 0;
+static std::string sharedProfilingPrefix;
+
+static int getSharedNumThreads()
+{
+  std::lock_guard<std::mutex> lock(sharedConfigMutex);
+  return sharedNumThreads;
+}
+
+static std::string getSharedProfilingPrefix()
+{
+  std::lock_guard<std::mutex> lock(sharedConfigMutex);
+  return sharedProfilingPrefix;
+}
+
+static Ort::Env & getSharedEnv()
+{
+  static Ort::Env sharedEnv = []() {
+      OrtThreadingOptions * threadingOptions = nullptr;
+      Ort::ThrowOnError(Ort::GetApi().CreateThreadingOptions(&threadingOptions));
+      Ort::ThrowOnError(
+        Ort::GetApi().SetGlobalIntraOpNumThreads(threadingOptions, getSharedNumThreads()));
+      Ort::Env env(threadingOptions, ORT_LOGGING_LEVEL_WARNING, "Ort");
+      Ort::GetApi().ReleaseThreadingOptions(threadingOptions);
+      return env;
+    }();
+  return sharedEnv;
+}
+
+/* Every run in flight is registered here, so that terminateAll can reach it
+from another thread. */
+static std::mutex runsInFlightMutex;
+static std::unordered_set<Ort::RunOptions *> runsInFlight;
+static bool allTerminated = false;
+
+static RunCanceller * & getBoundCanceller()
+{
+  thread_local RunCanceller * canceller = nullptr;
+  return canceller;
+}
+
+class RunCanceller::RunCancellerImpl
+{
+public:
+  mutable std::mutex m_mutex;
+  bool m_cancelled = false;
+  std::vector<Ort::RunOptions *> m_runs;
+};
+
+RunCanceller::RunCanceller()
+: impl_(std::make_unique<RunCancellerImpl>())
+{}
+
+RunCanceller::~RunCanceller() = default;
+
+void RunCanceller::cancel()
+{
+  std::lock_guard<std::mutex> lock(impl_->m_mutex);
+  impl_->m_cancelled = true;
+  for (Ort::RunOptions * runOptions : impl_->m_runs) {
+    runOptions->SetTerminate();
+  }
+}
+
+void RunCanceller::reset()
+{
+  std::lock_guard<std::mutex> lock(impl_->m_mutex);
+  impl_->m_cancelled = false;
+}
+
+bool RunCanceller::isCancelled() const
+{
+  std::lock_guard<std::mutex> lock(impl_->m_mutex);
+  return impl_->m_cancelled;
+}
+
+ScopedRunCanceller::ScopedRunCanceller(RunCanceller * canceller)
+: m_previous(getBoundCanceller())
+{
+  getBoundCanceller() = canceller;
+}
+
+ScopedRunCanceller::~ScopedRunCanceller()
+{
+  getBoundCanceller() = m_previous;
+}
+
+/* Registers the RunOptions of a run in flight with terminateAll and with the
+RunCanceller bound to the calling thread, for as long as the run lasts. A run
+that was cancelled beforehand is terminated right away. */
+class RunRegistration
+{
+public:
+  explicit RunRegistration(Ort::RunOptions & runOptions)
+  : m_runOptions(runOptions),
+    m_canceller(getBoundCanceller())
+  {
+    {
+      std::lock_guard<std::mutex> lock(runsInFlightMutex);
+      runsInFlight.insert(&m_runOptions);
+      if (allTerminated) {
+        m_runOptions.SetTerminate();
+      }
+    }
+    if (m_canceller != nullptr) {
+      RunCanceller::RunCancellerImpl & impl = *m_canceller->impl_;
+      std::lock_guard<std::mutex> lock(impl.m_mutex);
+      impl.m_runs.push_back(&m_runOptions);
+      if (impl.m_cancelled) {
+        m_runOptions.SetTerminate();
+      }
+    }
+  }
+
+  ~RunRegistration()
+  {
+    {
+      std::lock_guard<std::mutex> lock(runsInFlightMutex);
+      runsInFlight.erase(&m_runOptions);
+    }
+    if (m_canceller != nullptr) {
+      RunCanceller::RunCancellerImpl & impl = *m_canceller->impl_;
+      std::lock_guard<std::mutex> lock(impl.m_mutex);
+      impl.m_runs.erase(std::find(impl.m_runs.begin(), impl.m_runs.end(), &m_runOptions));
+    }
+  }
+
+  bool isTerminated() const
+  {
+    {
+      std::lock_guard<std::mutex> lock(runsInFlightMutex);
+      if (allTerminated) {
+        return true;
+      }
+    }
+    return m_canceller != nullptr && m_canceller->isCancelled();
+  }
+
+private:
+  Ort::RunOptions & m_runOptions;
+  RunCanceller * m_canceller;
+};
+
 class OrtBase::OrtBaseImpl
 {
 public:
@@ -56,14 +211,24 @@ public:
   ~OrtBaseImpl();
 
   int getNumOutputs(void);
+  bool hasDynamicBatch(void);
+  std::string endProfiling(void);
+  int64_t getProfilingStartNs(void);
   std::vector<DataOutputType> operator()(const std::vector<float *> & inputData);
+  std::vector<DataOutputType> operator()(
+    const std::vector<float *> & inputData,
+    const std::vector<std::vector<int64_t>> & inputShapes);
 
 private:
   void initSession();
   void initModelInfo();
+  std::vector<DataOutputType> run(
+    const std::vector<float *> & inputData,
+    const std::vector<std::vector<int64_t>> & inputShapes,
+    const std::vector<int64_t> & inputTensorSizes);
 
   Ort::Session m_session;
-  Ort::Env m_env;
+  Ort::Env & m_env;
   Ort::AllocatorWithDefaultOptions m_ortAllocator;
 
   boost::optional<size_t> m_gpuIdx;
@@ -80,6 +245,15 @@ private:
   uint8_t m_numOutputs;
   std::string m_modelPath;
   bool m_inputShapesProvided = false;
+  bool m_dynamicBatch = false;
+  /* Cleared by the first endProfiling call, which may race with another. */
+  std::atomic<bool> m_profiling{false};
+  int64_t m_profilingStartNs = 0;
+
+  /* The output tensors of the last run of every calling thread. The returned
+  DataOutputType pointers point into them, so they must outlive the run. */
+  std::mutex m_outputMutex;
+  std::unordered_map<std::thread::id, std::vector<Ort::Value>> m_threadOutputs;
 };
 
 // Constructor
@@ -98,18 +272,61 @@ std::vector<OrtBase::DataOutputType> OrtBase::operator()(const std::vector<float
   return this->base_impl_->operator()(inputImgData);
 }
 
+std::vector<OrtBase::DataOutputType> OrtBase::operator()(
+  const std::vector<float *> & inputImgData,
+  const std::vector<std::vector<int64_t>> & inputShapes)
+{
+  return this->base_impl_->operator()(inputImgData, inputShapes);
+}
+
 int OrtBase::getNumOutputs()
 {
   return base_impl_->getNumOutputs();
 }
 
+bool OrtBase::hasDynamicBatch()
+{
+  return base_impl_->hasDynamicBatch();
+}
+
+void OrtBase::setNumThreads(int numThreads)
+{
+  std::lock_guard<std::mutex> lock(sharedConfigMutex);
+  sharedNumThreads = numThreads;
+}
+
+void OrtBase::setProfilingPrefix(const std::string & prefix)
+{
+  std::lock_guard<std::mutex> lock(sharedConfigMutex);
+  sharedProfilingPrefix = prefix;
+}
+
+std::string OrtBase::endProfiling()
+{
+  return base_impl_->endProfiling();
+}
+
+int64_t OrtBase::getProfilingStartNs()
+{
+  return base_impl_->getProfilingStartNs();
+}
+
+void OrtBase::terminateAll()
+{
+  std::lock_guard<std::mutex> lock(runsInFlightMutex);
+  allTerminated = true;
+  for (Ort::RunOptions * runOptions : runsInFlight) {
+    runOptions->SetTerminate();
+  }
+}
+
 // Constructor
 OrtBase::OrtBaseImpl::OrtBaseImpl(
   const std::string & modelPath,         //
   const boost::optional<size_t> & gpuIdx,  //
   const boost::optional<std::vector<std::vector<int64_t>>> & inputShapes)
 : m_session(nullptr),
-  m_env(nullptr),
+  m_env(getSharedEnv()),
   m_ortAllocator(),
   m_gpuIdx(gpuIdx),
   m_inputNodeNames(),
@@ -150,10 +367,33 @@ int OrtBase::OrtBaseImpl::getNumOutputs()
   return unsigned(m_numOutputs);
 }
 
+bool OrtBase::OrtBaseImpl::hasDynamicBatch()
+{
+  return m_dynamicBatch;
+}
+
+std::string OrtBase::OrtBaseImpl::endProfiling()
+{
+  if (!m_profiling.exchange(false)) {
+    return "";
+  }
+
+  char * profilePath = m_session.EndProfiling(m_ortAllocator);
+  std::string result(profilePath);
+  m_ortAllocator.Free(profilePath);
+  return result;
+}
+
+int64_t OrtBase::OrtBaseImpl::getProfilingStartNs()
+{
+  return m_profilingStartNs;
+}
+
 void OrtBase::OrtBaseImpl::initSession()
 {
-  m_env = Ort::Env(ORT_LOGGING_LEVEL_WARNING, "Ort");
   Ort::SessionOptions sessionOptions;
+  // Use the global thread pools of the shared Env.
+  sessionOptions.DisablePerSessionThreads();
 
   /* TODO(cardboardcode) Need to take care of the following line
   as it is related to CPU
@@ -169,6 +409,17 @@ void OrtBase::OrtBaseImpl::initSession()
   #endif
 
   sessionOptions.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+
+  // Profiling starts while the session is created, which is close enough to
+  // line its events up with other steady_clock timestamps.
+  const std::string profilingPrefix = getSharedProfilingPrefix();
+  if (!profilingPrefix.empty()) {
+    sessionOptions.EnableProfiling(profilingPrefix.c_str());
+    m_profiling = true;
+    m_profilingStartNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
   m_session = Ort::Session(m_env, m_modelPath.c_str(), sessionOptions);
   m_numInputs = m_session.GetInputCount();
 
@@ -183,6 +434,13 @@ void OrtBase::OrtBaseImpl::initSession()
 
 void OrtBase::OrtBaseImpl::initModelInfo()
 {
+  if (m_numInputs > 0) {
+    // Dynamic dimensions are reported by the model as negative values.
+    Ort::TypeInfo typeInfo = m_session.GetInputTypeInfo(0);
+    auto modelInputShape = typeInfo.GetTensorTypeAndShapeInfo().GetShape();
+    m_dynamicBatch = !modelInputShape.empty() && modelInputShape[0] < 0;
+  }
+
   for (int i = 0; i < m_numInputs; i++) {
     // If m_inputShapes not initialized,
     // then look at m_session and derive.
@@ -260,6 +518,35 @@ void OrtBase::OrtBaseImpl::initModelInfo()
 // Run ORT session on processed input image.
 std::vector<OrtBase::DataOutputType> OrtBase::OrtBaseImpl::operator()(
   const std::vector<float *> & inputData)
+{
+  return this->run(inputData, m_inputShapes, m_inputTensorSizes);
+}
+
+// Run ORT session on processed input image with per-call input shapes.
+std::vector<OrtBase::DataOutputType> OrtBase::OrtBaseImpl::operator()(
+  const std::vector<float *> & inputData,
+  const std::vector<std::vector<int64_t>> & inputShapes)
+{
+  if (m_numInputs != inputShapes.size()) {
+    throw std::runtime_error("Mismatch size of input shapes\n");
+  }
+
+  std::vector<int64_t> inputTensorSizes;
+  inputTensorSizes.reserve(m_numInputs);
+  for (const auto & curInputShape : inputShapes) {
+    inputTensorSizes.emplace_back(
+      std::accumulate(std::begin(curInputShape),
+      std::end(curInputShape),
+      1,
+      std::multiplies<int64_t>()));
+  }
+  return this->run(inputData, inputShapes, inputTensorSizes);
+}
+
+std::vector<OrtBase::DataOutputType> OrtBase::OrtBaseImpl::run(
+  const std::vector<float *> & inputData,
+  const std::vector<std::vector<int64_t>> & inputShapes,
+  const std::vector<int64_t> & inputTensorSizes)
 {
   if (m_numInputs != inputData.size()) {
     throw std::runtime_error("Mismatch size of input data\n");
@@ -273,17 +560,33 @@ std::vector<OrtBase::DataOutputType> OrtBase::OrtBaseImpl::operator()(
   for (int i = 0; i < m_numInputs; ++i) {
     inputTensors.emplace_back(std::move(
         Ort::Value::CreateTensor<float>(memoryInfo, const_cast<float *>(inputData[i]),
-        m_inputTensorSizes[i],
-        m_inputShapes[i].data(),
-        m_inputShapes[i].size())));
+        inputTensorSizes[i],
+        inputShapes[i].data(),
+        inputShapes[i].size())));
   }
   // INFERENCE DONE HERE.
-  auto outputTensors = m_session.Run(Ort::RunOptions{nullptr},
-      m_inputNodeNames.data(),
-      inputTensors.data(),
-      m_numInputs,
-      m_outputNodeNames.data(),
-      m_numOutputs);
+  // Every run gets its own RunOptions, so that it can be terminated on its own.
+  std::vector<Ort::Value> outputTensors;
+  {
+    Ort::RunOptions runOptions;
+    RunRegistration registration(runOptions);
+    if (registration.isTerminated()) {
+      throw RunTerminated("Ort session run cancelled before it started.");
+    }
+    try {
+      outputTensors = m_session.Run(runOptions,
+          m_inputNodeNames.data(),
+          inputTensors.data(),
+          m_numInputs,
+          m_outputNodeNames.data(),
+          m_numOutputs);
+    } catch (const Ort::Exception & e) {
+      if (registration.isTerminated()) {
+        throw RunTerminated(e.what());
+      }
+      throw;
+    }
+  }
 
   // Check if outputTensors is empty. It should not be, even if it is garbage.
   assert(outputTensors.size() == m_numOutputs);
@@ -296,6 +599,13 @@ std::vector<OrtBase::DataOutputType> OrtBase::OrtBaseImpl::operator()(
       std::make_pair(std::move(elem.GetTensorMutableData<float>()),
       elem.GetTensorTypeAndShapeInfo().GetShape()));
   }
+
+  // Keep the tensors alive until the next run on this thread. The previous
+  // ones are released outside the lock.
+  {
+    std::lock_guard<std::mutex> lock(m_outputMutex);
+    std::swap(m_threadOutputs[std::this_thread::get_id()], outputTensors);
+  }
   return outputData;
 }
 
@@ -16,6 +16,7 @@
 #define ORT_CPP_LIB__ORT_BASE_HPP_
 
 #include <memory>
+#include <stdexcept>
 #include <string>
 #include <utility>
 #include <vector>
@@ -26,11 +27,82 @@
 
 namespace Ort
 {
+/*! \brief The resized and padded input dimensions derived from an input image
+frame, along with the ratio that maps inference results back onto that frame.*/
+struct FrameGeometry
+{
+  float ratio;
+  int newW, newH, paddedW, paddedH;
+};
+
+/*! \brief The exception thrown by a run of an Ort session that was
+terminated before it completed.*/
+class RunTerminated : public std::runtime_error
+{
+public:
+  using std::runtime_error::runtime_error;
+};
+
+/*! \class RunCanceller
+    \brief A handle that terminates, from any thread, the Ort session runs
+    made by the threads it is bound to with ScopedRunCanceller.\n
+    Once cancelled, the run in flight and every later run it covers fail with
+    RunTerminated until it is reset.
+*/
+class RunCanceller
+{
+public:
+  /*! \brief A Constructor function*/
+  RunCanceller();
+  /*! \brief A Destructor function*/
+  ~RunCanceller();
+  /*! \brief A Mutator function that terminates the runs in flight and
+  every later run until reset.*/
+  void cancel(void);
+  /*! \brief A Mutator function that lets later runs complete again.*/
+  void reset(void);
+  /*! \brief A Getter function that checks if it was cancelled since the last
+  reset.*/
+  bool isCancelled(void) const;
+
+private:
+  friend class RunRegistration;
+  /*! \brief An internal class object that tracks the runs in flight.*/
+  class RunCancellerImpl;
+  /*! \brief A pointer to the RunCancellerImpl*/
+  std::unique_ptr<RunCancellerImpl> impl_;
+};
+
+/*! \class ScopedRunCanceller
+    \brief An RAII helper that binds a RunCanceller to the calling thread for
+    its lifetime, and restores the previously bound one afterwards. Binding a
+    null RunCanceller makes the runs of the thread uncancellable.
+*/
+class ScopedRunCanceller
+{
+public:
+  /*! \brief A Constructor function*/
+  explicit ScopedRunCanceller(RunCanceller * canceller);
+  /*! \brief A Destructor function*/
+  ~ScopedRunCanceller();
+  ScopedRunCanceller(const ScopedRunCanceller &) = delete;
+  ScopedRunCanceller & operator=(const ScopedRunCanceller &) = delete;
+
+private:
+  /*! \brief The RunCanceller bound before this one.*/
+  RunCanceller * m_previous;
+};
+
 /*! \class OrtBase
     \brief An ONNXRuntime (Ort) Base class object.
-    This is the base class for P1OrtBase, P2OrtBase and P3OrtBase. It serves an
+    This is the base class for P1OrtBase and DetectionOrtBase. It serves an
     auxillary class object to directly interface with the ONNXRuntime CPP API
-    to instantiate an Ort session to run as an inference engine.
+    to instantiate an Ort session to run as an inference engine.\n
+    An Ort session may be run by several threads at once. The outputs of a run
+    stay valid until the next run of the same Ort session on the same thread.\n
+    Every run can be terminated midway, either through the RunCanceller bound
+    to its thread or through terminateAll, in which case it throws
+    RunTerminated.
 */
 class OrtBase
 {
@@ -49,9 +121,38 @@ public:
   preprocessed input image data.
   */
   std::vector<DataOutputType> operator()(const std::vector<float *> & inputImgData);
+  /*! \brief A Mutator operator function that conducts inference with
+  preprocessed input image data whose input shapes are given per call instead of
+  the ones fixed when the Ort session was created.
+  */
+  std::vector<DataOutputType> operator()(
+    const std::vector<float *> & inputImgData,
+    const std::vector<std::vector<std::int64_t>> & inputShapes);
   /*! \brief A Getter function that gets the number of outputs which is
   used to determine the level of precision in EPDContainer class object.*/
   int getNumOutputs(void);
+  /*! \brief A Getter function that checks if the first input of the loaded
+  ONNX model accepts a variable batch dimension.*/
+  bool hasDynamicBatch(void);
+  /*! \brief A Mutator function that sets the number of intra-op threads of
+  the global thread pool shared by all Ort sessions. It only takes effect if
+  called before the first Ort session is created. A value of 0 lets ONNXRuntime
+  decide.*/
+  static void setNumThreads(int numThreads);
+  /*! \brief A Mutator function that enables ONNXRuntime profiling, writing
+  to files starting with prefix, for all Ort sessions created afterwards. An
+  empty prefix disables it.*/
+  static void setProfilingPrefix(const std::string & prefix);
+  /*! \brief A Mutator function that stops ONNXRuntime profiling of this Ort
+  session and gets the path of the written profiling file, or an empty string
+  if it was not profiling.*/
+  std::string endProfiling(void);
+  /*! \brief A Getter function that gets the time at which this Ort session
+  started profiling, in nanoseconds on std::chrono::steady_clock.*/
+  int64_t getProfilingStartNs(void);
+  /*! \brief A Mutator function that terminates the runs in flight of every
+  Ort session and every later run, for a prompt shutdown.*/
+  static void terminateAll(void);
 
 private:
   /*! \brief An internal class object that interfaces with Ort CPP API.*/
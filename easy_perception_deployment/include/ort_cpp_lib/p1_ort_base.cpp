@@ -15,12 +15,15 @@
 
 #include <algorithm>
 #include <cstring>
+#include <memory>
 #include <numeric>
 #include <string>
 #include <vector>
 #include <utility>
 
 #include "p1_ort_base.hpp"
+#include "epd_utils_lib/inference_config.hpp"
+#include "epd_utils_lib/stage_observer.hpp"
 
 void softmax(float * input, const size_t inputLen)
 {
@@ -60,25 +63,120 @@ P1OrtBase::P1OrtBase(
 // Destructor
 P1OrtBase::~P1OrtBase() {}
 
+P1OrtBase::RunBuffers & P1OrtBase::getRunBuffers()
+{
+  thread_local RunBuffers buffers;
+  return buffers;
+}
+
 // Mutator 4
 std::vector<std::string> P1OrtBase::infer(const cv::Mat & inputImg)
 {
-  cv::Mat tmpImg;
-  cv::resize(inputImg, tmpImg, cv::Size(m_newW, m_newH));
+  EPD::EPDImageClassification result;
+  this->infer(inputImg, result);
+  return this->getNames(result);
+}
+
+// Mutator 4
+void P1OrtBase::infer(const cv::Mat & inputImg, EPD::EPDImageClassification & result)
+{
+  this->infer(inputImg, *EPD::getInferenceConfig(), result);
+}
 
+// Mutator 4
+void P1OrtBase::infer(
+  const cv::Mat & inputImg,
+  const EPD::InferenceConfig & config,
+  EPD::EPDImageClassification & result)
+{
   static constexpr int64_t IMG_CHANNEL = 3;
-  float * dst = new float[m_newW * m_newH * IMG_CHANNEL];
+  RunBuffers & buffers = getRunBuffers();
+  buffers.inputData.resize(m_newW * m_newH * IMG_CHANNEL);
 
-  static const std::vector<float> IMAGENET_MEAN = {0.406, 0.456, 0.485};
-  static const std::vector<float> IMAGENET_STD = {0.225, 0.224, 0.229};
+  {
+    EPD::ScopedStage stage(EPD::Stage::PREPROCESS);
+    cv::resize(inputImg, buffers.resizedImg, cv::Size(m_newW, m_newH));
 
-  this->preprocess(dst, tmpImg.data, m_newW, m_newH, IMG_CHANNEL,
-    IMAGENET_MEAN, IMAGENET_STD);
-  auto inferenceOutput = (*this)({reinterpret_cast<float *>(dst)});
+    preprocess(buffers.inputData.data(), buffers.resizedImg.data, m_newW, m_newH, IMG_CHANNEL,
+      config.classificationMean, config.classificationStd);
+  }
+
+  std::vector<DataOutputType> inferenceOutput;
+  {
+    EPD::ScopedStage stage(EPD::Stage::INFERENCE);
+    inferenceOutput = (*this)({buffers.inputData.data()});
+  }
 
   const int TOP_K = 1;
 
-  return this->processTopK({inferenceOutput[0].first}, TOP_K);
+  EPD::ScopedStage stage(EPD::Stage::DECODE);
+  processTopK(inferenceOutput[0].first, m_numClasses, result, TOP_K);
+}
+
+// Mutator 4
+std::vector<std::vector<std::string>> P1OrtBase::infer(const std::vector<cv::Mat> & inputImgs)
+{
+  std::vector<EPD::EPDImageClassification> results;
+  this->infer(inputImgs, results);
+
+  std::vector<std::vector<std::string>> batchOutput;
+  batchOutput.reserve(results.size());
+  for (const auto & result : results) {
+    batchOutput.emplace_back(this->getNames(result));
+  }
+  return batchOutput;
+}
+
+// Mutator 4
+void P1OrtBase::infer(
+  const std::vector<cv::Mat> & inputImgs,
+  std::vector<EPD::EPDImageClassification> & results)
+{
+  this->infer(inputImgs, *EPD::getInferenceConfig(), results);
+}
+
+// Mutator 4
+void P1OrtBase::infer(
+  const std::vector<cv::Mat> & inputImgs,
+  const EPD::InferenceConfig & config,
+  std::vector<EPD::EPDImageClassification> & results)
+{
+  results.resize(inputImgs.size());
+
+  if (inputImgs.size() == 1 || !this->hasDynamicBatch()) {
+    for (size_t n = 0; n < inputImgs.size(); ++n) {
+      this->infer(inputImgs[n], config, results[n]);
+    }
+    return;
+  }
+
+  static constexpr int64_t IMG_CHANNEL = 3;
+  const int64_t batchSize = inputImgs.size();
+  const int64_t imgDataLength = m_newW * m_newH * IMG_CHANNEL;
+  RunBuffers & buffers = getRunBuffers();
+  buffers.inputData.resize(batchSize * imgDataLength);
+
+  {
+    EPD::ScopedStage stage(EPD::Stage::PREPROCESS);
+    for (int64_t n = 0; n < batchSize; ++n) {
+      cv::resize(inputImgs[n], buffers.resizedImg, cv::Size(m_newW, m_newH));
+      preprocess(buffers.inputData.data() + n * imgDataLength, buffers.resizedImg.data,
+        m_newW, m_newH, IMG_CHANNEL, config.classificationMean, config.classificationStd);
+    }
+  }
+
+  std::vector<DataOutputType> inferenceOutput;
+  {
+    EPD::ScopedStage stage(EPD::Stage::INFERENCE);
+    inferenceOutput = (*this)({buffers.inputData.data()},
+        {{batchSize, IMG_CHANNEL, m_newH, m_newW}});
+  }
+
+  const int TOP_K = 1;
+  EPD::ScopedStage stage(EPD::Stage::DECODE);
+  for (int64_t n = 0; n < batchSize; ++n) {
+    processTopK(inferenceOutput[0].first + n * m_numClasses, m_numClasses, results[n], TOP_K);
+  }
 }
 
 // Mutator 3
@@ -98,7 +196,7 @@ void P1OrtBase::preprocess(
   const int64_t targetImgHeight,
   const size_t numChannels,
   const std::vector<float> & meanVal,
-  const std::vector<float> & stdVal) const
+  const std::vector<float> & stdVal)
 {
   /* Check if meanVal and stdVal vector arrays are empty.
   If true, check if meanVal size corresponds to stdVal size.
@@ -137,46 +235,41 @@ void P1OrtBase::preprocess(
   }
 }
 
-std::vector<std::pair<int, float>>
-P1OrtBase::getTopKRaw(
-  const std::vector<float *> & inferenceOutput,
+void P1OrtBase::processTopK(
+  float * processData,
+  const uint16_t numClasses,
+  EPD::EPDImageClassification & result,
   const uint16_t k,
-  const bool useSoftmax) const
+  const bool useSoftmax)
 {
-  const uint16_t realK = std::max(std::min(k, m_numClasses), static_cast<uint16_t>(1));
+  const uint16_t realK = std::max(std::min(k, numClasses), static_cast<uint16_t>(1));
 
-  assert(inferenceOutput.size() == 1);
-  float * processData = inferenceOutput[0];
   if (useSoftmax) {
-    softmax(processData, m_numClasses);
+    softmax(processData, numClasses);
   }
 
-  std::vector<std::pair<int, float>> ps;
-  ps.reserve(m_numClasses);
+  // Only the top k classes are sorted, in the buffer of the calling thread.
+  std::vector<uint16_t> & classOrder = getRunBuffers().classOrder;
+  classOrder.resize(numClasses);
+  std::iota(classOrder.begin(), classOrder.end(), 0);
+  std::partial_sort(classOrder.begin(), classOrder.begin() + realK, classOrder.end(),
+    [processData](const uint16_t lhs, const uint16_t rhs)
+    {return processData[lhs] > processData[rhs];});
 
-  for (int i = 0; i < m_numClasses; ++i) {
-    ps.emplace_back(std::make_pair(i, processData[i]));
+  result.clear();
+  for (uint16_t i = 0; i < realK; ++i) {
+    result.add(classOrder[i], processData[classOrder[i]]);
   }
-
-  std::sort(ps.begin(), ps.end(), [](const auto & elem1, const auto & elem2)
-    {return elem1.second > elem2.second;});
-
-  return std::vector<std::pair<int, float>>(ps.begin(), ps.begin() + realK);
 }
 
 std::vector<std::string>
-P1OrtBase::processTopK(
-  const std::vector<float *> & inferenceOutput,
-  const uint16_t k,
-  const bool useSoftmax) const
+P1OrtBase::getNames(const EPD::EPDImageClassification & result) const
 {
-  auto ps = this->getTopKRaw(inferenceOutput, k, useSoftmax);
-
-  std::vector<std::string> topK_obj_identities;
-  for (const auto & elem : ps) {
-    topK_obj_identities.push_back(m_classNames[elem.first]);
+  std::vector<std::string> names;
+  names.reserve(result.size());
+  for (const uint64_t classIdx : result.classIndices) {
+    names.push_back(m_classNames[classIdx]);
   }
-
-  return topK_obj_identities;
+  return names;
 }
 }  // namespace Ort
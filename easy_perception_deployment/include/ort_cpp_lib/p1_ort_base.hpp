@@ -23,6 +23,8 @@
 
 #include "opencv2/opencv.hpp"
 #include "ort_cpp_lib/ort_base.hpp"
+#include "epd_utils_lib/inference_config.hpp"
+#include "epd_utils_lib/message_utils.hpp"
 
 namespace Ort
 {
@@ -30,7 +32,9 @@ namespace Ort
     \brief An Precision-Level 1 (P1) ONNXRuntime (Ort) Base class object.
     This class object instantiates a Precision Level 1 Ort Session which takes a
     typical ONNX model used for solely image classification and
-    runs an inferenc engine.
+    runs an inferenc engine.\n
+    Both infer functions may be called by several threads at once, as each
+    thread runs with its own buffers.
 */
 class P1OrtBase : public OrtBase
 {
@@ -55,6 +59,59 @@ public:
   /*! \brief A Mutator function that runs the P1 Ort Session and gets P1
   inference result.*/
   std::vector<std::string> infer(const cv::Mat & inputImg);
+  /*! \brief A Mutator function that runs the P1 Ort Session and gets P1
+  inference result as class indices and scores into result, which may be
+  reused across frames to avoid heap allocations per frame.*/
+  void infer(const cv::Mat & inputImg, EPD::EPDImageClassification & result);
+  /*! \brief A Mutator function that runs the P1 Ort Session with the
+  inference parameters of config, the snapshot a frame took, and gets P1
+  inference result as class indices and scores into result.*/
+  void infer(
+    const cv::Mat & inputImg,
+    const EPD::InferenceConfig & config,
+    EPD::EPDImageClassification & result);
+  /*! \brief A Mutator function that runs the P1 Ort Session once over a batch
+  of input images and gets P1 inference result for each of them.\n
+  Falls back to one run per image if the ONNX model has a fixed batch size.
+  */
+  std::vector<std::vector<std::string>> infer(const std::vector<cv::Mat> & inputImgs);
+  /*! \brief A Mutator function that runs the P1 Ort Session once over a batch
+  of input images and gets P1 inference result for each of them as class
+  indices and scores into results, which is resized to the batch size.
+  */
+  void infer(
+    const std::vector<cv::Mat> & inputImgs,
+    std::vector<EPD::EPDImageClassification> & results);
+  /*! \brief A Mutator function that runs the P1 Ort Session once over a batch
+  of input images with the inference parameters of config, the snapshot a
+  frame took, and gets P1 inference result for each of them into results.
+  */
+  void infer(
+    const std::vector<cv::Mat> & inputImgs,
+    const EPD::InferenceConfig & config,
+    std::vector<EPD::EPDImageClassification> & results);
+  /*! \brief A Mutator function that converts a 3-layered 2D RGB input image
+  into a 1D input data tensor to be passed to the Ort Session for processing.\n
+  This variant takes a generic input image represented by a char pointer.
+  */
+  static void preprocess(
+    float * dst,
+    const unsigned char * src,
+    const int64_t targetImgWidth,
+    const int64_t targetImgHeight,
+    const size_t numChannels,
+    const std::vector<float> & meanVal = {},
+    const std::vector<float> & stdVal = {});
+  /*! \brief A Mutator function that takes the raw scores of numClasses
+  classes, optionally applies softmax on them in place and gets the k most
+  possible object identities into result, in descending order of score.*/
+  static void processTopK(
+    float * processData,
+    const uint16_t numClasses,
+    EPD::EPDImageClassification & result,
+    const uint16_t k = 1,
+    const bool useSoftmax = true);
+
   /*! \brief A Getter function that gets the number of object names used for an
   ongoing session.*/
   uint16_t getNumClasses() const {return m_numClasses;}
@@ -77,34 +134,24 @@ private:
   int m_newW, m_newH, m_paddedW, m_paddedH;
   /*! \brief A vector of object text labels given an input label list.*/
   std::vector<std::string> m_classNames;
+  /*! \brief The buffers of a run, reused across frames by each thread to
+  avoid heap allocations per frame.*/
+  struct RunBuffers
+  {
+    /*! \brief The input data tensor.*/
+    std::vector<float> inputData;
+    /*! \brief The resized input image.*/
+    cv::Mat resizedImg;
+    /*! \brief The class indices of an image, sorted by score.*/
+    std::vector<uint16_t> classOrder;
+  };
+  /*! \brief A Getter function that gets the RunBuffers of the calling
+  thread.*/
+  static RunBuffers & getRunBuffers();
 
-  /*! \brief A Mutator function that converts a 3-layered 2D RGB input image
-  into a 1D input data tensor to be passed to the Ort Session for processing.\n
-  This variant takes a generic input image represented by a char pointer.
-  */
-  void preprocess(
-    float * dst,
-    const unsigned char * src,
-    const int64_t targetImgWidth,
-    const int64_t targetImgHeight,
-    const size_t numChannels,
-    const std::vector<float> & meanVal = {},
-    const std::vector<float> & stdVal = {}) const;
-  /*! \brief An Mutator function that takes the inference output and determines
-  the most possible object identity given an input label list.
-  */
-  std::vector<std::pair<int, float>> getTopKRaw(
-    const std::vector<float *> & inferenceOutput,
-    const uint16_t k = 1,
-    const bool useSoftmax = true) const;
-
-  /*! \brief A Mutator function that takes the inference output and determines
-  the most possible object identity given an input label list.
-  */
-  std::vector<std::string> processTopK(
-    const std::vector<float *> & inferenceOutput,
-    const uint16_t k = 1,
-    const bool useSoftmax = true) const;
+  /*! \brief A Getter function that gets the object text labels of the
+  classes of result.*/
+  std::vector<std::string> getNames(const EPD::EPDImageClassification & result) const;
 };
 }  // namespace Ort
 
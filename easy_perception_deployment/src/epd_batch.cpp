@@ -0,0 +1,468 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/* epd_batch runs the EPDContainer configured by data/session_config.txt and
+data/usecase_config.txt over every image of a directory, or every frame of a
+video file, without a ROS graph, and writes the results to a columnar file
+as described in epd_utils_lib/columnar_file.hpp.
+
+Usage: epd_batch (--images DIR | --video FILE) [--output FILE]
+                 [--decoders N] [--workers N] [--threads N] [--prefetch N]
+A pool of decoder threads reads ahead of a pool of worker threads that share
+one Ort session, whose runs in turn share the intra-op threads set by
+--threads. Images are decoded in parallel, while video frames can only be
+decoded in order by a single decoder. Run it from the easy_perception_deployment
+package directory, the same as the processor node.
+
+The output holds one row per input frame in the frame.* columns and one row
+per result in the result.* columns, where result.frame is the row of its
+frame. P1 results carry the softmax score of their class and a bounding box
+that covers the whole frame. Masks are not written. A summary, including the
+images processed per second, is printed as JSON. */
+
+#include <dirent.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// OPENCV LIB
+#include "opencv2/opencv.hpp"
+
+// EPD_UTILS LIB
+#include "epd_utils_lib/columnar_file.hpp"
+#include "epd_utils_lib/epd_container.hpp"
+
+/*! \brief The command-line options of epd_batch.*/
+struct BatchOptions
+{
+  std::string image_dir;
+  std::string video_path;
+  std::string output_path = "epd_batch_results.bin";
+  int decoders = 0;
+  int workers = 2;
+  int threads = 0;
+  int prefetch = 0;
+};
+
+/*! \brief A decoded input frame and its row in the output.*/
+struct DecodedFrame
+{
+  size_t index;
+  cv::Mat image;
+};
+
+/*! \brief The results of one input frame.*/
+struct FrameResult
+{
+  std::string source;
+  int width = 0, height = 0;
+  double latency_ms = 0.0;
+  std::vector<int64_t> class_indices;
+  std::vector<std::string> labels;
+  std::vector<float> scores;
+  std::vector<std::array<float, 4>> bboxes;
+};
+
+/*! \class FrameQueue
+    \brief A bounded queue of decoded frames between the decoders and the
+    workers. Decoders block while it is full, which caps the memory held by
+    frames decoded ahead.
+*/
+class FrameQueue
+{
+public:
+  explicit FrameQueue(size_t capacity)
+  : m_capacity(capacity), m_closed(false)
+  {}
+
+  /*! \brief A Mutator function that adds a frame, waiting for room.*/
+  void push(DecodedFrame frame)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_notFull.wait(lock, [this]() {return m_frames.size() < m_capacity;});
+    m_frames.push_back(std::move(frame));
+    m_notEmpty.notify_one();
+  }
+
+  /*! \brief A Mutator function that takes a frame, waiting for one. Returns
+  false once the queue is closed and empty.*/
+  bool pop(DecodedFrame & frame)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_notEmpty.wait(lock, [this]() {return !m_frames.empty() || m_closed;});
+    if (m_frames.empty()) {
+      return false;
+    }
+    frame = std::move(m_frames.front());
+    m_frames.pop_front();
+    m_notFull.notify_one();
+    return true;
+  }
+
+  /*! \brief A Mutator function that marks that no more frames will be
+  added.*/
+  void close()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_closed = true;
+    m_notEmpty.notify_all();
+  }
+
+private:
+  const size_t m_capacity;
+  bool m_closed;
+  std::mutex m_mutex;
+  std::condition_variable m_notEmpty, m_notFull;
+  std::deque<DecodedFrame> m_frames;
+};
+
+void printUsage()
+{
+  std::cerr << "Usage: epd_batch (--images DIR | --video FILE) [--output FILE]\n"
+            << "                 [--decoders N] [--workers N] [--threads N] [--prefetch N]\n";
+}
+
+bool parseOptions(int argc, char * argv[], BatchOptions & options)
+{
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--help" || arg == "-h") {
+      return false;
+    }
+    if (i + 1 >= argc) {
+      std::cerr << "[ERROR] Missing value for " << arg << std::endl;
+      return false;
+    }
+    const std::string value = argv[++i];
+
+    if (arg == "--images") {
+      options.image_dir = value;
+    } else if (arg == "--video") {
+      options.video_path = value;
+    } else if (arg == "--output") {
+      options.output_path = value;
+    } else if (arg == "--decoders") {
+      options.decoders = std::max(0, std::atoi(value.c_str()));
+    } else if (arg == "--workers") {
+      options.workers = std::max(1, std::atoi(value.c_str()));
+    } else if (arg == "--threads") {
+      options.threads = std::max(0, std::atoi(value.c_str()));
+    } else if (arg == "--prefetch") {
+      options.prefetch = std::max(0, std::atoi(value.c_str()));
+    } else {
+      std::cerr << "[ERROR] Unknown option " << arg << std::endl;
+      return false;
+    }
+  }
+  if (options.image_dir.empty() == options.video_path.empty()) {
+    std::cerr << "[ERROR] Give exactly one of --images and --video" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+std::vector<std::string> listImages(const std::string & image_dir)
+{
+  DIR * dir = opendir(image_dir.c_str());
+  if (dir == nullptr) {
+    throw std::runtime_error("Unable to open image directory " + image_dir);
+  }
+  std::vector<std::string> paths;
+  while (struct dirent * entry = readdir(dir)) {
+    if (entry->d_name[0] != '.') {
+      paths.push_back(image_dir + "/" + entry->d_name);
+    }
+  }
+  closedir(dir);
+  std::sort(paths.begin(), paths.end());
+  if (paths.empty()) {
+    throw std::runtime_error("No images in " + image_dir);
+  }
+  return paths;
+}
+
+/*! \brief A Mutator function that runs one frame through the Ort session
+selected by ortAgent and keeps its results.*/
+void runFrame(
+  EPD::EPDContainer & ortAgent, EPD::EPDObjectDetection & detection,
+  EPD::EPDImageClassification & classification,
+  const cv::Mat & img, FrameResult & result)
+{
+  const std::vector<std::string> & classNames = ortAgent.classNames;
+  const std::shared_ptr<const EPD::InferenceConfig> config = EPD::getInferenceConfig();
+
+  if (ortAgent.precision_level == 1) {
+    const float width = img.cols, height = img.rows;
+    ortAgent.p1_ort_session->infer(img, *config, classification);
+    for (size_t i = 0; i < classification.size(); ++i) {
+      const uint64_t classIdx = classification.classIndices[i];
+      result.class_indices.push_back(classIdx);
+      result.labels.push_back(classNames[classIdx]);
+      result.scores.push_back(classification.scores[i]);
+      result.bboxes.push_back({0.0f, 0.0f, width, height});
+    }
+    return;
+  }
+
+  const Ort::FrameGeometry geometry =
+    EPD::EPDContainer::computeFrameGeometry(img.cols, img.rows);
+  if (ortAgent.precision_level == 2) {
+    ortAgent.p2_ort_session->infer_action(img, geometry, *config, detection);
+  } else {
+    ortAgent.p3_ort_session->infer_action(img, geometry, *config, detection);
+  }
+  if (ortAgent.isCascade()) {
+    ortAgent.classifyDetections(img, *config, detection);
+  }
+
+  const bool hasCascadeNames = detection.cascadeNames.size() == detection.size();
+  for (size_t i = 0; i < detection.size(); ++i) {
+    const uint64_t classIdx = detection.classIndices[i];
+    result.class_indices.push_back(static_cast<int64_t>(classIdx));
+    if (hasCascadeNames) {
+      result.labels.push_back(detection.cascadeNames[i]);
+    } else {
+      result.labels.push_back(classIdx < classNames.size() ? classNames[classIdx] : "");
+    }
+    result.scores.push_back(detection.scores[i]);
+    result.bboxes.push_back(detection.bboxes[i]);
+  }
+}
+
+/*! \brief A Mutator function that writes every result as columns, in the
+order of the input frames.*/
+size_t writeResults(const std::vector<FrameResult> & results, const std::string & path)
+{
+  std::vector<std::string> sources;
+  std::vector<int32_t> widths, heights;
+  std::vector<double> latencies;
+  std::vector<uint32_t> numResults;
+
+  std::vector<uint32_t> resultFrames;
+  std::vector<int64_t> classIndices;
+  std::vector<std::string> labels;
+  std::vector<float> scores;
+  std::vector<std::vector<float>> bboxColumns(4);
+
+  for (size_t i = 0; i < results.size(); ++i) {
+    const FrameResult & result = results[i];
+    sources.push_back(result.source);
+    widths.push_back(result.width);
+    heights.push_back(result.height);
+    latencies.push_back(result.latency_ms);
+    numResults.push_back(result.labels.size());
+
+    resultFrames.insert(resultFrames.end(), result.labels.size(), i);
+    classIndices.insert(classIndices.end(),
+      result.class_indices.begin(), result.class_indices.end());
+    labels.insert(labels.end(), result.labels.begin(), result.labels.end());
+    scores.insert(scores.end(), result.scores.begin(), result.scores.end());
+    for (const auto & bbox : result.bboxes) {
+      for (size_t c = 0; c < 4; ++c) {
+        bboxColumns[c].push_back(bbox[c]);
+      }
+    }
+  }
+
+  EPD::ColumnarWriter writer;
+  writer.addColumn("frame.source", sources);
+  writer.addColumn("frame.width", widths);
+  writer.addColumn("frame.height", heights);
+  writer.addColumn("frame.latency_ms", latencies);
+  writer.addColumn("frame.num_results", numResults);
+  writer.addColumn("result.frame", resultFrames);
+  writer.addColumn("result.class_index", classIndices);
+  writer.addColumn("result.label", labels);
+  writer.addColumn("result.score", scores);
+  writer.addColumn("result.xmin", bboxColumns[0]);
+  writer.addColumn("result.ymin", bboxColumns[1]);
+  writer.addColumn("result.xmax", bboxColumns[2]);
+  writer.addColumn("result.ymax", bboxColumns[3]);
+  writer.write(path);
+  return labels.size();
+}
+
+int main(int argc, char * argv[])
+{
+  setlinebuf(stdout);
+
+  BatchOptions options;
+  if (!parseOptions(argc, argv, options)) {
+    printUsage();
+    return 1;
+  }
+
+  const int numCores = std::max(1u, std::thread::hardware_concurrency());
+  // Video frames can only be decoded in order.
+  const int numDecoders = options.video_path.empty() ?
+    (options.decoders > 0 ? options.decoders : std::max(1, numCores / 4)) : 1;
+  const size_t prefetch = options.prefetch > 0 ?
+    options.prefetch : 4 * static_cast<size_t>(options.workers);
+
+  // Must happen before the first Ort session creates the shared Env.
+  if (options.threads > 0) {
+    Ort::OrtBase::setNumThreads(options.threads);
+    setenv("OMP_NUM_THREADS", std::to_string(options.threads).c_str(), 1);
+  }
+
+  std::vector<std::string> imagePaths;
+  cv::VideoCapture video;
+  try {
+    if (options.video_path.empty()) {
+      imagePaths = listImages(options.image_dir);
+    } else if (!video.open(options.video_path)) {
+      throw std::runtime_error("Unable to open video " + options.video_path);
+    }
+  } catch (const std::exception & e) {
+    std::cerr << "[ERROR] " << e.what() << std::endl;
+    return 1;
+  }
+
+  EPD::EPDContainer ortAgent;
+  FrameQueue queue(prefetch);
+  std::vector<FrameResult> results(imagePaths.size());
+  std::mutex resultsMutex;
+  std::exception_ptr workerError;
+  size_t numFailed = 0;
+
+  const auto batchStart = std::chrono::steady_clock::now();
+
+  std::vector<std::thread> workers;
+  for (int w = 0; w < options.workers; ++w) {
+    workers.emplace_back(
+      [&]() {
+        EPD::EPDObjectDetection detection;
+        EPD::EPDImageClassification classification;
+        DecodedFrame frame;
+        while (queue.pop(frame)) {
+          FrameResult result;
+          result.source = options.video_path.empty() ?
+          imagePaths[frame.index] : options.video_path + "#" + std::to_string(frame.index);
+          result.width = frame.image.cols;
+          result.height = frame.image.rows;
+
+          bool failed = frame.image.empty();
+          if (!failed) {
+            try {
+              ortAgent.initialize(frame.image.cols, frame.image.rows);
+              const auto start = std::chrono::steady_clock::now();
+              runFrame(ortAgent, detection, classification, frame.image, result);
+              result.latency_ms = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count();
+            } catch (...) {
+              std::lock_guard<std::mutex> lock(resultsMutex);
+              if (!workerError) {
+                workerError = std::current_exception();
+              }
+              failed = true;
+            }
+          }
+
+          std::lock_guard<std::mutex> lock(resultsMutex);
+          numFailed += failed;
+          if (frame.index >= results.size()) {
+            results.resize(frame.index + 1);
+          }
+          results[frame.index] = std::move(result);
+        }
+      });
+  }
+
+  std::vector<std::thread> decoders;
+  std::atomic<size_t> nextImage(0);
+  for (int d = 0; d < numDecoders; ++d) {
+    decoders.emplace_back(
+      [&]() {
+        if (!options.video_path.empty()) {
+          for (size_t idx = 0;; ++idx) {
+            cv::Mat frame;
+            if (!video.read(frame)) {
+              break;
+            }
+            queue.push({idx, frame});
+          }
+          return;
+        }
+        // Unreadable images are queued empty, so that they keep their row.
+        for (size_t idx = nextImage++; idx < imagePaths.size(); idx = nextImage++) {
+          queue.push({idx, cv::imread(imagePaths[idx], CV_LOAD_IMAGE_COLOR)});
+        }
+      });
+  }
+  for (auto & decoder : decoders) {
+    decoder.join();
+  }
+  queue.close();
+  for (auto & worker : workers) {
+    worker.join();
+  }
+
+  const double totalSec = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - batchStart).count();
+
+  if (workerError) {
+    try {
+      std::rethrow_exception(workerError);
+    } catch (const std::exception & e) {
+      std::cerr << "[ERROR] " << e.what() << std::endl;
+    }
+  }
+
+  size_t numResults = 0;
+  try {
+    numResults = writeResults(results, options.output_path);
+  } catch (const std::exception & e) {
+    std::cerr << "[ERROR] " << e.what() << std::endl;
+    return 1;
+  }
+
+  double totalLatencyMs = 0.0;
+  for (const auto & result : results) {
+    totalLatencyMs += result.latency_ms;
+  }
+  const size_t numProcessed = results.size() - numFailed;
+
+  std::cout << "{\n";
+  std::cout << "  \"model\": \"" << ortAgent.onnx_model_path << "\",\n";
+  std::cout << "  \"precision_level\": " << ortAgent.precision_level << ",\n";
+  std::cout << "  \"input\": \"" <<
+  (options.video_path.empty() ? options.image_dir : options.video_path) << "\",\n";
+  std::cout << "  \"output\": \"" << options.output_path << "\",\n";
+  std::cout << "  \"num_frames\": " << results.size() << ",\n";
+  std::cout << "  \"num_failed\": " << numFailed << ",\n";
+  std::cout << "  \"num_results\": " << numResults << ",\n";
+  std::cout << "  \"decoders\": " << numDecoders << ",\n";
+  std::cout << "  \"workers\": " << options.workers << ",\n";
+  std::cout << "  \"threads\": " << options.threads << ",\n";
+  std::cout << "  \"elapsed_s\": " << totalSec << ",\n";
+  std::cout << "  \"images_per_sec\": " << numProcessed / totalSec << ",\n";
+  std::cout << "  \"mean_latency_ms\": " <<
+  (numProcessed > 0 ? totalLatencyMs / numProcessed : 0.0) << "\n";
+  std::cout << "}\n";
+  return workerError ? 1 : 0;
+}
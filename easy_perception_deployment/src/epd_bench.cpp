@@ -0,0 +1,517 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/* epd_bench runs the EPDContainer configured by data/session_config.txt and
+data/usecase_config.txt over a local image directory or synthetic frames,
+without a ROS graph or a camera, and reports the results as JSON.
+
+Usage: epd_bench [--images DIR | --synthetic WxH] [--iterations N]
+                 [--warmup N] [--threads N] [--cold-start N] [--output FILE]
+Run it from the easy_perception_deployment package directory, the same as
+the processor node. To benchmark offline, point session_config.txt at one of
+the models in data/fixtures. When built with EPD_ALLOC_AUDIT, the report also
+lists the heap allocations made per frame in each stage.
+With --cold-start N, epd_bench instead launches itself N times as a new
+process that only starts up an EPDContainer, and reports the time of every
+launch and of every startup phase. */
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// OPENCV LIB
+#include "opencv2/opencv.hpp"
+
+// EPD_UTILS LIB
+#include "epd_utils_lib/alloc_audit.hpp"
+#include "epd_utils_lib/epd_container.hpp"
+#include "epd_utils_lib/stage_observer.hpp"
+
+/*! \brief The command-line options of epd_bench.*/
+struct BenchOptions
+{
+  std::string image_dir;
+  int synthetic_width = 1280;
+  int synthetic_height = 720;
+  int iterations = 100;
+  int warmup = 10;
+  int threads = 0;
+  int cold_starts = 0;
+  bool cold_start_child = false;
+  std::string output_path;
+};
+
+/*! \brief The prefix of the line a cold start child process reports its
+precision level and startup phase times on.*/
+const char COLD_START_MARKER[] = "[-Cold Start-]=";
+
+/*! \brief The latency statistics of a list of samples, in ms.*/
+struct LatencyStats
+{
+  double mean = 0.0, p50 = 0.0, p90 = 0.0, p99 = 0.0, max = 0.0;
+};
+
+void printUsage()
+{
+  std::cerr << "Usage: epd_bench [--images DIR | --synthetic WxH] [--iterations N]\n"
+            << "                 [--warmup N] [--threads N] [--cold-start N] [--output FILE]\n";
+}
+
+bool parseOptions(int argc, char * argv[], BenchOptions & options)
+{
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--help" || arg == "-h") {
+      return false;
+    }
+    if (arg == "--cold-start-child") {
+      options.cold_start_child = true;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      std::cerr << "[ERROR] Missing value for " << arg << std::endl;
+      return false;
+    }
+    const std::string value = argv[++i];
+
+    if (arg == "--images") {
+      options.image_dir = value;
+    } else if (arg == "--synthetic") {
+      if (sscanf(value.c_str(), "%dx%d",
+        &options.synthetic_width, &options.synthetic_height) != 2 ||
+        options.synthetic_width <= 0 || options.synthetic_height <= 0)
+      {
+        std::cerr << "[ERROR] Invalid --synthetic " << value << std::endl;
+        return false;
+      }
+    } else if (arg == "--iterations") {
+      options.iterations = std::max(1, std::atoi(value.c_str()));
+    } else if (arg == "--warmup") {
+      options.warmup = std::max(0, std::atoi(value.c_str()));
+    } else if (arg == "--threads") {
+      options.threads = std::max(0, std::atoi(value.c_str()));
+    } else if (arg == "--cold-start") {
+      options.cold_starts = std::max(1, std::atoi(value.c_str()));
+    } else if (arg == "--output") {
+      options.output_path = value;
+    } else {
+      std::cerr << "[ERROR] Unknown option " << arg << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+std::vector<cv::Mat> loadFrames(const BenchOptions & options)
+{
+  std::vector<cv::Mat> frames;
+
+  if (options.image_dir.empty()) {
+    // Seeded noise so that every run sees the same synthetic frames.
+    cv::RNG rng(12345);
+    cv::Mat frame(options.synthetic_height, options.synthetic_width, CV_8UC3);
+    rng.fill(frame, cv::RNG::UNIFORM, 0, 256);
+    frames.push_back(frame);
+    return frames;
+  }
+
+  DIR * dir = opendir(options.image_dir.c_str());
+  if (dir == nullptr) {
+    throw std::runtime_error("Unable to open image directory " + options.image_dir);
+  }
+  std::vector<std::string> paths;
+  while (struct dirent * entry = readdir(dir)) {
+    if (entry->d_name[0] != '.') {
+      paths.push_back(options.image_dir + "/" + entry->d_name);
+    }
+  }
+  closedir(dir);
+  std::sort(paths.begin(), paths.end());
+
+  for (const auto & path : paths) {
+    cv::Mat frame = cv::imread(path, CV_LOAD_IMAGE_COLOR);
+    if (!frame.empty()) {
+      frames.push_back(frame);
+    }
+  }
+  if (frames.empty()) {
+    throw std::runtime_error("No readable images in " + options.image_dir);
+  }
+  return frames;
+}
+
+LatencyStats computeStats(std::vector<double> samples)
+{
+  LatencyStats stats;
+  if (samples.empty()) {
+    return stats;
+  }
+  std::sort(samples.begin(), samples.end());
+
+  auto percentile = [&samples](double p) {
+      size_t idx = static_cast<size_t>(p * (samples.size() - 1) + 0.5);
+      return samples[std::min(idx, samples.size() - 1)];
+    };
+
+  stats.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+  stats.p50 = percentile(0.50);
+  stats.p90 = percentile(0.90);
+  stats.p99 = percentile(0.99);
+  stats.max = samples.back();
+  return stats;
+}
+
+void writeStats(std::ostream & os, const LatencyStats & stats)
+{
+  os << "{\"mean\": " << stats.mean << ", \"p50\": " << stats.p50 <<
+    ", \"p90\": " << stats.p90 << ", \"p99\": " << stats.p99 <<
+    ", \"max\": " << stats.max << "}";
+}
+
+/*! \brief A Getter function that writes the allocations of a stage, averaged
+over numFrames frames, as a JSON member.*/
+void writeAllocStats(
+  std::ostream & os, const std::string & name,
+  const EPD::AllocStats & stats, int numFrames)
+{
+  os << "\n    \"" << name << "\": {\"count\": " <<
+    static_cast<double>(stats.count) / numFrames << ", \"bytes\": " <<
+    static_cast<double>(stats.bytes) / numFrames << "}";
+}
+
+/*! \brief A Getter function that quotes an argument for the shell.*/
+std::string shellQuote(const std::string & arg)
+{
+  std::string quoted = "'";
+  for (const char c : arg) {
+    quoted += (c == '\'') ? std::string("'\\''") : std::string(1, c);
+  }
+  return quoted + "'";
+}
+
+/*! \brief A Mutator function that writes report to the output file of
+options, or to stdout if there is none.*/
+int writeReport(const BenchOptions & options, const std::string & report)
+{
+  if (options.output_path.empty()) {
+    std::cout << report;
+    return 0;
+  }
+  std::ofstream outputFile(options.output_path);
+  if (!outputFile) {
+    std::cerr << "[ERROR] Unable to write " << options.output_path << std::endl;
+    return 1;
+  }
+  outputFile << report;
+  return 0;
+}
+
+/*! \brief A Mutator function that starts up an EPDContainer as a cold start
+child process does, and reports its precision level and the time of every
+startup phase on stdout.*/
+void runColdStartChild(const BenchOptions & options)
+{
+  EPD::EPDContainer ortAgent;
+  const std::vector<cv::Mat> frames = loadFrames(options);
+  ortAgent.initialize(frames[0].cols, frames[0].rows, true);
+
+  std::ostringstream line;
+  line << COLD_START_MARKER << " " << ortAgent.precision_level;
+  for (size_t p = 0; p < EPD::NUM_STARTUP_PHASES; ++p) {
+    line << " " << ortAgent.getStartupPhaseMs(static_cast<EPD::StartupPhase>(p));
+  }
+  std::cout << line.str() << std::endl;
+}
+
+/*! \brief A Mutator function that launches options.cold_starts cold start
+child processes one after another and reports the statistics of their launch
+and startup phase times as JSON.*/
+int runColdStarts(const BenchOptions & options)
+{
+  char exePath[4096];
+  const ssize_t exePathSize = readlink("/proc/self/exe", exePath, sizeof(exePath) - 1);
+  if (exePathSize <= 0) {
+    std::cerr << "[ERROR] Unable to locate the epd_bench executable." << std::endl;
+    return 1;
+  }
+  std::string command = shellQuote(std::string(exePath, exePathSize)) + " --cold-start-child";
+  if (options.image_dir.empty()) {
+    command += " --synthetic " + std::to_string(options.synthetic_width) + "x" +
+      std::to_string(options.synthetic_height);
+  } else {
+    command += " --images " + shellQuote(options.image_dir);
+  }
+  if (options.threads > 0) {
+    command += " --threads " + std::to_string(options.threads);
+  }
+
+  unsigned int precisionLevel = 0;
+  std::vector<double> launchLatencies;
+  std::vector<std::vector<double>> phaseLatencies(EPD::NUM_STARTUP_PHASES);
+  for (int i = 0; i < options.cold_starts; ++i) {
+    // The launch time spans loading the executable and its libraries too.
+    const auto start = std::chrono::steady_clock::now();
+    FILE * child = popen(command.c_str(), "r");
+    if (child == nullptr) {
+      std::cerr << "[ERROR] Unable to launch " << command << std::endl;
+      return 1;
+    }
+    std::string childReport;
+    char buffer[512];
+    while (fgets(buffer, sizeof(buffer), child) != nullptr) {
+      if (strncmp(buffer, COLD_START_MARKER, strlen(COLD_START_MARKER)) == 0) {
+        childReport = buffer + strlen(COLD_START_MARKER);
+      }
+    }
+    const int status = pclose(child);
+    launchLatencies.push_back(std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count());
+
+    std::istringstream fields(childReport);
+    std::vector<double> phaseMs(EPD::NUM_STARTUP_PHASES);
+    fields >> precisionLevel;
+    for (auto & ms : phaseMs) {
+      fields >> ms;
+    }
+    if (status == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0 || !fields) {
+      std::cerr << "[ERROR] Cold start " << i << " failed." << std::endl;
+      return 1;
+    }
+    for (size_t p = 0; p < EPD::NUM_STARTUP_PHASES; ++p) {
+      phaseLatencies[p].push_back(phaseMs[p]);
+    }
+  }
+
+  std::ostringstream report;
+  report << "{\n";
+  report << "  \"precision_level\": " << precisionLevel << ",\n";
+  report << "  \"input\": \"" <<
+  (options.image_dir.empty() ? "synthetic" : options.image_dir) << "\",\n";
+  report << "  \"cold_starts\": " << options.cold_starts << ",\n";
+  report << "  \"threads\": " << options.threads << ",\n";
+  // The first launch may be the only one that reads the model from disk
+  // rather than from the page cache.
+  report << "  \"first_launch_ms\": " << launchLatencies[0] << ",\n";
+  report << "  \"launch_ms\": ";
+  writeStats(report, computeStats(launchLatencies));
+  report << ",\n  \"startup_ms\": {";
+  for (size_t p = 0; p < EPD::NUM_STARTUP_PHASES; ++p) {
+    report << (p == 0 ? "\n" : ",\n") << "    \"" <<
+      EPD::getStartupPhaseName(static_cast<EPD::StartupPhase>(p)) << "\": ";
+    writeStats(report, computeStats(phaseLatencies[p]));
+  }
+  report << "\n  }\n";
+  report << "}\n";
+  return writeReport(options, report.str());
+}
+
+/*! \brief A Mutator function that runs one frame through the Ort session
+selected by ortAgent, the same way the processor node does. P1 results are
+written into classification, which is reused across frames.*/
+void runFrame(
+  EPD::EPDContainer & ortAgent, EPD::EPDObjectDetectionPool & detectionPool,
+  EPD::EPDImageClassification & classification,
+  const cv::Mat & img, const Ort::FrameGeometry & geometry)
+{
+  const std::shared_ptr<const EPD::InferenceConfig> config = EPD::getInferenceConfig();
+  switch (ortAgent.precision_level) {
+    case 1:
+      ortAgent.p1_ort_session->infer(img, *config, classification);
+      break;
+    case 2:
+    case 3:
+      if (ortAgent.isVisualize()) {
+        cv::Mat resultImg = (ortAgent.precision_level == 2) ?
+          ortAgent.p2_ort_session->infer_visualize(img, geometry, *config) :
+          ortAgent.p3_ort_session->infer_visualize(img, geometry, *config);
+      } else {
+        EPD::PooledDetection result = detectionPool.acquire();
+        if (ortAgent.precision_level == 2) {
+          ortAgent.p2_ort_session->infer_action(img, geometry, *config, *result);
+        } else {
+          ortAgent.p3_ort_session->infer_action(img, geometry, *config, *result);
+        }
+        if (ortAgent.isCascade()) {
+          ortAgent.classifyDetections(img, *config, *result);
+        }
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+int main(int argc, char * argv[])
+{
+  setlinebuf(stdout);
+
+  BenchOptions options;
+  if (!parseOptions(argc, argv, options)) {
+    printUsage();
+    return 1;
+  }
+
+  // Must happen before the first Ort session creates the shared Env.
+  if (options.threads > 0) {
+    Ort::OrtBase::setNumThreads(options.threads);
+    setenv("OMP_NUM_THREADS", std::to_string(options.threads).c_str(), 1);
+  }
+
+  // No Ort session may exist before launching cold start child processes, so
+  // that they share nothing with this one.
+  if (options.cold_start_child) {
+    try {
+      runColdStartChild(options);
+    } catch (const std::exception & e) {
+      std::cerr << "[ERROR] " << e.what() << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+  if (options.cold_starts > 0) {
+    return runColdStarts(options);
+  }
+
+  std::vector<cv::Mat> frames;
+  EPD::EPDContainer ortAgent;
+  try {
+    frames = loadFrames(options);
+    ortAgent.initialize(frames[0].cols, frames[0].rows, true);
+  } catch (const std::exception & e) {
+    std::cerr << "[ERROR] " << e.what() << std::endl;
+    return 1;
+  }
+
+  std::vector<Ort::FrameGeometry> geometries;
+  for (const auto & frame : frames) {
+    geometries.push_back(EPD::EPDContainer::computeFrameGeometry(frame.cols, frame.rows));
+  }
+
+  EPD::EPDObjectDetectionPool detectionPool;
+  EPD::EPDImageClassification classification;
+  for (int i = 0; i < options.warmup; ++i) {
+    const size_t idx = i % frames.size();
+    runFrame(ortAgent, detectionPool, classification, frames[idx], geometries[idx]);
+  }
+
+  EPD::StageClock stageClock;
+  EPD::addStageObserver(&stageClock);
+
+  std::vector<double> latencies;
+  std::vector<std::vector<double>> stageLatencies(EPD::NUM_STAGES);
+  latencies.reserve(options.iterations);
+  for (auto & samples : stageLatencies) {
+    samples.reserve(options.iterations);
+  }
+
+  // Allocations are only counted if alloc_audit_hook.cpp is linked in.
+  EPD::AllocAudit allocAudit;
+  const bool auditAllocs = EPD::AllocAudit::isHooked();
+  if (auditAllocs) {
+    EPD::addStageObserver(&allocAudit);
+    EPD::AllocAudit::reset();
+    EPD::AllocAudit::setEnabled(true);
+  }
+
+  const auto benchStart = std::chrono::steady_clock::now();
+  for (int i = 0; i < options.iterations; ++i) {
+    const size_t idx = i % frames.size();
+    stageClock.reset();
+
+    const auto start = std::chrono::steady_clock::now();
+    runFrame(ortAgent, detectionPool, classification, frames[idx], geometries[idx]);
+    const auto end = std::chrono::steady_clock::now();
+
+    latencies.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+    for (size_t s = 0; s < EPD::NUM_STAGES; ++s) {
+      stageLatencies[s].push_back(stageClock.getElapsedMs(static_cast<EPD::Stage>(s)));
+    }
+  }
+  const double totalSec = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - benchStart).count();
+
+  EPD::removeStageObserver(&stageClock);
+  if (auditAllocs) {
+    EPD::AllocAudit::setEnabled(false);
+    EPD::removeStageObserver(&allocAudit);
+  }
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  std::ostringstream report;
+  report << "{\n";
+  report << "  \"model\": \"" << ortAgent.onnx_model_path << "\",\n";
+  report << "  \"precision_level\": " << ortAgent.precision_level << ",\n";
+  report << "  \"input\": \"" <<
+  (options.image_dir.empty() ? "synthetic" : options.image_dir) << "\",\n";
+  report << "  \"num_frames\": " << frames.size() << ",\n";
+  report << "  \"iterations\": " << options.iterations << ",\n";
+  report << "  \"warmup\": " << options.warmup << ",\n";
+  report << "  \"threads\": " << options.threads << ",\n";
+  report << "  \"fps\": " << options.iterations / totalSec << ",\n";
+  report << "  \"latency_ms\": ";
+  writeStats(report, computeStats(latencies));
+  report << ",\n  \"stages_ms\": {";
+  bool first = true;
+  for (size_t s = 0; s < EPD::NUM_STAGES; ++s) {
+    const LatencyStats stats = computeStats(stageLatencies[s]);
+    // Skip stages this precision level and use-case never enter.
+    if (stats.max == 0.0) {
+      continue;
+    }
+    report << (first ? "\n" : ",\n") << "    \"" <<
+      EPD::getStageName(static_cast<EPD::Stage>(s)) << "\": ";
+    writeStats(report, stats);
+    first = false;
+  }
+  report << "\n  },\n";
+  report << "  \"startup_ms\": {";
+  for (size_t p = 0; p < EPD::NUM_STARTUP_PHASES; ++p) {
+    const EPD::StartupPhase phase = static_cast<EPD::StartupPhase>(p);
+    report << (p == 0 ? "\n" : ",\n") << "    \"" << EPD::getStartupPhaseName(phase) <<
+      "\": " << ortAgent.getStartupPhaseMs(phase);
+  }
+  report << "\n  },\n";
+  if (auditAllocs) {
+    report << "  \"allocs_per_frame\": {";
+    for (size_t s = 0; s < EPD::NUM_STAGES; ++s) {
+      writeAllocStats(report, EPD::getStageName(static_cast<EPD::Stage>(s)),
+        EPD::AllocAudit::getStats(static_cast<EPD::Stage>(s)), options.iterations);
+      report << ",";
+    }
+    writeAllocStats(report, "total", EPD::AllocAudit::getTotalStats(), options.iterations);
+    report << "\n  },\n";
+  }
+  // ru_maxrss is in kilobytes on Linux.
+  report << "  \"peak_rss_kb\": " << usage.ru_maxrss << "\n";
+  report << "}\n";
+  return writeReport(options, report.str());
+}
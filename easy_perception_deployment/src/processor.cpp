@@ -27,7 +27,10 @@ int main(int argc, char * argv[])
 
   auto processor_node = std::make_shared<Processor>();
 
-  rclcpp::spin(processor_node);
+  // Cameras are processed in parallel, each in its own callback group.
+  rclcpp::executors::MultiThreadedExecutor executor;
+  executor.add_node(processor_node);
+  executor.spin();
   rclcpp::shutdown();
   return 0;
 }
@@ -0,0 +1,242 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <array>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "epd_utils_lib/usecase_config.hpp"
+#include "ort_cpp_lib/p1_ort_base.hpp"
+#include "ort_cpp_lib/p2_ort_base.hpp"
+#include "ort_cpp_lib/p3_ort_base.hpp"
+#include "kernel_workloads.hpp"
+
+/* Resolutions are given as (width, height). The P2/P3 preprocess cases use
+the padded sizes EPDContainer::computeFrameGeometry derives for 640x480 and
+1920x1080 input frames. */
+
+static void ResolutionArgs(benchmark::internal::Benchmark * b)
+{
+  b->Args({224, 224})->Args({640, 480})->Args({1280, 720})->Args({1920, 1080});
+}
+
+static void PaddedResolutionArgs(benchmark::internal::Benchmark * b)
+{
+  b->Args({1088, 800})->Args({1440, 800});
+}
+
+static void DetectionArgs(benchmark::internal::Benchmark * b)
+{
+  b->Arg(10)->Arg(100)->Arg(1000);
+}
+
+static void ResolutionDetectionArgs(benchmark::internal::Benchmark * b)
+{
+  for (int numDetections : {1, 10, 50}) {
+    b->Args({640, 480, numDetections})->Args({1920, 1080, numDetections});
+  }
+}
+
+static void BM_P1Preprocess(benchmark::State & state)
+{
+  const int width = state.range(0), height = state.range(1);
+  cv::Mat img = KernelWorkloads::makeImage(width, height);
+  std::vector<float> dst(3 * width * height);
+
+  static const std::vector<float> IMAGENET_MEAN = {0.406, 0.456, 0.485};
+  static const std::vector<float> IMAGENET_STD = {0.225, 0.224, 0.229};
+
+  for (auto _ : state) {
+    Ort::P1OrtBase::preprocess(dst.data(), img.data, width, height, 3,
+      IMAGENET_MEAN, IMAGENET_STD);
+    benchmark::DoNotOptimize(dst.data());
+  }
+  state.SetItemsProcessed(state.iterations() * width * height);
+}
+BENCHMARK(BM_P1Preprocess)->Apply(ResolutionArgs);
+
+template<typename OrtBaseType>
+static void BM_PreprocessFloatPtr(benchmark::State & state)
+{
+  const int width = state.range(0), height = state.range(1);
+  cv::Mat img = KernelWorkloads::makeFloatImage(width, height);
+  std::vector<float> dst(3 * width * height);
+
+  for (auto _ : state) {
+    OrtBaseType::preprocess(dst.data(), img.ptr<float>(), width, height, 3);
+    benchmark::DoNotOptimize(dst.data());
+  }
+  state.SetItemsProcessed(state.iterations() * width * height);
+}
+BENCHMARK_TEMPLATE(BM_PreprocessFloatPtr, Ort::P2OrtBase)->Apply(PaddedResolutionArgs);
+BENCHMARK_TEMPLATE(BM_PreprocessFloatPtr, Ort::P3OrtBase)->Apply(PaddedResolutionArgs);
+
+template<typename OrtBaseType>
+static void BM_PreprocessMat(benchmark::State & state)
+{
+  const int width = state.range(0), height = state.range(1);
+  cv::Mat img = KernelWorkloads::makeFloatImage(width, height);
+  std::vector<float> dst(3 * width * height);
+
+  for (auto _ : state) {
+    OrtBaseType::preprocess(dst.data(), img, width, height, 3);
+    benchmark::DoNotOptimize(dst.data());
+  }
+  state.SetItemsProcessed(state.iterations() * width * height);
+}
+BENCHMARK_TEMPLATE(BM_PreprocessMat, Ort::P2OrtBase)->Apply(PaddedResolutionArgs);
+BENCHMARK_TEMPLATE(BM_PreprocessMat, Ort::P3OrtBase)->Apply(PaddedResolutionArgs);
+
+static void BM_SoftmaxTopK(benchmark::State & state)
+{
+  const uint16_t numClasses = state.range(0);
+  const uint16_t k = state.range(1);
+  cv::RNG rng(KernelWorkloads::SEED);
+  std::vector<float> logits(numClasses);
+  for (auto & logit : logits) {
+    logit = rng.uniform(-10.0f, 10.0f);
+  }
+  std::vector<float> scratch(numClasses);
+
+  // The result is reused across iterations, as the per-camera results are.
+  EPD::EPDImageClassification result;
+  for (auto _ : state) {
+    // Softmax is applied in place, so every iteration starts from the logits.
+    std::copy(logits.begin(), logits.end(), scratch.begin());
+    Ort::P1OrtBase::processTopK(scratch.data(), numClasses, result, k, true);
+    benchmark::DoNotOptimize(result.classIndices.data());
+  }
+}
+BENCHMARK(BM_SoftmaxTopK)->Args({10, 1})->Args({1000, 1})->Args({1000, 5});
+
+static void BM_P2Decode(benchmark::State & state)
+{
+  auto workload = KernelWorkloads::makeDetections(state.range(0), 1920, 1080, 80, false);
+  auto outputs = workload.getOutputs();
+
+  // The result is reused across iterations, as the pooled results are.
+  EPD::EPDObjectDetection result;
+  for (auto _ : state) {
+    Ort::P2OrtBase::decode(outputs, 1.0, workload.imgWidth, workload.imgHeight, 0.5, result);
+    benchmark::DoNotOptimize(result.bboxes.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_P2Decode)->Apply(DetectionArgs);
+
+static void BM_P3Decode(benchmark::State & state)
+{
+  auto workload = KernelWorkloads::makeDetections(state.range(0), 1920, 1080, 80, true);
+  auto outputs = workload.getOutputs();
+
+  EPD::EPDObjectDetection result;
+  for (auto _ : state) {
+    Ort::P3OrtBase::decode(outputs, 1.0, workload.imgWidth, workload.imgHeight, 0.5, result);
+    benchmark::DoNotOptimize(result.maskData.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_P3Decode)->Apply(DetectionArgs);
+
+static void BM_Count(benchmark::State & state)
+{
+  const int numClasses = 80;
+  auto workload = KernelWorkloads::makeDetections(state.range(0), 1920, 1080, numClasses, true);
+  auto outputs = workload.getOutputs();
+  const std::vector<std::string> classNames = KernelWorkloads::makeClassNames(numClasses);
+  const std::vector<std::string> countClassNames = {"class_0", "class_1", "class_2"};
+
+  EPD::EPDObjectDetection decoded, result;
+  Ort::P3OrtBase::decode(outputs, 1.0, workload.imgWidth, workload.imgHeight, 0.0, decoded);
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    result = decoded;
+    state.ResumeTiming();
+
+    EPD::count(result, classNames, countClassNames);
+    benchmark::DoNotOptimize(result.bboxes.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Count)->Apply(DetectionArgs);
+
+static void BM_MatchColor(benchmark::State & state)
+{
+  const int width = state.range(0), height = state.range(1);
+  const int numClasses = 80;
+  cv::Mat img = KernelWorkloads::makeImage(width, height);
+  cv::Mat refColorImage = KernelWorkloads::makeImage(64, 64);
+  auto workload = KernelWorkloads::makeDetections(state.range(2), width, height, numClasses, false);
+  auto outputs = workload.getOutputs();
+  const std::vector<std::string> classNames = KernelWorkloads::makeClassNames(numClasses);
+
+  EPD::EPDObjectDetection decoded, result;
+  Ort::P2OrtBase::decode(outputs, 1.0, width, height, 0.0, decoded);
+  const EPD::InferenceConfig config;
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    result = decoded;
+    state.ResumeTiming();
+
+    EPD::matchColor(img, result, refColorImage, config);
+    benchmark::DoNotOptimize(result.bboxes.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(2));
+}
+BENCHMARK(BM_MatchColor)->Apply(ResolutionDetectionArgs);
+
+static void BM_P2Visualize(benchmark::State & state)
+{
+  const int width = state.range(0), height = state.range(1);
+  const int numClasses = 80;
+  cv::Mat img = KernelWorkloads::makeImage(width, height);
+  auto workload = KernelWorkloads::makeDetections(state.range(2), width, height, numClasses, false);
+  auto outputs = workload.getOutputs();
+  const std::vector<std::string> classNames = KernelWorkloads::makeClassNames(numClasses);
+
+  EPD::EPDObjectDetection detection;
+  Ort::P2OrtBase::decode(outputs, 1.0, width, height, 0.0, detection);
+
+  for (auto _ : state) {
+    cv::Mat result = Ort::P2OrtBase::visualize(img, detection, classNames);
+    benchmark::DoNotOptimize(result.data);
+  }
+}
+BENCHMARK(BM_P2Visualize)->Apply(ResolutionDetectionArgs);
+
+static void BM_P3Visualize(benchmark::State & state)
+{
+  const int width = state.range(0), height = state.range(1);
+  const int numClasses = 80;
+  cv::Mat img = KernelWorkloads::makeImage(width, height);
+  auto workload = KernelWorkloads::makeDetections(state.range(2), width, height, numClasses, true);
+  auto outputs = workload.getOutputs();
+  const std::vector<std::string> classNames = KernelWorkloads::makeClassNames(numClasses);
+
+  EPD::EPDObjectDetection detection;
+  Ort::P3OrtBase::decode(outputs, 1.0, width, height, 0.0, detection);
+
+  for (auto _ : state) {
+    cv::Mat result = Ort::P3OrtBase::visualize(img, detection, classNames, 0.5);
+    benchmark::DoNotOptimize(result.data);
+  }
+}
+BENCHMARK(BM_P3Visualize)->Apply(ResolutionDetectionArgs);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,263 @@
+# Copyright 2020 ROS-Industrial Consortium Asia Pacific
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+'''
+Generates tiny ONNX models and images that the tests and benchmarks use
+instead of the ONNX Model Zoo models and the Flickr test image, so that they
+run offline and deterministically.
+
+The models follow the same input and output contracts as the models EPD
+deploys, and tell colors apart instead of objects:
+    p1_fixture.onnx  data [N, 3, 224, 224] -> prob [N, 4]
+    p2_fixture.onnx  image [3, H, W] -> boxes [3, 4], labels [3], scores [3]
+    p3_fixture.onnx  image [3, H, W] -> boxes, labels, scores,
+                     masks [3, 1, 28, 28]
+Class k of fixture_classes.txt is the k-th channel of a BGR image, with
+class 0 as background. P1 picks the brightest channel. P2 and P3 always
+return one fixed box per channel, scored by how bright that channel is.
+
+Only the Python standard library is used, so the ONNX protobuf messages are
+encoded by hand.
+
+Usage: python3 generate_fixtures.py [OUTPUT_DIR]
+'''
+
+import os
+import struct
+import sys
+import zlib
+
+IR_VERSION = 6
+OPSET_VERSION = 11
+
+FLOAT = 1
+INT64 = 7
+
+ATTR_INT = 2
+ATTR_INTS = 7
+
+CLASS_NAMES = ['background', 'blue', 'green', 'red']
+MASK_SIZE = 28
+
+# The boxes P2 and P3 return, in padded input image coordinates.
+FIXTURE_BOXES = [
+    [40.0, 40.0, 200.0, 200.0],
+    [240.0, 40.0, 400.0, 200.0],
+    [440.0, 40.0, 600.0, 200.0],
+]
+# Scales the mean of each channel, after the P2 and P3 mean subtraction,
+# into the logit of its score.
+SCORE_SCALE = 0.1
+
+
+def varint(value):
+    '''
+    Encodes a non-negative integer as a protobuf varint.
+    '''
+    out = bytearray()
+    while True:
+        byte = value & 0x7f
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def field_varint(number, value):
+    return varint(number << 3) + varint(value)
+
+
+def field_bytes(number, value):
+    if isinstance(value, str):
+        value = value.encode('utf-8')
+    return varint((number << 3) | 2) + varint(len(value)) + value
+
+
+def field_float(number, value):
+    return varint((number << 3) | 5) + struct.pack('<f', value)
+
+
+def tensor(name, data_type, dims, values):
+    '''
+    Encodes a TensorProto holding values in raw_data.
+    '''
+    fmt = '<%d%s' % (len(values), 'f' if data_type == FLOAT else 'q')
+    out = b''.join(field_varint(1, dim) for dim in dims)
+    out += field_varint(2, data_type)
+    out += field_bytes(8, name)
+    out += field_bytes(9, struct.pack(fmt, *values))
+    return out
+
+
+def value_info(name, elem_type, dims):
+    '''
+    Encodes a ValueInfoProto of a tensor. A str dim is a named dynamic one.
+    '''
+    shape = b''
+    for dim in dims:
+        if isinstance(dim, str):
+            shape += field_bytes(1, field_bytes(2, dim))
+        else:
+            shape += field_bytes(1, field_varint(1, dim))
+    tensor_type = field_varint(1, elem_type) + field_bytes(2, shape)
+    return field_bytes(1, name) + field_bytes(2, field_bytes(1, tensor_type))
+
+
+def attribute_int(name, value):
+    return field_bytes(1, name) + field_varint(20, ATTR_INT) + field_varint(3, value)
+
+
+def attribute_ints(name, values):
+    out = field_bytes(1, name) + field_varint(20, ATTR_INTS)
+    return out + b''.join(field_varint(8, value) for value in values)
+
+
+def node(op_type, inputs, outputs, attributes=()):
+    out = b''.join(field_bytes(1, name) for name in inputs)
+    out += b''.join(field_bytes(2, name) for name in outputs)
+    out += field_bytes(3, outputs[0] + '_' + op_type)
+    out += field_bytes(4, op_type)
+    return out + b''.join(field_bytes(5, attribute) for attribute in attributes)
+
+
+def model(name, nodes, initializers, inputs, outputs):
+    '''
+    Encodes a ModelProto around a single graph.
+    '''
+    graph = b''.join(field_bytes(1, n) for n in nodes)
+    graph += field_bytes(2, name)
+    graph += b''.join(field_bytes(5, t) for t in initializers)
+    graph += b''.join(field_bytes(11, v) for v in inputs)
+    graph += b''.join(field_bytes(12, v) for v in outputs)
+
+    opset = field_bytes(1, '') + field_varint(2, OPSET_VERSION)
+    out = field_varint(1, IR_VERSION)
+    out += field_bytes(2, 'easy_perception_deployment')
+    out += field_bytes(3, '0.0.1')
+    out += field_bytes(7, graph)
+    return out + field_bytes(8, opset)
+
+
+def p1_model():
+    # prob = mean of each channel, mapped onto the non-background classes.
+    weights = []
+    for channel in range(3):
+        weights += [1.0 if k == channel + 1 else 0.0 for k in range(len(CLASS_NAMES))]
+    return model(
+        'p1_fixture',
+        [
+            node('GlobalAveragePool', ['data'], ['pooled']),
+            node('Flatten', ['pooled'], ['means'], [attribute_int('axis', 1)]),
+            node('MatMul', ['means', 'weights'], ['prob']),
+        ],
+        [tensor('weights', FLOAT, [3, len(CLASS_NAMES)], weights)],
+        [value_info('data', FLOAT, ['batch', 3, 224, 224])],
+        [value_info('prob', FLOAT, ['batch', len(CLASS_NAMES)])])
+
+
+def detection_model(name, with_masks):
+    num_boxes = len(FIXTURE_BOXES)
+    nodes = [
+        node('ReduceMean', ['image'], ['means'],
+             [attribute_ints('axes', [1, 2]), attribute_int('keepdims', 0)]),
+        node('Mul', ['means', 'score_scale'], ['logits']),
+        node('Sigmoid', ['logits'], ['scores']),
+        node('Identity', ['fixture_boxes'], ['boxes']),
+        node('Identity', ['fixture_labels'], ['labels']),
+    ]
+    initializers = [
+        tensor('score_scale', FLOAT, [1], [SCORE_SCALE]),
+        tensor('fixture_boxes', FLOAT, [num_boxes, 4], sum(FIXTURE_BOXES, [])),
+        tensor('fixture_labels', INT64, [num_boxes], list(range(1, num_boxes + 1))),
+    ]
+    outputs = [
+        value_info('boxes', FLOAT, [num_boxes, 4]),
+        value_info('labels', INT64, [num_boxes]),
+        value_info('scores', FLOAT, [num_boxes]),
+    ]
+    if with_masks:
+        # A filled disk in the middle of every mask.
+        center = (MASK_SIZE - 1) / 2.0
+        radius = MASK_SIZE / 3.0
+        mask = [1.0 if (i - center) ** 2 + (j - center) ** 2 <= radius ** 2 else 0.0
+                for i in range(MASK_SIZE) for j in range(MASK_SIZE)]
+        nodes.append(node('Identity', ['fixture_masks'], ['masks']))
+        initializers.append(
+            tensor('fixture_masks', FLOAT, [num_boxes, 1, MASK_SIZE, MASK_SIZE],
+                   mask * num_boxes))
+        outputs.append(value_info('masks', FLOAT, [num_boxes, 1, MASK_SIZE, MASK_SIZE]))
+    return model(
+        name, nodes, initializers,
+        [value_info('image', FLOAT, [3, 'height', 'width'])],
+        outputs)
+
+
+def png(width, height, pixel_at):
+    '''
+    Encodes an 8-bit RGB PNG image. pixel_at(x, y) returns an (r, g, b) tuple.
+    '''
+    rows = bytearray()
+    for y in range(height):
+        rows.append(0)
+        for x in range(width):
+            rows.extend(pixel_at(x, y))
+
+    def chunk(tag, data):
+        body = tag + data
+        return struct.pack('>I', len(data)) + body + struct.pack('>I', zlib.crc32(body))
+
+    header = struct.pack('>IIBBBBB', width, height, 8, 2, 0, 0, 0)
+    return (b'\x89PNG\r\n\x1a\n' + chunk(b'IHDR', header) +
+            chunk(b'IDAT', zlib.compress(bytes(rows), 9)) + chunk(b'IEND', b''))
+
+
+def scene_pixel(x, y):
+    # Three colored patches on a gray background.
+    if 80 <= y < 400:
+        if 80 <= x < 400:
+            return (0, 0, 255)
+        if 480 <= x < 800:
+            return (0, 255, 0)
+        if 880 <= x < 1200:
+            return (255, 0, 0)
+    return (128, 128, 128)
+
+
+def write(path, data):
+    with open(path, 'wb') as outfile:
+        outfile.write(data)
+
+
+def main():
+    output_dir = sys.argv[1] if len(sys.argv) > 1 else os.path.join(
+        os.path.dirname(os.path.abspath(__file__)), '..', '..', 'data', 'fixtures')
+    if not os.path.isdir(output_dir):
+        os.makedirs(output_dir)
+
+    write(os.path.join(output_dir, 'p1_fixture.onnx'), p1_model())
+    write(os.path.join(output_dir, 'p2_fixture.onnx'), detection_model('p2_fixture', False))
+    write(os.path.join(output_dir, 'p3_fixture.onnx'), detection_model('p3_fixture', True))
+    write(os.path.join(output_dir, 'fixture_classes.txt'),
+          ''.join(name + '\n' for name in CLASS_NAMES).encode('utf-8'))
+
+    for color, rgb in (('red', (255, 0, 0)), ('green', (0, 255, 0)), ('blue', (0, 0, 255))):
+        write(os.path.join(output_dir, 'fixture_%s.png' % color),
+              png(640, 480, lambda x, y, rgb=rgb: rgb))
+    write(os.path.join(output_dir, 'fixture_scene.png'), png(1280, 720, scene_pixel))
+
+
+if __name__ == '__main__':
+    main()
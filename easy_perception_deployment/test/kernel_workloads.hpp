@@ -0,0 +1,128 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KERNEL_WORKLOADS_HPP_
+#define KERNEL_WORKLOADS_HPP_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+#include "ort_cpp_lib/ort_base.hpp"
+
+/*! \brief Fixed-seed synthetic inputs for the preprocessing and post-processing
+kernels, so that they can be measured without model files or images.
+ */
+namespace KernelWorkloads
+{
+/*! \brief The fixed seed every workload is generated from.*/
+const uint64_t SEED = 12345;
+/*! \brief The side length of a P3 mask, as output by MaskRCNN.*/
+const int MASK_SIZE = 28;
+
+/*! \brief A Getter function that gets a noise BGR image of the given size.*/
+inline cv::Mat makeImage(int width, int height)
+{
+  cv::RNG rng(SEED);
+  cv::Mat img(height, width, CV_8UC3);
+  rng.fill(img, cv::RNG::UNIFORM, 0, 256);
+  return img;
+}
+
+/*! \brief A Getter function that gets a noise float BGR image of the given
+size, as P2 and P3 preprocess it after mean subtraction and padding.*/
+inline cv::Mat makeFloatImage(int width, int height)
+{
+  cv::Mat img;
+  makeImage(width, height).convertTo(img, CV_32FC3);
+  return img;
+}
+
+/*! \brief A Getter function that gets the label list class_0 .. class_n-1.*/
+inline std::vector<std::string> makeClassNames(int numClasses)
+{
+  std::vector<std::string> classNames;
+  for (int i = 0; i < numClasses; ++i) {
+    classNames.emplace_back("class_" + std::to_string(i));
+  }
+  return classNames;
+}
+
+/*! \struct DetectionWorkload
+    \brief The raw outputs of a P2 or P3 Ort Session for a frame of
+    imgWidth x imgHeight, holding numDetections detections of which every other
+    one scores above 0.5.
+*/
+struct DetectionWorkload
+{
+  int imgWidth, imgHeight;
+  std::vector<float> boxes;
+  std::vector<int64_t> labels;
+  std::vector<float> scores;
+  std::vector<float> masks;
+
+  /*! \brief A Getter function that gets the outputs in the layout returned
+  by OrtBase, namely boxes, labels, scores and, for P3, masks.*/
+  std::vector<Ort::OrtBase::DataOutputType> getOutputs()
+  {
+    const int64_t numDetections = labels.size();
+    std::vector<Ort::OrtBase::DataOutputType> outputs = {
+      {boxes.data(), {numDetections, 4}},
+      {reinterpret_cast<float *>(labels.data()), {numDetections}},
+      {scores.data(), {numDetections}}
+    };
+    if (!masks.empty()) {
+      outputs.push_back({masks.data(), {numDetections, 1, MASK_SIZE, MASK_SIZE}});
+    }
+    return outputs;
+  }
+};
+
+/*! \brief A Getter function that gets a DetectionWorkload with boxes of at
+least 16 x 16 pixels inside the frame. The boxes are in the frame's
+coordinates, so they are decoded with a ratio of 1.*/
+inline DetectionWorkload makeDetections(
+  int numDetections,
+  int imgWidth,
+  int imgHeight,
+  int numClasses,
+  bool withMasks)
+{
+  cv::RNG rng(SEED);
+  DetectionWorkload workload;
+  workload.imgWidth = imgWidth;
+  workload.imgHeight = imgHeight;
+
+  for (int i = 0; i < numDetections; ++i) {
+    const float xmin = rng.uniform(0.0f, imgWidth - 16.0f);
+    const float ymin = rng.uniform(0.0f, imgHeight - 16.0f);
+    const float xmax = rng.uniform(xmin + 16.0f, static_cast<float>(imgWidth));
+    const float ymax = rng.uniform(ymin + 16.0f, static_cast<float>(imgHeight));
+    workload.boxes.insert(workload.boxes.end(), {xmin, ymin, xmax, ymax});
+    workload.labels.push_back(rng.uniform(0, numClasses));
+    workload.scores.push_back((i % 2 == 0) ? rng.uniform(0.5f, 1.0f) : rng.uniform(0.0f, 0.5f));
+  }
+
+  if (withMasks) {
+    workload.masks.resize(numDetections * MASK_SIZE * MASK_SIZE);
+    cv::Mat maskData(1, workload.masks.size(), CV_32FC1, workload.masks.data());
+    rng.fill(maskData, cv::RNG::UNIFORM, 0.0f, 1.0f);
+  }
+  return workload;
+}
+}  // namespace KernelWorkloads
+
+#endif  // KERNEL_WORKLOADS_HPP_
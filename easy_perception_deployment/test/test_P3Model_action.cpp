@@ -70,7 +70,7 @@ TEST(EPD_TestSuite, Test_loadP3ONNXModel_EPDContainer)
   ASSERT_NE(result.bboxes.size(), unsigned(0));
   ASSERT_NE(result.classIndices.size(), unsigned(0));
   ASSERT_NE(result.scores.size(), unsigned(0));
-  ASSERT_NE(result.masks.size(), unsigned(0));
+  ASSERT_NE(result.maskData.size(), unsigned(0));
 
   system("rm ./data/9544757988_991457c228_z.jpg");
   delete ortAgent_;
@@ -0,0 +1,197 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "epd_utils_lib/alloc_audit.hpp"
+#include "epd_utils_lib/epd_container.hpp"
+#include "gtest/gtest.h"
+// OpenCV LIB
+#include "opencv2/opencv.hpp"
+
+/*! \brief The number of frames run before allocations are counted, which
+lets every reusable buffer and the Ort arena reach its final size.*/
+const int WARMUP_FRAMES = 3;
+/*! \brief The number of frames whose allocations are counted.*/
+const int MEASURED_FRAMES = 10;
+/*! \brief The most heap allocations a warm frame may make in every stage but
+the Ort Session run, and outside of any stage. A few small ones are allowed
+for the task objects of the OpenCV thread pool.*/
+const uint64_t MAX_ALLOCS_PER_STAGE = 4;
+/*! \brief The most bytes a warm frame may allocate in every stage but the Ort
+Session run, and outside of any stage. Any per-frame image, tensor or mask
+buffer is larger.*/
+const uint64_t MAX_BYTES_PER_STAGE = 4096;
+
+/*! \brief A Getter function that gets the name of an allocation scope.*/
+std::string getScopeName(size_t scope)
+{
+  return scope == EPD::NUM_STAGES ?
+         "outside stages" : EPD::getStageName(static_cast<EPD::Stage>(scope));
+}
+
+/*! \brief A Mutator function that writes the config files of a container
+that runs a fixture model.*/
+void writeSessionConfig(const std::string & modelPath)
+{
+  std::ofstream sessionConfig("./data/session_config.txt");
+  sessionConfig << modelPath << "\n" <<
+    "./data/fixtures/fixture_classes.txt\n" <<
+    "robot\n";
+  std::ofstream usecaseConfig("./data/usecase_config.txt");
+  usecaseConfig << "0\n";
+}
+
+/*! \brief A Mutator function that runs warm frames with runFrame and checks
+that, apart from the Ort Session run, they allocate no more than a few small
+blocks per stage. The Ort Session run depends on the kernels of the model, so
+it is only checked not to allocate more as frames go on.*/
+template<typename RunFrame>
+void auditSteadyState(RunFrame runFrame)
+{
+  ASSERT_TRUE(EPD::AllocAudit::isHooked());
+
+  for (int i = 0; i < WARMUP_FRAMES; ++i) {
+    runFrame();
+  }
+
+  EPD::AllocAudit allocAudit;
+  ASSERT_TRUE(EPD::addStageObserver(&allocAudit));
+
+  const size_t inference = static_cast<size_t>(EPD::Stage::INFERENCE);
+  std::vector<uint64_t> inferenceAllocs;
+  inferenceAllocs.reserve(MEASURED_FRAMES);
+  for (int i = 0; i < MEASURED_FRAMES; ++i) {
+    EPD::AllocAudit::reset();
+    EPD::AllocAudit::setEnabled(true);
+    runFrame();
+    EPD::AllocAudit::setEnabled(false);
+
+    for (size_t scope = 0; scope < EPD::NUM_ALLOC_SCOPES; ++scope) {
+      if (scope == inference) {
+        continue;
+      }
+      const EPD::AllocStats stats = EPD::AllocAudit::getStats(static_cast<EPD::Stage>(scope));
+      EXPECT_LE(stats.count, MAX_ALLOCS_PER_STAGE) << getScopeName(scope) << ", frame " << i;
+      EXPECT_LE(stats.bytes, MAX_BYTES_PER_STAGE) << getScopeName(scope) << ", frame " << i;
+    }
+    inferenceAllocs.push_back(EPD::AllocAudit::getStats(EPD::Stage::INFERENCE).count);
+  }
+  EPD::removeStageObserver(&allocAudit);
+
+  for (size_t scope = 0; scope < EPD::NUM_ALLOC_SCOPES; ++scope) {
+    const EPD::AllocStats stats = EPD::AllocAudit::getStats(static_cast<EPD::Stage>(scope));
+    if (stats.count > 0) {
+      std::cout << "[ALLOC] " << getScopeName(scope) << ": " <<
+        stats.count << " allocations, " << stats.bytes << " bytes" << std::endl;
+    }
+  }
+
+  // A warm frame must not allocate more than the first measured one.
+  EXPECT_LE(inferenceAllocs.back(), inferenceAllocs.front());
+}
+
+/*! \brief A Getter function that gets a fixed-seed random frame, whose
+channel means let the P2 and P3 fixtures detect all of their boxes.*/
+cv::Mat makeFrame()
+{
+  cv::Mat frame(720, 1280, CV_8UC3);
+  cv::RNG rng(42);
+  rng.fill(frame, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(255));
+  return frame;
+}
+
+TEST(EPD_TestSuite, Test_attributeToStage_AllocAudit)
+{
+  ASSERT_TRUE(EPD::AllocAudit::isHooked());
+
+  EPD::AllocAudit allocAudit;
+  ASSERT_TRUE(EPD::addStageObserver(&allocAudit));
+  EPD::AllocAudit::reset();
+  EPD::AllocAudit::setEnabled(true);
+  {
+    EPD::ScopedStage decode(EPD::Stage::DECODE);
+    std::vector<int> outer(100);
+    {
+      EPD::ScopedStage usecase(EPD::Stage::USECASE);
+      std::vector<int> inner(10);
+    }
+  }
+  std::vector<char> outside(7);
+  EPD::AllocAudit::setEnabled(false);
+  EPD::removeStageObserver(&allocAudit);
+
+  EXPECT_EQ(EPD::AllocAudit::getStats(EPD::Stage::DECODE).count, 1u);
+  EXPECT_EQ(EPD::AllocAudit::getStats(EPD::Stage::DECODE).bytes, 100u * sizeof(int));
+  EXPECT_EQ(EPD::AllocAudit::getStats(EPD::Stage::USECASE).count, 1u);
+  EXPECT_EQ(EPD::AllocAudit::getStats(EPD::Stage::USECASE).bytes, 10u * sizeof(int));
+  EXPECT_EQ(EPD::AllocAudit::getTotalStats().count, 3u);
+  EXPECT_EQ(EPD::AllocAudit::getTotalStats().bytes, 100u * sizeof(int) + 10u * sizeof(int) + 7u);
+}
+
+TEST(EPD_TestSuite, Test_steadyStateAllocations_P1OrtBase)
+{
+  writeSessionConfig("./data/fixtures/p1_fixture.onnx");
+  EPD::EPDContainer ortAgent;
+  ASSERT_EQ(ortAgent.precision_level, unsigned(1));
+
+  const cv::Mat frame = makeFrame();
+  ASSERT_TRUE(ortAgent.initialize(frame.cols, frame.rows));
+
+  EPD::EPDImageClassification result;
+  auditSteadyState([&]() {ortAgent.p1_ort_session->infer(frame, result);});
+  EXPECT_EQ(result.size(), unsigned(1));
+}
+
+TEST(EPD_TestSuite, Test_steadyStateAllocations_P2OrtBase)
+{
+  writeSessionConfig("./data/fixtures/p2_fixture.onnx");
+  EPD::EPDContainer ortAgent;
+  ASSERT_EQ(ortAgent.precision_level, unsigned(2));
+
+  const cv::Mat frame = makeFrame();
+  ASSERT_TRUE(ortAgent.initialize(frame.cols, frame.rows));
+  const Ort::FrameGeometry geometry =
+    EPD::EPDContainer::computeFrameGeometry(frame.cols, frame.rows);
+
+  EPD::EPDObjectDetection result;
+  auditSteadyState([&]() {ortAgent.p2_ort_session->infer_action(frame, geometry, result);});
+  EXPECT_EQ(result.size(), unsigned(3));
+}
+
+TEST(EPD_TestSuite, Test_steadyStateAllocations_P3OrtBase)
+{
+  writeSessionConfig("./data/fixtures/p3_fixture.onnx");
+  EPD::EPDContainer ortAgent;
+  ASSERT_EQ(ortAgent.precision_level, unsigned(3));
+
+  const cv::Mat frame = makeFrame();
+  ASSERT_TRUE(ortAgent.initialize(frame.cols, frame.rows));
+  const Ort::FrameGeometry geometry =
+    EPD::EPDContainer::computeFrameGeometry(frame.cols, frame.rows);
+
+  EPD::EPDObjectDetection result;
+  auditSteadyState([&]() {ortAgent.p3_ort_session->infer_action(frame, geometry, result);});
+  EXPECT_EQ(result.size(), unsigned(3));
+  EXPECT_TRUE(result.hasMasks());
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,94 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <iostream>
+#include <fstream>
+
+#include "bits/stdc++.h"
+#include "epd_utils_lib/epd_container.hpp"
+#include "gtest/gtest.h"
+
+bool is_file_exist(const char * fileName)
+{
+  std::ifstream infile(fileName);
+  return infile.good();
+}
+
+TEST(EPD_TestSuite, Test_loadCascadeONNXModel_EPDContainer)
+{
+  if (!is_file_exist("./data/session_config.txt")) {
+    system("touch ./data/session_config.txt");
+    system("echo ./data/model/FasterRCNN-10.onnx >> ./data/session_config.txt");
+    system("echo ./data/label_list/coco_classes.txt >> ./data/session_config.txt");
+    system("echo robot >> ./data/session_config.txt");
+  } else {
+    system("rm ./data/session_config.txt");
+    system("touch ./data/session_config.txt");
+    system("echo ./data/model/FasterRCNN-10.onnx >> ./data/session_config.txt");
+    system("echo ./data/label_list/coco_classes.txt >> ./data/session_config.txt");
+    system("echo robot >> ./data/session_config.txt");
+  }
+
+  if (!is_file_exist("./data/usecase_config.txt")) {
+    system("touch ./data/usecase_config.txt");
+    system("echo 0 >> ./data/usecase_config.txt");
+  } else {
+    system("rm ./data/usecase_config.txt");
+    system("touch ./data/usecase_config.txt");
+    system("echo 0 >> ./data/usecase_config.txt");
+  }
+
+  system("rm -f ./data/cascade_config.txt");
+  system("echo ./data/model/squeezenet1.1-7.onnx >> ./data/cascade_config.txt");
+  system("echo ./data/label_list/imagenet_classes.txt >> ./data/cascade_config.txt");
+
+  if (!is_file_exist("./data/9544757988_991457c228_z.jpg")) {
+    system("apt-get install -y wget");
+    system("wget https://farm8.staticflickr.com/7329/9544757988_991457c228_z.jpg"
+      " --directory-prefix ./data/");
+  }
+
+  EPD::EPDContainer * ortAgent_;
+
+  ortAgent_ = new EPD::EPDContainer();
+
+  EXPECT_EQ(ortAgent_->precision_level, unsigned(2));
+  EXPECT_EQ(ortAgent_->isCascade(), true);
+  EXPECT_EQ(ortAgent_->cascadeClassNames.size(), unsigned(1000));
+
+  cv::Mat frame = cv::imread("./data/9544757988_991457c228_z.jpg", CV_LOAD_IMAGE_COLOR);
+
+  ortAgent_->setFrameDimension(frame.cols, frame.rows);
+  ortAgent_->initORTSessionHandler();
+
+  ASSERT_EQ(!ortAgent_->cascade_ort_session, false);
+
+  EPD::EPDObjectDetection result = ortAgent_->p2_ort_session->infer_action(frame);
+  ASSERT_NE(result.bboxes.size(), unsigned(0));
+
+  ortAgent_->classifyDetections(frame, *EPD::getInferenceConfig(), result);
+  ASSERT_EQ(result.cascadeNames.size(), result.bboxes.size());
+  ASSERT_NE(result.cascadeNames[0], "");
+
+  system("rm ./data/cascade_config.txt");
+
+  delete ortAgent_;
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
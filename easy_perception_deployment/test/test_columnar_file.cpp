@@ -0,0 +1,83 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "epd_utils_lib/columnar_file.hpp"
+
+const char TEST_COLUMNAR_PATH[] = "./epd_test_columns.bin";
+
+TEST(EPD_TestSuite, Test_roundTrip_ColumnarFile)
+{
+  const std::vector<uint32_t> frames = {0, 0, 2};
+  const std::vector<int64_t> classIndices = {3, 1, 40};
+  const std::vector<float> scores = {0.9f, 0.55f, 0.7f};
+  const std::vector<double> latencies = {12.5, 13.25, 11.0};
+  const std::vector<std::string> labels = {"robot", "", "screwdriver"};
+  {
+    EPD::ColumnarWriter writer;
+    writer.addColumn("result.frame", frames);
+    writer.addColumn("result.class_index", classIndices);
+    writer.addColumn("result.score", scores);
+    writer.addColumn("result.label", labels);
+    writer.addColumn("frame.latency_ms", latencies);
+    writer.addColumn("frame.empty", std::vector<int32_t>());
+    writer.write(TEST_COLUMNAR_PATH);
+  }
+
+  EPD::ColumnarReader reader(TEST_COLUMNAR_PATH);
+  EXPECT_EQ(reader.getColumnNames(), std::vector<std::string>({
+    "result.frame", "result.class_index", "result.score", "result.label",
+    "frame.latency_ms", "frame.empty"}));
+  EXPECT_EQ(reader.getColumn<uint32_t>("result.frame"), frames);
+  EXPECT_EQ(reader.getColumn<int64_t>("result.class_index"), classIndices);
+  EXPECT_EQ(reader.getColumn<float>("result.score"), scores);
+  EXPECT_EQ(reader.getStringColumn("result.label"), labels);
+  EXPECT_EQ(reader.getColumn<double>("frame.latency_ms"), latencies);
+  EXPECT_TRUE(reader.getColumn<int32_t>("frame.empty").empty());
+
+  EXPECT_THROW(reader.getColumn<double>("result.score"), std::runtime_error);
+  EXPECT_THROW(reader.getColumn<float>("result.missing"), std::out_of_range);
+
+  std::remove(TEST_COLUMNAR_PATH);
+}
+
+TEST(EPD_TestSuite, Test_invalid_ColumnarFile)
+{
+  EPD::ColumnarWriter writer;
+  EXPECT_THROW(writer.addColumn("", std::vector<float>()), std::runtime_error);
+  EXPECT_THROW(
+    writer.addColumn(std::string(EPD::COLUMN_NAME_SIZE, 'x'), std::vector<float>()),
+    std::runtime_error);
+
+  {
+    std::ofstream file(TEST_COLUMNAR_PATH);
+    file << "not a columnar file";
+  }
+  EXPECT_THROW(EPD::ColumnarReader reader(TEST_COLUMNAR_PATH), std::runtime_error);
+  std::remove(TEST_COLUMNAR_PATH);
+
+  EXPECT_THROW(EPD::ColumnarReader reader(TEST_COLUMNAR_PATH), std::runtime_error);
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,146 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <array>
+#include <chrono>
+#include <thread>
+#include "gtest/gtest.h"
+#include "epd_utils_lib/deadline_scheduler.hpp"
+
+/*! \brief A Getter function that gets the stage times of a frame that spent
+inferenceMs in inference and 1 ms in every other stage.*/
+std::array<double, EPD::NUM_STAGES> makeFrame(double inferenceMs)
+{
+  std::array<double, EPD::NUM_STAGES> elapsedMs;
+  elapsedMs.fill(1.0);
+  elapsedMs[static_cast<size_t>(EPD::Stage::INFERENCE)] = inferenceMs;
+  return elapsedMs;
+}
+
+TEST(EPD_TestSuite, Test_decide_DeadlineScheduler)
+{
+  EPD::DeadlineScheduler scheduler(0.5);
+
+  // Without any estimate, only expired frames are skipped.
+  EXPECT_EQ(scheduler.decide(90.0, 100.0), EPD::FrameDecision::PROCESS);
+  EXPECT_EQ(scheduler.decide(110.0, 100.0), EPD::FrameDecision::SKIP_EXPIRED);
+
+  // Stages before the decision are not part of the prediction.
+  scheduler.addFrame(makeFrame(40.0));
+  EXPECT_DOUBLE_EQ(scheduler.getStageLatencyMs(EPD::Stage::INFERENCE), 40.0);
+  EXPECT_DOUBLE_EQ(scheduler.getStageLatencyMs(EPD::Stage::RECEIVE), 0.0);
+  EXPECT_DOUBLE_EQ(scheduler.getPredictedLatencyMs(), 46.0);
+
+  EXPECT_EQ(scheduler.decide(50.0, 100.0), EPD::FrameDecision::PROCESS);
+  EXPECT_EQ(scheduler.decide(60.0, 100.0), EPD::FrameDecision::SKIP_PREDICTED_MISS);
+
+  // The estimate follows the latency of later frames.
+  scheduler.addFrame(makeFrame(20.0));
+  EXPECT_DOUBLE_EQ(scheduler.getStageLatencyMs(EPD::Stage::INFERENCE), 30.0);
+  EXPECT_EQ(scheduler.decide(60.0, 100.0), EPD::FrameDecision::PROCESS);
+}
+
+TEST(EPD_TestSuite, Test_observe_DeadlineScheduler)
+{
+  EPD::DeadlineScheduler scheduler;
+  ASSERT_TRUE(EPD::addStageObserver(&scheduler));
+
+  // A skipped frame ends without any scheduled stage.
+  {
+    EPD::ScopedFrame frame(&scheduler);
+    EPD::ScopedStage receive(EPD::Stage::RECEIVE);
+  }
+  EXPECT_DOUBLE_EQ(scheduler.getPredictedLatencyMs(), 0.0);
+
+  // A stage that runs twice in a frame is counted twice.
+  {
+    EPD::ScopedFrame frame(&scheduler);
+    {
+      EPD::ScopedStage receive(EPD::Stage::RECEIVE);
+    }
+    for (int i = 0; i < 2; ++i) {
+      EPD::ScopedStage inference(EPD::Stage::INFERENCE);
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+  }
+  EXPECT_GE(scheduler.getStageLatencyMs(EPD::Stage::INFERENCE), 10.0);
+  EXPECT_DOUBLE_EQ(scheduler.getStageLatencyMs(EPD::Stage::DECODE), 0.0);
+
+  // An abandoned frame does not change the estimates.
+  const double predictedMs = scheduler.getPredictedLatencyMs();
+  {
+    EPD::ScopedFrame frame(&scheduler);
+    {
+      EPD::ScopedStage inference(EPD::Stage::INFERENCE);
+    }
+    scheduler.discardFrame();
+  }
+  EXPECT_DOUBLE_EQ(scheduler.getPredictedLatencyMs(), predictedMs);
+
+  EPD::removeStageObserver(&scheduler);
+}
+
+TEST(EPD_TestSuite, Test_observeBatch_DeadlineScheduler)
+{
+  EPD::DeadlineScheduler scheduler(1.0);
+  ASSERT_TRUE(EPD::addStageObserver(&scheduler));
+
+  // Stages outside any frame are not folded into a later frame.
+  for (int i = 0; i < 3; ++i) {
+    EPD::ScopedStage inference(EPD::Stage::INFERENCE);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  {
+    EPD::ScopedFrame frame(&scheduler);
+    EPD::ScopedStage receive(EPD::Stage::RECEIVE);
+    EPD::ScopedStage convert(EPD::Stage::CONVERT);
+  }
+  EXPECT_DOUBLE_EQ(scheduler.getStageLatencyMs(EPD::Stage::INFERENCE), 0.0);
+
+  // A batch flushed by the timer is measured as a frame of its own.
+  {
+    EPD::ScopedFrame batchFrame(&scheduler);
+    EPD::ScopedStage inference(EPD::Stage::INFERENCE);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  const double batchMs = scheduler.getStageLatencyMs(EPD::Stage::INFERENCE);
+  EXPECT_GE(batchMs, 5.0);
+  EXPECT_LT(batchMs, 30.0);
+
+  // A batch flushed within a camera frame is part of that frame, and is
+  // folded in once, when the camera frame ends.
+  {
+    EPD::ScopedFrame frame(&scheduler);
+    {
+      EPD::ScopedStage receive(EPD::Stage::RECEIVE);
+    }
+    {
+      EPD::ScopedFrame batchFrame(&scheduler);
+      EPD::ScopedStage inference(EPD::Stage::INFERENCE);
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_DOUBLE_EQ(scheduler.getStageLatencyMs(EPD::Stage::INFERENCE), batchMs);
+    EPD::ScopedStage publish(EPD::Stage::PUBLISH);
+  }
+  EXPECT_GT(scheduler.getStageLatencyMs(EPD::Stage::PUBLISH), 0.0);
+
+  EPD::removeStageObserver(&scheduler);
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
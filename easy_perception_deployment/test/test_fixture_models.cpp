@@ -0,0 +1,335 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Runs the P1, P2 and P3 Ort sessions on the offline fixtures written by
+// test/fixtures/generate_fixtures.py at configure time.
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "epd_utils_lib/epd_container.hpp"
+#include "epd_utils_lib/stage_observer.hpp"
+#include "gtest/gtest.h"
+// OpenCV LIB
+#include "opencv2/opencv.hpp"
+
+void writeSessionConfig(const std::string & modelPath, const std::string & mode)
+{
+  std::ofstream sessionConfig("./data/session_config.txt");
+  sessionConfig << modelPath << "\n" <<
+    "./data/fixtures/fixture_classes.txt\n" <<
+    mode << "\n";
+  std::ofstream usecaseConfig("./data/usecase_config.txt");
+  usecaseConfig << "0\n";
+}
+
+cv::Mat loadFixtureImage(const std::string & color)
+{
+  return cv::imread("./data/fixtures/fixture_" + color + ".png", CV_LOAD_IMAGE_COLOR);
+}
+
+TEST(EPD_TestSuite, Test_inferP1Fixture_EPDContainer)
+{
+  writeSessionConfig("./data/fixtures/p1_fixture.onnx", "robot");
+  EPD::EPDContainer ortAgent;
+
+  EXPECT_EQ(ortAgent.precision_level, unsigned(1));
+  EXPECT_EQ(ortAgent.classNames.size(), unsigned(4));
+
+  const std::vector<cv::Mat> frames = {
+    loadFixtureImage("red"), loadFixtureImage("green"), loadFixtureImage("blue")};
+  ASSERT_FALSE(frames[0].empty());
+
+  ortAgent.setFrameDimension(frames[0].cols, frames[0].rows);
+  ortAgent.initORTSessionHandler();
+  ASSERT_EQ(!ortAgent.p1_ort_session, false);
+
+  EXPECT_EQ(ortAgent.p1_ort_session->infer(frames[0])[0], "red");
+
+  const std::vector<std::vector<std::string>> batchOutput =
+    ortAgent.p1_ort_session->infer(frames);
+  ASSERT_EQ(batchOutput.size(), unsigned(3));
+  EXPECT_EQ(batchOutput[0][0], "red");
+  EXPECT_EQ(batchOutput[1][0], "green");
+  EXPECT_EQ(batchOutput[2][0], "blue");
+
+  // The same results as class indices and scores, without object names.
+  EPD::EPDImageClassification result;
+  ortAgent.p1_ort_session->infer(frames[1], result);
+  ASSERT_EQ(result.size(), unsigned(1));
+  EXPECT_EQ(ortAgent.classNames[result.classIndices[0]], "green");
+  EXPECT_GT(result.scores[0], 0.0);
+  EXPECT_LE(result.scores[0], 1.0);
+
+  std::vector<EPD::EPDImageClassification> batchResults;
+  ortAgent.p1_ort_session->infer(frames, batchResults);
+  ASSERT_EQ(batchResults.size(), unsigned(3));
+  for (size_t i = 0; i < batchResults.size(); ++i) {
+    ASSERT_EQ(batchResults[i].size(), unsigned(1));
+    EXPECT_EQ(ortAgent.classNames[batchResults[i].classIndices[0]], batchOutput[i][0]);
+  }
+  EXPECT_EQ(batchResults[1].classIndices, result.classIndices);
+  EXPECT_FLOAT_EQ(batchResults[1].scores[0], result.scores[0]);
+}
+
+TEST(EPD_TestSuite, Test_inferP2Fixture_EPDContainer)
+{
+  writeSessionConfig("./data/fixtures/p2_fixture.onnx", "robot");
+  EPD::EPDContainer ortAgent;
+
+  EXPECT_EQ(ortAgent.precision_level, unsigned(2));
+
+  const cv::Mat frame = loadFixtureImage("red");
+  ortAgent.setFrameDimension(frame.cols, frame.rows);
+  ortAgent.initORTSessionHandler();
+  ASSERT_EQ(!ortAgent.p2_ort_session, false);
+
+  // Only the box of the red channel scores above the threshold. It is
+  // returned in padded input coordinates and scaled back onto the frame.
+  EPD::EPDObjectDetection result = ortAgent.p2_ort_session->infer_action(frame);
+  ASSERT_EQ(result.bboxes.size(), unsigned(1));
+  EXPECT_EQ(ortAgent.classNames[result.classIndices[0]], "red");
+  EXPECT_GT(result.scores[0], 0.99);
+
+  const float ratio = EPD::EPDContainer::computeFrameGeometry(frame.cols, frame.rows).ratio;
+  EXPECT_NEAR(result.bboxes[0][0], 440.0 / ratio, 1e-3);
+  EXPECT_NEAR(result.bboxes[0][1], 40.0 / ratio, 1e-3);
+  EXPECT_NEAR(result.bboxes[0][2], 600.0 / ratio, 1e-3);
+  EXPECT_NEAR(result.bboxes[0][3], 200.0 / ratio, 1e-3);
+
+  cv::Mat resultImg = ortAgent.p2_ort_session->infer_visualize(frame);
+  ASSERT_EQ(resultImg.size(), frame.size());
+  EXPECT_GT(cv::norm(resultImg, frame, cv::NORM_L1), 0.0);
+}
+
+TEST(EPD_TestSuite, Test_inferP3Fixture_EPDContainer)
+{
+  writeSessionConfig("./data/fixtures/p3_fixture.onnx", "robot");
+  EPD::EPDContainer ortAgent;
+
+  EXPECT_EQ(ortAgent.precision_level, unsigned(3));
+
+  const cv::Mat frame = loadFixtureImage("blue");
+  ortAgent.setFrameDimension(frame.cols, frame.rows);
+  ortAgent.initORTSessionHandler();
+  ASSERT_EQ(!ortAgent.p3_ort_session, false);
+
+  EPD::EPDObjectDetection result = ortAgent.p3_ort_session->infer_action(frame);
+  ASSERT_EQ(result.bboxes.size(), unsigned(1));
+  EXPECT_EQ(ortAgent.classNames[result.classIndices[0]], "blue");
+  ASSERT_TRUE(result.hasMasks());
+  ASSERT_EQ(result.maskData.size(), unsigned(28 * 28));
+  cv::Mat mask = result.getMask(0);
+  EXPECT_EQ(mask.rows, 28);
+  EXPECT_EQ(mask.cols, 28);
+  EXPECT_FLOAT_EQ(mask.at<float>(14, 14), 1.0);
+  EXPECT_FLOAT_EQ(mask.at<float>(0, 0), 0.0);
+
+  cv::Mat resultImg = ortAgent.p3_ort_session->infer_visualize(frame);
+  ASSERT_EQ(resultImg.size(), frame.size());
+  EXPECT_GT(cv::norm(resultImg, frame, cv::NORM_L1), 0.0);
+}
+
+TEST(EPD_TestSuite, Test_concurrentP3Fixture_EPDContainer)
+{
+  writeSessionConfig("./data/fixtures/p3_fixture.onnx", "robot");
+  EPD::EPDContainer ortAgent;
+
+  const std::vector<cv::Mat> frames = {
+    loadFixtureImage("red"), loadFixtureImage("green"), loadFixtureImage("blue")};
+  ASSERT_FALSE(frames[0].empty());
+  const Ort::FrameGeometry geometry =
+    EPD::EPDContainer::computeFrameGeometry(frames[0].cols, frames[0].rows);
+
+  // Every thread initializes the container, yet the session is created once.
+  const int NUM_THREADS = 4, NUM_ITERATIONS = 20;
+  std::vector<Ort::P3OrtBase *> sessions(NUM_THREADS, nullptr);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < NUM_THREADS; ++t) {
+    threads.emplace_back(
+      [&, t]() {
+        ortAgent.initialize(frames[0].cols, frames[0].rows);
+        sessions[t] = ortAgent.getSession<Ort::P3OrtBase>();
+      });
+  }
+  for (auto & thread : threads) {
+    thread.join();
+  }
+  ASSERT_TRUE(ortAgent.isInit());
+  ASSERT_NE(sessions[0], nullptr);
+  for (int t = 1; t < NUM_THREADS; ++t) {
+    EXPECT_EQ(sessions[t], sessions[0]);
+  }
+
+  std::vector<EPD::EPDObjectDetection> expected;
+  for (const auto & frame : frames) {
+    expected.push_back(ortAgent.p3_ort_session->infer_action(frame, geometry));
+  }
+
+  // Concurrent runs of the shared session match the sequential ones.
+  std::atomic<int> numMismatches(0);
+  threads.clear();
+  for (int t = 0; t < NUM_THREADS; ++t) {
+    threads.emplace_back(
+      [&, t]() {
+        EPD::EPDObjectDetection result;
+        for (int i = 0; i < NUM_ITERATIONS; ++i) {
+          const size_t idx = (t + i) % frames.size();
+          ortAgent.p3_ort_session->infer_action(frames[idx], geometry, result);
+          if (result.classIndices != expected[idx].classIndices ||
+            result.bboxes != expected[idx].bboxes ||
+            result.maskData != expected[idx].maskData)
+          {
+            ++numMismatches;
+          }
+        }
+      });
+  }
+  for (auto & thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(numMismatches.load(), 0);
+}
+
+/*! \brief A StageObserver that counts the runs of the Ort Sessions.*/
+class InferenceCounter : public EPD::StageObserver
+{
+public:
+  void onStageBegin(EPD::Stage stage) override
+  {
+    if (stage == EPD::Stage::INFERENCE) {
+      ++numRuns;
+    }
+  }
+  void onStageEnd(EPD::Stage) override {}
+
+  std::atomic<int> numRuns{0};
+};
+
+TEST(EPD_TestSuite, Test_cascadeFixture_EPDContainer)
+{
+  writeSessionConfig("./data/fixtures/p2_fixture.onnx", "robot");
+  {
+    std::ofstream cascadeConfig("./data/cascade_config.txt");
+    cascadeConfig << "./data/fixtures/p1_fixture.onnx\n" <<
+      "./data/fixtures/fixture_classes.txt\n";
+  }
+  EPD::EPDContainer ortAgent;
+  std::remove("./data/cascade_config.txt");
+  ASSERT_TRUE(ortAgent.isCascade());
+
+  // Every fixed P2 box covers a patch of its own channel on a white frame.
+  // The boxes are in padded input coordinates, so they are mapped back onto
+  // the frame, with a margin for rounding.
+  cv::Mat frame(480, 640, CV_8UC3, cv::Scalar(255, 255, 255));
+  const float ratio = EPD::EPDContainer::computeFrameGeometry(frame.cols, frame.rows).ratio;
+  const std::vector<cv::Scalar> colors = {
+    cv::Scalar(255, 0, 0), cv::Scalar(0, 255, 0), cv::Scalar(0, 0, 255)};
+  const int side = static_cast<int>(160 / ratio) + 8;
+  for (size_t c = 0; c < colors.size(); ++c) {
+    const int xmin = static_cast<int>((40 + 200 * c) / ratio) - 4;
+    const int ymin = static_cast<int>(40 / ratio) - 4;
+    frame(cv::Rect(xmin, ymin, side, side)).setTo(colors[c]);
+  }
+
+  ortAgent.initialize(frame.cols, frame.rows);
+  ASSERT_EQ(!ortAgent.cascade_ort_session, false);
+  ASSERT_TRUE(ortAgent.cascade_ort_session->hasDynamicBatch());
+
+  EPD::EPDObjectDetection result = ortAgent.p2_ort_session->infer_action(frame);
+  ASSERT_EQ(result.size(), unsigned(3));
+
+  // All crops of a frame are classified in a single batched run.
+  InferenceCounter counter;
+  ASSERT_TRUE(EPD::addStageObserver(&counter));
+  ortAgent.classifyDetections(frame, *EPD::getInferenceConfig(), result);
+  EPD::removeStageObserver(&counter);
+  EXPECT_EQ(counter.numRuns.load(), 1);
+
+  ASSERT_EQ(result.cascadeNames.size(), result.size());
+  for (size_t i = 0; i < result.size(); ++i) {
+    EXPECT_EQ(result.cascadeNames[i], ortAgent.classNames[result.classIndices[i]]);
+  }
+}
+
+TEST(EPD_TestSuite, Test_cancelP1Fixture_EPDContainer)
+{
+  writeSessionConfig("./data/fixtures/p1_fixture.onnx", "robot");
+  EPD::EPDContainer ortAgent;
+
+  const cv::Mat frame = loadFixtureImage("red");
+  ASSERT_FALSE(frame.empty());
+  ortAgent.initialize(frame.cols, frame.rows);
+
+  // A cancelled RunCanceller terminates the runs of the thread it is bound to.
+  Ort::RunCanceller canceller;
+  canceller.cancel();
+  {
+    Ort::ScopedRunCanceller boundCanceller(&canceller);
+    EXPECT_THROW(ortAgent.p1_ort_session->infer(frame), Ort::RunTerminated);
+
+    // Other threads are not affected.
+    std::vector<std::string> otherOutput;
+    std::thread other([&]() {otherOutput = ortAgent.p1_ort_session->infer(frame);});
+    other.join();
+    ASSERT_EQ(otherOutput.size(), unsigned(1));
+    EXPECT_EQ(otherOutput[0], "red");
+
+    canceller.reset();
+    EXPECT_EQ(ortAgent.p1_ort_session->infer(frame)[0], "red");
+    canceller.cancel();
+  }
+
+  // Once unbound, the RunCanceller no longer applies.
+  EXPECT_EQ(ortAgent.p1_ort_session->infer(frame)[0], "red");
+}
+
+TEST(EPD_TestSuite, Test_startupPhases_EPDContainer)
+{
+  writeSessionConfig("./data/fixtures/p2_fixture.onnx", "robot");
+  EPD::EPDContainer ortAgent;
+
+  const cv::Mat frame = loadFixtureImage("green");
+  ASSERT_FALSE(frame.empty());
+
+  // The constructor only runs the phases that need no frame.
+  for (size_t p = 0; p < EPD::NUM_STARTUP_PHASES; ++p) {
+    const EPD::StartupPhase phase = static_cast<EPD::StartupPhase>(p);
+    if (phase < EPD::StartupPhase::SESSIONS) {
+      EXPECT_GE(ortAgent.getStartupPhaseMs(phase), 0.0) << EPD::getStartupPhaseName(phase);
+    } else {
+      EXPECT_LT(ortAgent.getStartupPhaseMs(phase), 0.0) << EPD::getStartupPhaseName(phase);
+    }
+  }
+
+  EXPECT_TRUE(ortAgent.initialize(frame.cols, frame.rows, true));
+  EXPECT_FALSE(ortAgent.initialize(frame.cols, frame.rows, true));
+  EXPECT_GT(ortAgent.getStartupPhaseMs(EPD::StartupPhase::SESSIONS), 0.0);
+  EXPECT_GT(ortAgent.getStartupPhaseMs(EPD::StartupPhase::FIRST_RUN), 0.0);
+
+  // The warm-up run does not change the results of the first real frame.
+  EPD::EPDObjectDetection result = ortAgent.p2_ort_session->infer_action(frame);
+  ASSERT_EQ(result.bboxes.size(), unsigned(1));
+  EXPECT_EQ(ortAgent.classNames[result.classIndices[0]], "green");
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
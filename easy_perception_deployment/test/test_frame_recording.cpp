@@ -0,0 +1,108 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "epd_utils_lib/frame_recording.hpp"
+
+const char TEST_RECORDING_PATH[] = "./epd_test_recording.bin";
+
+std::vector<uint8_t> makeFrameData(uint32_t step, uint32_t height, uint8_t seed)
+{
+  std::vector<uint8_t> data(step * height);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<uint8_t>(i * 31 + seed);
+  }
+  return data;
+}
+
+void removeRecording()
+{
+  std::remove(TEST_RECORDING_PATH);
+  std::remove((std::string(TEST_RECORDING_PATH) + ".idx").c_str());
+}
+
+TEST(EPD_TestSuite, Test_roundTrip_FrameRecording)
+{
+  const std::vector<uint8_t> small = makeFrameData(64 * 3, 48, 1);
+  const std::vector<uint8_t> large = makeFrameData(640 * 3, 480, 2);
+  {
+    // Grows the data file several times over.
+    EPD::FrameRecordWriter writer(TEST_RECORDING_PATH, 4096);
+    EXPECT_EQ(writer.append(1000, 2000, 64, 48, 64 * 3, "bgr8", small.data()), 0u);
+    EXPECT_EQ(writer.append(1033, 2033, 640, 480, 640 * 3, "rgb8", large.data()), 1u);
+    EXPECT_EQ(writer.append(1066, 2066, 64, 48, 64 * 3, "mono8", small.data()), 2u);
+    EXPECT_EQ(writer.getNumFrames(), 3u);
+  }
+
+  EPD::FrameRecordReader reader(TEST_RECORDING_PATH);
+  ASSERT_EQ(reader.getNumFrames(), 3u);
+
+  EPD::FrameView frame = reader.getFrame(1);
+  EXPECT_EQ(frame.stampNs, 1033);
+  EXPECT_EQ(frame.receiveNs, 2033);
+  EXPECT_EQ(frame.width, 640u);
+  EXPECT_EQ(frame.height, 480u);
+  EXPECT_EQ(frame.step, 640u * 3u);
+  EXPECT_EQ(frame.encoding, "rgb8");
+  ASSERT_EQ(frame.dataSize, large.size());
+  EXPECT_EQ(std::vector<uint8_t>(frame.data, frame.data + frame.dataSize), large);
+
+  frame = reader.getFrame(2);
+  EXPECT_EQ(frame.encoding, "mono8");
+  EXPECT_EQ(std::vector<uint8_t>(frame.data, frame.data + frame.dataSize), small);
+  EXPECT_EQ(reader.getReceiveNs(0), 2000);
+  EXPECT_THROW(reader.getFrame(3), std::out_of_range);
+
+  removeRecording();
+}
+
+TEST(EPD_TestSuite, Test_ignoreIncompleteFrames_FrameRecording)
+{
+  const std::vector<uint8_t> data = makeFrameData(64 * 3, 48, 3);
+  {
+    EPD::FrameRecordWriter writer(TEST_RECORDING_PATH);
+    writer.append(0, 0, 64, 48, 64 * 3, "bgr8", data.data());
+    writer.append(1, 1, 64, 48, 64 * 3, "bgr8", data.data());
+  }
+  // A crash while indexing leaves a partial entry at the end of the index.
+  {
+    std::ofstream index(std::string(TEST_RECORDING_PATH) + ".idx",
+      std::ios::binary | std::ios::app);
+    index.write("\x01\x02\x03", 3);
+  }
+  EXPECT_EQ(EPD::FrameRecordReader(TEST_RECORDING_PATH).getNumFrames(), 2u);
+
+  // An entry pointing past the end of the data file is dropped as well.
+  {
+    std::ofstream index(std::string(TEST_RECORDING_PATH) + ".idx",
+      std::ios::binary | std::ios::trunc);
+    const EPD::FrameIndexEntry entries[] = {{64, 0}, {1 << 20, 1}};
+    index.write(reinterpret_cast<const char *>(entries), sizeof(entries));
+  }
+  EXPECT_EQ(EPD::FrameRecordReader(TEST_RECORDING_PATH).getNumFrames(), 1u);
+
+  removeRecording();
+  EXPECT_THROW(EPD::FrameRecordReader("./epd_missing_recording.bin"), std::runtime_error);
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
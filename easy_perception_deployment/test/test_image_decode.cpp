@@ -0,0 +1,66 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vector>
+#include "gtest/gtest.h"
+#include "epd_utils_lib/image_decode.hpp"
+// OpenCV LIB
+#include "opencv2/opencv.hpp"
+
+TEST(EPD_TestSuite, Test_readJpegDimensions)
+{
+  cv::Mat frame(960, 1280, CV_8UC3, cv::Scalar(30, 90, 150));
+  std::vector<uint8_t> jpeg;
+  cv::imencode(".jpg", frame, jpeg);
+
+  int width = 0, height = 0;
+  ASSERT_TRUE(EPD::readJpegDimensions(jpeg, width, height));
+  EXPECT_EQ(width, 1280);
+  EXPECT_EQ(height, 960);
+
+  std::vector<uint8_t> png;
+  cv::imencode(".png", frame, png);
+  EXPECT_FALSE(EPD::readJpegDimensions(png, width, height));
+}
+
+TEST(EPD_TestSuite, Test_selectJpegScale)
+{
+  EXPECT_EQ(EPD::selectJpegScale(1920, 1080, 1422, 800), 1);
+  EXPECT_EQ(EPD::selectJpegScale(3840, 2160, 1422, 800), 2);
+  EXPECT_EQ(EPD::selectJpegScale(1280, 960, 224, 224), 4);
+  EXPECT_EQ(EPD::selectJpegScale(4000, 3000, 224, 224), 8);
+}
+
+TEST(EPD_TestSuite, Test_decodeImage)
+{
+  cv::Mat frame(960, 1280, CV_8UC3, cv::Scalar(30, 90, 150));
+  std::vector<uint8_t> jpeg;
+  cv::imencode(".jpg", frame, jpeg);
+
+  cv::Mat decoded = EPD::decodeImage(jpeg, 4);
+  EXPECT_EQ(decoded.cols, 320);
+  EXPECT_EQ(decoded.rows, 240);
+  EXPECT_EQ(decoded.type(), CV_8UC3);
+
+  decoded = EPD::decodeImage(jpeg, 1);
+  EXPECT_EQ(decoded.cols, 1280);
+  EXPECT_EQ(decoded.rows, 960);
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,88 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "opencv2/opencv.hpp"
+#include "epd_utils_lib/inference_config.hpp"
+#include "epd_utils_lib/usecase_config.hpp"
+
+TEST(EPD_TestSuite, Test_publish_InferenceConfig)
+{
+  const std::shared_ptr<const EPD::InferenceConfig> initial = EPD::getInferenceConfig();
+  EXPECT_FLOAT_EQ(initial->confThreshold, 0.5f);
+  EXPECT_EQ(initial->useCaseMode, EPD::CLASSIFICATION_MODE);
+  EXPECT_TRUE(initial->onlyVisualize);
+
+  EPD::InferenceConfig config = *initial;
+  config.confThreshold = 0.7f;
+  config.onlyVisualize = false;
+  std::shared_ptr<const EPD::InferenceConfig> published = EPD::setInferenceConfig(config);
+
+  EXPECT_EQ(EPD::getInferenceConfig(), published);
+  EXPECT_EQ(EPD::getInferenceConfig(), EPD::getInferenceConfig());
+  EXPECT_FLOAT_EQ(EPD::getInferenceConfig()->confThreshold, 0.7f);
+  EXPECT_FALSE(EPD::getInferenceConfig()->onlyVisualize);
+
+  // A frame holding the previous snapshot keeps reading it unchanged.
+  EXPECT_FLOAT_EQ(initial->confThreshold, 0.5f);
+  EXPECT_TRUE(initial->onlyVisualize);
+
+  // A snapshot is freed once it is replaced, no frame holds it anymore and
+  // the threads that cached it read again.
+  std::weak_ptr<const EPD::InferenceConfig> replaced = published;
+  EPD::setInferenceConfig(*initial);
+  EXPECT_FALSE(replaced.expired());
+  published.reset();
+  EXPECT_FLOAT_EQ(EPD::getInferenceConfig()->confThreshold, 0.5f);
+  EXPECT_TRUE(replaced.expired());
+}
+
+TEST(EPD_TestSuite, Test_activateUseCase_InferenceConfig)
+{
+  // The left half of img is red and the right half is blue.
+  cv::Mat img(20, 40, CV_8UC3, cv::Scalar(0, 0, 255));
+  img(cv::Rect(20, 0, 20, 20)).setTo(cv::Scalar(255, 0, 0));
+  const std::vector<std::string> classNames = {"red", "blue"};
+
+  EPD::EPDObjectDetection result;
+  result.clear(0, 0);
+  result.add({0, 0, 10, 10}, 0, 0.9f);
+  result.add({25, 5, 35, 15}, 1, 0.9f);
+
+  EPD::InferenceConfig config;
+  EPD::EPDObjectDetection counted = result;
+  config.useCaseMode = EPD::COUNTING_MODE;
+  config.countClassNames = {"blue"};
+  EPD::activateUseCase(img, counted, classNames, config);
+  ASSERT_EQ(counted.size(), 1u);
+  EXPECT_EQ(counted.classIndices[0], 1u);
+
+  EPD::EPDObjectDetection matched = result;
+  cv::Mat hsv;
+  config.useCaseMode = EPD::COLOR_MATCHING_MODE;
+  EPD::computeColorHistogram(img(cv::Rect(0, 0, 20, 20)), hsv, config.refColorHist);
+  EPD::activateUseCase(img, matched, classNames, config);
+  ASSERT_EQ(matched.size(), 1u);
+  EXPECT_EQ(matched.classIndices[0], 0u);
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
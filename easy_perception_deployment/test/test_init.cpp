@@ -29,13 +29,13 @@ TEST(EPD_TestSuite, Test_emptySessionConfig_EPDContainer)
 {
   if (!is_file_exist("./data/session_config.txt")) {
     system("touch ./data/session_config.txt");
-    system("echo ./data/model/squeezenet1.1-7.onnx >> ./data/session_config.txt");
-    system("echo ./data/label_list/imagenet_classes.txt >> ./data/session_config.txt");
+    system("echo ./data/fixtures/p1_fixture.onnx >> ./data/session_config.txt");
+    system("echo ./data/fixtures/fixture_classes.txt >> ./data/session_config.txt");
   } else {
     system("rm ./data/session_config.txt");
     system("touch ./data/session_config.txt");
-    system("echo ./data/model/squeezenet1.1-7.onnx >> ./data/session_config.txt");
-    system("echo ./data/label_list/imagenet_classes.txt >> ./data/session_config.txt");
+    system("echo ./data/fixtures/p1_fixture.onnx >> ./data/session_config.txt");
+    system("echo ./data/fixtures/fixture_classes.txt >> ./data/session_config.txt");
   }
 
   if (!is_file_exist("./data/usecase_config.txt")) {
@@ -50,8 +50,8 @@ TEST(EPD_TestSuite, Test_emptySessionConfig_EPDContainer)
 
   ortAgent_ = new EPD::EPDContainer();
 
-  EXPECT_EQ(ortAgent_->onnx_model_path, "./data/model/squeezenet1.1-7.onnx");
-  EXPECT_EQ(ortAgent_->class_label_path, "./data/label_list/imagenet_classes.txt");
+  EXPECT_EQ(ortAgent_->onnx_model_path, "./data/fixtures/p1_fixture.onnx");
+  EXPECT_EQ(ortAgent_->class_label_path, "./data/fixtures/fixture_classes.txt");
 
   delete ortAgent_;
 }
@@ -81,6 +81,30 @@ TEST(EPD_TestSuite, Test_setInitBoolean_EPDContainer)
   delete ortAgent_;
 }
 
+TEST(EPD_TestSuite, Test_computeFrameGeometry_EPDContainer)
+{
+  Ort::FrameGeometry geometry = EPD::EPDContainer::computeFrameGeometry(1920, 1080);
+
+  EXPECT_EQ(geometry.newW, 1422);
+  EXPECT_EQ(geometry.newH, 800);
+  EXPECT_EQ(geometry.paddedW, 1440);
+  EXPECT_EQ(geometry.paddedH, 800);
+
+  geometry = EPD::EPDContainer::computeFrameGeometry(640, 480);
+
+  EXPECT_EQ(geometry.newW, 1066);
+  EXPECT_EQ(geometry.newH, 800);
+  EXPECT_EQ(geometry.paddedW, 1088);
+  EXPECT_EQ(geometry.paddedH, 800);
+
+  geometry = EPD::EPDContainer::computeFrameGeometry(1920, 1080, 480);
+
+  EXPECT_EQ(geometry.newW, 853);
+  EXPECT_EQ(geometry.newH, 480);
+  EXPECT_EQ(geometry.paddedW, 864);
+  EXPECT_EQ(geometry.paddedH, 480);
+}
+
 int main(int argc, char ** argv)
 {
   testing::InitGoogleTest(&argc, argv);
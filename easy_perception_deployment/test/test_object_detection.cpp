@@ -0,0 +1,106 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "epd_utils_lib/message_utils.hpp"
+
+const int MASK_SIZE = 4;
+
+/*! \brief A Mutator function that appends detection i, whose every field and
+mask value is derived from i.*/
+void addDetection(EPD::EPDObjectDetection & result, int i)
+{
+  std::vector<float> mask(MASK_SIZE * MASK_SIZE, static_cast<float>(i));
+  result.add({1.0f * i, 2.0f * i, 3.0f * i, 4.0f * i}, i, 0.1f * i, mask.data());
+}
+
+TEST(EPD_TestSuite, Test_filter_EPDObjectDetection)
+{
+  EPD::EPDObjectDetection result;
+  result.clear(MASK_SIZE, MASK_SIZE);
+  for (int i = 0; i < 6; ++i) {
+    addDetection(result, i);
+    result.cascadeNames.push_back("object_" + std::to_string(i));
+  }
+  ASSERT_EQ(result.size(), 6u);
+  ASSERT_EQ(result.maskData.size(), 6u * MASK_SIZE * MASK_SIZE);
+
+  std::vector<size_t> visited;
+  result.filter(
+    [&](size_t i) {
+      visited.push_back(i);
+      return result.classIndices[i] % 2 == 1;
+    });
+
+  EXPECT_EQ(visited, std::vector<size_t>({0, 1, 2, 3, 4, 5}));
+  ASSERT_EQ(result.size(), 3u);
+  EXPECT_EQ(result.data_size, 3u);
+  EXPECT_EQ(result.maskData.size(), 3u * MASK_SIZE * MASK_SIZE);
+  for (size_t k = 0; k < result.size(); ++k) {
+    const int i = 2 * k + 1;
+    EXPECT_EQ(result.classIndices[k], static_cast<uint64_t>(i));
+    EXPECT_FLOAT_EQ(result.scores[k], 0.1f * i);
+    EXPECT_FLOAT_EQ(result.bboxes[k][3], 4.0f * i);
+    EXPECT_EQ(result.cascadeNames[k], "object_" + std::to_string(i));
+
+    cv::Mat mask = result.getMask(k);
+    EXPECT_EQ(mask.rows, MASK_SIZE);
+    EXPECT_EQ(mask.cols, MASK_SIZE);
+    EXPECT_FLOAT_EQ(mask.at<float>(MASK_SIZE - 1, MASK_SIZE - 1), static_cast<float>(i));
+  }
+}
+
+TEST(EPD_TestSuite, Test_recycle_EPDObjectDetectionPool)
+{
+  EPD::EPDObjectDetectionPool pool(1);
+  EPD::EPDObjectDetection * first = nullptr;
+  size_t capacity = 0;
+  {
+    EPD::PooledDetection result = pool.acquire();
+    result->clear(MASK_SIZE, MASK_SIZE);
+    for (int i = 0; i < 10; ++i) {
+      addDetection(*result, i);
+    }
+    first = result.get();
+    capacity = result->maskData.capacity();
+  }
+
+  // A released result is handed out again, empty but with its storage.
+  {
+    EPD::PooledDetection result = pool.acquire();
+    EXPECT_EQ(result.get(), first);
+    EXPECT_EQ(result->size(), 0u);
+    EXPECT_TRUE(result->bboxes.empty());
+    EXPECT_FALSE(result->hasMasks());
+    EXPECT_EQ(result->maskData.capacity(), capacity);
+
+    // The pool grows while every result is in use.
+    EPD::PooledDetection other = pool.acquire();
+    EXPECT_NE(other.get(), first);
+    EXPECT_EQ(pool.getNumCreated(), 2u);
+  }
+
+  EPD::PooledDetection a = pool.acquire();
+  EPD::PooledDetection b = pool.acquire();
+  EXPECT_EQ(pool.getNumCreated(), 2u);
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
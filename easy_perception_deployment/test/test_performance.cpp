@@ -0,0 +1,249 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/* Performance regression gate, built with -DEPD_PERF_GATE=ON and run with
+`ctest -L performance`.
+
+Every stage of a P2 and a P3 frame that does not need a model file is run
+over fixed-seed workloads. The median time of each stage is compared against
+test/performance_baseline.json. A stage slower than its baseline by more
+than the baseline's tolerance fails the test with a per-stage diff.
+
+Baselines are machine-specific. Regenerate them on the reference machine with
+  EPD_UPDATE_PERF_BASELINE=1 ctest -L performance
+and commit the result. The gate fails without a baseline to compare against:
+when the baseline is empty, when a measured stage has no baseline, and when a
+stage of the baseline is no longer measured or has no positive time. */
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "epd_utils_lib/stage_observer.hpp"
+#include "epd_utils_lib/usecase_config.hpp"
+#include "ort_cpp_lib/p2_ort_base.hpp"
+#include "ort_cpp_lib/p3_ort_base.hpp"
+#include "kernel_workloads.hpp"
+
+#ifndef EPD_PERF_BASELINE
+#define EPD_PERF_BASELINE "test/performance_baseline.json"
+#endif
+
+const int WARMUP_RUNS = 5;
+const int MEASURED_RUNS = 31;
+const double DEFAULT_TOLERANCE = 0.25;
+
+/*! \brief The parsed content of performance_baseline.json.*/
+struct PerfBaseline
+{
+  double tolerance = DEFAULT_TOLERANCE;
+  std::map<std::string, double> stages_ms;
+};
+
+PerfBaseline readBaseline(const std::string & path)
+{
+  PerfBaseline baseline;
+  std::ifstream infile(path);
+  std::stringstream buffer;
+  buffer << infile.rdbuf();
+  const std::string content = buffer.str();
+
+  // The baseline is a flat list of "name": number pairs.
+  static const std::regex ENTRY("\"([A-Za-z0-9_]+)\"\\s*:\\s*([-+0-9.eE]+)");
+  for (auto it = std::sregex_iterator(content.begin(), content.end(), ENTRY);
+    it != std::sregex_iterator(); ++it)
+  {
+    const std::string key = (*it)[1];
+    const double value = std::stod((*it)[2]);
+    if (key == "tolerance") {
+      baseline.tolerance = value;
+    } else {
+      baseline.stages_ms[key] = value;
+    }
+  }
+  return baseline;
+}
+
+void writeBaseline(const std::string & path, const PerfBaseline & baseline)
+{
+  std::ofstream outfile(path);
+  outfile << "{\n  \"tolerance\": " << baseline.tolerance << ",\n  \"stages_ms\": {";
+  bool first = true;
+  for (const auto & stage : baseline.stages_ms) {
+    outfile << (first ? "\n" : ",\n") << "    \"" << stage.first << "\": " << stage.second;
+    first = false;
+  }
+  outfile << "\n  }\n}\n";
+}
+
+/*! \brief A Mutator function that runs the model-independent stages of one P2
+or P3 frame, marking each with a ScopedStage.*/
+void runFrame(
+  const cv::Mat & img,
+  KernelWorkloads::DetectionWorkload & workload,
+  const std::vector<std::string> & classNames,
+  const std::vector<std::string> & countClassNames,
+  bool withMasks)
+{
+  const Ort::FrameGeometry geometry = {1.0, 1066, 800, 1088, 800};
+  const EPD::InferenceConfig config;
+  std::vector<float> inputData;
+  {
+    EPD::ScopedStage stage(EPD::Stage::PREPROCESS);
+    if (withMasks) {
+      Ort::P3OrtBase::preprocess(img, geometry, config.detectionMean, inputData);
+    } else {
+      Ort::P2OrtBase::preprocess(img, geometry, config.detectionMean, inputData);
+    }
+  }
+
+  auto outputs = workload.getOutputs();
+  EPD::EPDObjectDetection result;
+  {
+    EPD::ScopedStage stage(EPD::Stage::DECODE);
+    if (withMasks) {
+      Ort::P3OrtBase::decode(outputs, geometry.ratio, img.cols, img.rows, 0.5, result);
+    } else {
+      Ort::P2OrtBase::decode(outputs, geometry.ratio, img.cols, img.rows, 0.5, result);
+    }
+  }
+  {
+    EPD::ScopedStage stage(EPD::Stage::USECASE);
+    EPD::count(result, classNames, countClassNames);
+  }
+  EPD::ScopedStage stage(EPD::Stage::VISUALIZE);
+  cv::Mat visualized = withMasks ?
+    Ort::P3OrtBase::visualize(img, result, classNames, 0.5) :
+    Ort::P2OrtBase::visualize(img, result, classNames);
+}
+
+/*! \brief A Mutator function that measures the median time of every stage of
+runFrame, keyed by "<prefix>_<stage>".*/
+void measureStages(
+  const std::string & prefix,
+  bool withMasks,
+  std::map<std::string, double> & measured_ms)
+{
+  const int numClasses = 80;
+  cv::Mat img = KernelWorkloads::makeImage(640, 480);
+  auto workload = KernelWorkloads::makeDetections(100, 640, 480, numClasses, withMasks);
+  const std::vector<std::string> classNames = KernelWorkloads::makeClassNames(numClasses);
+  const std::vector<std::string> countClassNames = {"class_0", "class_1", "class_2", "class_3"};
+
+  for (int i = 0; i < WARMUP_RUNS; ++i) {
+    runFrame(img, workload, classNames, countClassNames, withMasks);
+  }
+
+  EPD::StageClock stageClock;
+  ASSERT_TRUE(EPD::addStageObserver(&stageClock));
+
+  std::vector<std::vector<double>> samples(EPD::NUM_STAGES);
+  for (int i = 0; i < MEASURED_RUNS; ++i) {
+    stageClock.reset();
+    runFrame(img, workload, classNames, countClassNames, withMasks);
+    for (size_t s = 0; s < EPD::NUM_STAGES; ++s) {
+      samples[s].push_back(stageClock.getElapsedMs(static_cast<EPD::Stage>(s)));
+    }
+  }
+  EPD::removeStageObserver(&stageClock);
+
+  for (size_t s = 0; s < EPD::NUM_STAGES; ++s) {
+    auto & stageSamples = samples[s];
+    std::sort(stageSamples.begin(), stageSamples.end());
+    const double median = stageSamples[stageSamples.size() / 2];
+    if (median > 0.0) {
+      measured_ms[prefix + "_" + EPD::getStageName(static_cast<EPD::Stage>(s))] = median;
+    }
+  }
+}
+
+TEST(EPD_TestSuite, Test_performanceRegression)
+{
+  std::map<std::string, double> measured_ms;
+  measureStages("p2", false, measured_ms);
+  measureStages("p3", true, measured_ms);
+  ASSERT_FALSE(measured_ms.empty());
+
+  PerfBaseline baseline = readBaseline(EPD_PERF_BASELINE);
+
+  const char * update = std::getenv("EPD_UPDATE_PERF_BASELINE");
+  if (update != nullptr && std::string(update) == "1") {
+    baseline.stages_ms = measured_ms;
+    writeBaseline(EPD_PERF_BASELINE, baseline);
+    printf("Updated performance baseline %s\n", EPD_PERF_BASELINE);
+    return;
+  }
+
+  ASSERT_FALSE(baseline.stages_ms.empty()) << "No baseline in " << EPD_PERF_BASELINE <<
+    ". Generate it on the reference machine with EPD_UPDATE_PERF_BASELINE=1.";
+
+  bool hasRegression = false;
+  bool hasMissingStage = false;
+  std::ostringstream diff;
+  diff << "stage               baseline(ms)  measured(ms)   change\n";
+  for (const auto & stage : measured_ms) {
+    char line[128];
+    auto it = baseline.stages_ms.find(stage.first);
+    if (it == baseline.stages_ms.end()) {
+      hasMissingStage = true;
+      snprintf(line, sizeof(line), "%-18s  %12s  %12.3f   NO BASELINE\n",
+        stage.first.c_str(), "-", stage.second);
+    } else if (it->second <= 0.0) {
+      hasMissingStage = true;
+      snprintf(line, sizeof(line), "%-18s  %12.3f  %12.3f   EMPTY BASELINE\n",
+        stage.first.c_str(), it->second, stage.second);
+    } else {
+      const double change = (stage.second - it->second) / it->second;
+      const bool regressed = change > baseline.tolerance;
+      hasRegression |= regressed;
+      snprintf(line, sizeof(line), "%-18s  %12.3f  %12.3f  %+6.1f%%%s\n",
+        stage.first.c_str(), it->second, stage.second, change * 100.0,
+        regressed ? "  REGRESSION" : "");
+    }
+    diff << line;
+  }
+  bool hasUnmeasuredStage = false;
+  for (const auto & stage : baseline.stages_ms) {
+    if (measured_ms.find(stage.first) == measured_ms.end()) {
+      hasUnmeasuredStage = true;
+      char line[128];
+      snprintf(line, sizeof(line), "%-18s  %12.3f  %12s   NOT MEASURED\n",
+        stage.first.c_str(), stage.second, "-");
+      diff << line;
+    }
+  }
+  printf("%s", diff.str().c_str());
+
+  EXPECT_FALSE(hasRegression) << "Stages regressed by more than " <<
+    baseline.tolerance * 100.0 << "% over " << EPD_PERF_BASELINE << ":\n" << diff.str();
+  EXPECT_FALSE(hasMissingStage) << "Stages have no baseline in " << EPD_PERF_BASELINE <<
+    ". Regenerate it with EPD_UPDATE_PERF_BASELINE=1:\n" << diff.str();
+  EXPECT_FALSE(hasUnmeasuredStage) << "Stages of " << EPD_PERF_BASELINE <<
+    " are no longer measured. Regenerate it with EPD_UPDATE_PERF_BASELINE=1:\n" << diff.str();
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,87 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdexcept>
+#include <vector>
+#include "gtest/gtest.h"
+#include "epd_utils_lib/resolution_controller.hpp"
+
+/*! \brief A Mutator function that feeds the latency a frame takes at the
+current level, given the latency at a short side of 800, for numFrames frames.
+Returns the number of switches.*/
+int runFrames(EPD::ResolutionController & controller, double latencyAt800Ms, int numFrames)
+{
+  int numSwitches = 0;
+  for (int i = 0; i < numFrames; ++i) {
+    const double scale = controller.getShortSide() / 800.0;
+    numSwitches += controller.update(latencyAt800Ms * scale * scale);
+  }
+  return numSwitches;
+}
+
+TEST(EPD_TestSuite, Test_levels_ResolutionController)
+{
+  EPD::ResolutionController controller({800, 480, 640, 640}, 100.0);
+  EXPECT_EQ(controller.getShortSides(), std::vector<int>({480, 640, 800}));
+  EXPECT_EQ(controller.getShortSide(), 800);
+
+  EXPECT_THROW(EPD::ResolutionController({}), std::runtime_error);
+  EXPECT_THROW(EPD::ResolutionController({0, 800}), std::runtime_error);
+}
+
+TEST(EPD_TestSuite, Test_adapt_ResolutionController)
+{
+  EPD::ResolutionController controller({480, 640, 800}, 100.0, 5);
+
+  // Within the target, the largest level is kept.
+  EXPECT_EQ(runFrames(controller, 80.0, 50), 0);
+  EXPECT_EQ(controller.getShortSide(), 800);
+
+  // Under load it steps down until the latency fits in the target.
+  runFrames(controller, 200.0, 50);
+  EXPECT_EQ(controller.getShortSide(), 480);
+  EXPECT_LT(controller.getLatencyMs(), 100.0);
+
+  // A level that would be predicted to exceed the target is not tried.
+  EXPECT_EQ(runFrames(controller, 200.0, 50), 0);
+
+  // Once the load is gone it steps back up.
+  runFrames(controller, 50.0, 50);
+  EXPECT_EQ(controller.getShortSide(), 800);
+}
+
+TEST(EPD_TestSuite, Test_hold_ResolutionController)
+{
+  EPD::ResolutionController controller({480, 640, 800}, 100.0, 10);
+
+  // A single slow frame, such as the first one, does not switch level.
+  EXPECT_FALSE(controller.update(1000.0));
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_FALSE(controller.update(150.0));
+  }
+  EXPECT_TRUE(controller.update(150.0));
+  EXPECT_EQ(controller.getShortSide(), 640);
+
+  // A disabled controller never switches.
+  EPD::ResolutionController disabled({480, 640, 800});
+  EXPECT_EQ(runFrames(disabled, 1000.0, 50), 0);
+  EXPECT_EQ(disabled.getShortSide(), 800);
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
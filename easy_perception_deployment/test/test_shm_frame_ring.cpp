@@ -0,0 +1,95 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include "gtest/gtest.h"
+#include "epd_utils_lib/shm_frame_ring.hpp"
+// OpenCV LIB
+#include "opencv2/opencv.hpp"
+
+const char TEST_RING_NAME[] = "/epd_test_frame_ring";
+
+TEST(EPD_TestSuite, Test_readInPlace_ShmFrameRing)
+{
+  // Stand-in for a co-located camera driver.
+  EPD::ShmFrameWriter producer(TEST_RING_NAME, 4, 640 * 480 * 3);
+  EPD::ShmFrameReader consumer(TEST_RING_NAME);
+
+  cv::Mat frame(480, 640, CV_8UC3, cv::Scalar(10, 20, 30));
+  uint32_t slot = 0;
+  uint64_t sequence = producer.write(frame, slot);
+
+  EXPECT_EQ(sequence, uint64_t(1));
+  EXPECT_EQ(slot, uint32_t(0));
+
+  cv::Mat view = consumer.view(slot, sequence, 640, 480, 640 * 3, CV_8UC3);
+  ASSERT_FALSE(view.empty());
+  EXPECT_EQ(cv::norm(view, frame, cv::NORM_INF), 0.0);
+  EXPECT_TRUE(consumer.isFrameIntact(slot, sequence));
+}
+
+TEST(EPD_TestSuite, Test_detectOverwrite_ShmFrameRing)
+{
+  EPD::ShmFrameWriter producer(TEST_RING_NAME, 2, 64 * 48 * 3);
+  EPD::ShmFrameReader consumer(TEST_RING_NAME);
+
+  cv::Mat frame(48, 64, CV_8UC3, cv::Scalar(1, 2, 3));
+  uint32_t first_slot = 0, slot = 0;
+  uint64_t first_sequence = producer.write(frame, first_slot);
+  producer.write(frame, slot);
+  EXPECT_TRUE(consumer.isValid(first_slot, first_sequence));
+
+  // A third frame wraps around onto the slot of the first frame.
+  producer.write(frame, slot);
+  EXPECT_EQ(slot, first_slot);
+  EXPECT_FALSE(consumer.isValid(first_slot, first_sequence));
+  EXPECT_FALSE(consumer.isFrameIntact(first_slot, first_sequence));
+  EXPECT_TRUE(consumer.view(first_slot, first_sequence, 64, 48, 64 * 3, CV_8UC3).empty());
+}
+
+TEST(EPD_TestSuite, Test_rejectOversizedFrame_ShmFrameRing)
+{
+  EPD::ShmFrameWriter producer(TEST_RING_NAME, 1, 16);
+
+  cv::Mat frame(48, 64, CV_8UC3, cv::Scalar(1, 2, 3));
+  uint32_t slot = 0;
+  EXPECT_THROW(producer.write(frame, slot), std::runtime_error);
+  EXPECT_THROW(EPD::ShmFrameReader("/epd_missing_frame_ring"), std::runtime_error);
+}
+
+TEST(EPD_TestSuite, Test_rejectInvalidSlotDimensions_ShmFrameRing)
+{
+  EPD::ShmFrameWriter producer(TEST_RING_NAME, 1, 64 * 48 * 3);
+  EPD::ShmFrameReader consumer(TEST_RING_NAME);
+
+  cv::Mat frame(48, 64, CV_8UC3, cv::Scalar(1, 2, 3));
+  uint32_t slot = 0;
+  uint64_t sequence = producer.write(frame, slot);
+
+  // Dimensions come straight from the EPDFrameSlot message of the producer.
+  EXPECT_TRUE(consumer.view(slot, sequence, 64, 48, 0, CV_8UC3).empty());
+  EXPECT_TRUE(consumer.view(slot, sequence, 64, 48, 64, CV_8UC3).empty());
+  EXPECT_TRUE(consumer.view(slot, sequence, 64, 49, 64 * 3, CV_8UC3).empty());
+  EXPECT_TRUE(consumer.view(slot, sequence, 0, 48, 64 * 3, CV_8UC3).empty());
+  EXPECT_TRUE(consumer.view(slot, sequence, UINT32_MAX, 1, 64 * 3, CV_8UC3).empty());
+  EXPECT_TRUE(consumer.view(slot, sequence, 1, UINT32_MAX, 3, CV_8UC3).empty());
+  EXPECT_FALSE(consumer.view(slot, sequence, 64, 48, 64 * 3, CV_8UC3).empty());
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,72 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+#include <string>
+#include "gtest/gtest.h"
+#include "epd_utils_lib/stamp_matcher.hpp"
+
+typedef EPD::StampMatcher<int, std::string> TestMatcher;
+
+TEST(EPD_TestSuite, Test_match_StampMatcher)
+{
+  TestMatcher matcher(4);
+  TestMatcher::Match match;
+
+  // Frames arrive ahead of their results.
+  EXPECT_FALSE(matcher.addFirst(10, std::make_shared<const int>(1), match));
+  EXPECT_FALSE(matcher.addFirst(20, std::make_shared<const int>(2), match));
+  EXPECT_FALSE(matcher.addFirst(30, std::make_shared<const int>(3), match));
+
+  // The result of the second frame matches it and drops the first frame,
+  // whose result was never published.
+  ASSERT_TRUE(matcher.addSecond(20, std::make_shared<const std::string>("b"), match));
+  EXPECT_EQ(match.stampNs, 20);
+  EXPECT_EQ(*match.first, 2);
+  EXPECT_EQ(*match.second, "b");
+  EXPECT_EQ(matcher.getNumPendingFirst(), unsigned(1));
+  EXPECT_EQ(matcher.getNumPendingSecond(), unsigned(0));
+
+  // A result may also arrive ahead of its frame.
+  EXPECT_FALSE(matcher.addSecond(40, std::make_shared<const std::string>("d"), match));
+  ASSERT_TRUE(matcher.addFirst(40, std::make_shared<const int>(4), match));
+  EXPECT_EQ(*match.first, 4);
+  EXPECT_EQ(*match.second, "d");
+  EXPECT_EQ(matcher.getNumPendingFirst(), unsigned(0));
+  EXPECT_EQ(matcher.getNumPendingSecond(), unsigned(0));
+}
+
+TEST(EPD_TestSuite, Test_capacity_StampMatcher)
+{
+  TestMatcher matcher(2);
+  TestMatcher::Match match;
+
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_FALSE(matcher.addFirst(i, std::make_shared<const int>(i), match));
+  }
+  EXPECT_EQ(matcher.getNumPendingFirst(), unsigned(2));
+
+  // The oldest frames were dropped.
+  EXPECT_FALSE(matcher.addSecond(0, std::make_shared<const std::string>("a"), match));
+  ASSERT_TRUE(matcher.addSecond(4, std::make_shared<const std::string>("e"), match));
+  EXPECT_EQ(*match.first, 4);
+  EXPECT_EQ(matcher.getNumPendingSecond(), unsigned(0));
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
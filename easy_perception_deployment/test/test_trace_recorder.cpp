@@ -0,0 +1,132 @@
+// Copyright 2020 Advanced Remanufacturing and Technology Centre
+// Copyright 2020 ROS-Industrial Consortium Asia Pacific Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+#include "epd_utils_lib/trace_recorder.hpp"
+
+size_t countOccurrences(const std::string & text, const std::string & pattern)
+{
+  size_t count = 0;
+  for (size_t pos = text.find(pattern); pos != std::string::npos;
+    pos = text.find(pattern, pos + 1))
+  {
+    ++count;
+  }
+  return count;
+}
+
+TEST(EPD_TestSuite, Test_recordStages_TraceRecorder)
+{
+  EPD::TraceRecorder recorder(1024);
+  ASSERT_TRUE(EPD::addStageObserver(&recorder));
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([]() {
+        for (int i = 0; i < 10; ++i) {
+          EPD::ScopedStage receive(EPD::Stage::RECEIVE);
+          EPD::ScopedStage inference(EPD::Stage::INFERENCE);
+        }
+      });
+  }
+  for (auto & thread : threads) {
+    thread.join();
+  }
+  EPD::removeStageObserver(&recorder);
+
+  EXPECT_EQ(recorder.getNumRecorded(), 4u * 10u * 4u);
+
+  std::ostringstream trace;
+  recorder.writeChromeTrace(trace);
+  const std::string json = trace.str();
+
+  EXPECT_EQ(json.find("{\"displayTimeUnit\": \"ms\", \"traceEvents\": ["), 0u);
+  EXPECT_EQ(countOccurrences(json, "\"name\": \"receive\""), 80u);
+  EXPECT_EQ(countOccurrences(json, "\"name\": \"inference\""), 80u);
+  EXPECT_EQ(countOccurrences(json, "\"ph\": \"B\""), 80u);
+  EXPECT_EQ(countOccurrences(json, "\"ph\": \"E\""), 80u);
+}
+
+TEST(EPD_TestSuite, Test_wrapRing_TraceRecorder)
+{
+  // Only the last 3 of the 4 events fit, which drops the begin of receive.
+  EPD::TraceRecorder recorder(3);
+  ASSERT_TRUE(EPD::addStageObserver(&recorder));
+  {
+    EPD::ScopedStage receive(EPD::Stage::RECEIVE);
+    EPD::ScopedStage decode(EPD::Stage::DECODE);
+  }
+  EPD::removeStageObserver(&recorder);
+
+  std::ostringstream trace;
+  recorder.writeChromeTrace(trace);
+  const std::string json = trace.str();
+
+  // The end of receive is dropped as well, since its begin was overwritten.
+  EXPECT_EQ(countOccurrences(json, "\"name\""), 2u);
+  EXPECT_EQ(countOccurrences(json, "\"name\": \"decode\", \"cat\": \"epd\", \"ph\": \"E\""), 1u);
+  EXPECT_EQ(countOccurrences(json, "\"name\": \"receive\", \"cat\": \"epd\", \"ph\": \"E\""), 0u);
+}
+
+TEST(EPD_TestSuite, Test_mergeOrtProfile_TraceRecorder)
+{
+  const std::string ortProfilePath = "./epd_test_ort_profile.json";
+  const std::string cascadeProfilePath = "./epd_test_cascade_profile.json";
+  {
+    std::ofstream ortProfile(ortProfilePath);
+    ortProfile << "[\n" <<
+      "{\"cat\" : \"Session\",\"pid\" :1,\"tid\" :2,\"dur\" :5,\"ts\" :100,"
+      "\"ph\" : \"X\",\"name\" :\"model_run\",\"args\" : {}},\n" <<
+      "{\"cat\" : \"Node\",\"pid\" :1,\"tid\" :2,\"dur\" :3,\"ts\" :250,"
+      "\"ph\" : \"X\",\"name\" :\"Conv_0\",\"args\" : {\"op_name\" : \"Conv\"}}\n" <<
+      "]\n";
+  }
+  {
+    std::ofstream cascadeProfile(cascadeProfilePath);
+    cascadeProfile << "[\n" <<
+      "{\"cat\" : \"Session\",\"pid\" :1,\"tid\" :3,\"dur\" :4,\"ts\" :100,"
+      "\"ph\" : \"X\",\"name\" :\"cascade_run\",\"args\" : {}}\n" <<
+      "]\n";
+  }
+
+  EPD::TraceRecorder recorder(16);
+  std::ostringstream trace;
+  recorder.writeChromeTrace(trace, {{ortProfilePath, 2000000}, {cascadeProfilePath, 3000000}});
+  const std::string json = trace.str();
+  std::remove(ortProfilePath.c_str());
+  std::remove(cascadeProfilePath.c_str());
+
+  EXPECT_NE(json.find("\"ts\": 2100.000,\"ph\" : \"X\",\"name\" :\"model_run\""),
+    std::string::npos);
+  EXPECT_NE(json.find("\"ts\": 2250.000,\"ph\" : \"X\",\"name\" :\"Conv_0\""),
+    std::string::npos);
+  EXPECT_NE(json.find("{\"op_name\" : \"Conv\"}}"), std::string::npos);
+  // The events of both profiles are separate elements of one array.
+  EXPECT_NE(json.find("\"args\" : {\"op_name\" : \"Conv\"}},\n{\"cat\" : \"Session\",\"pid\" :1,"
+    "\"tid\" :3,\"dur\" :4,\"ts\": 3100.000,\"ph\" : \"X\",\"name\" :\"cascade_run\""),
+    std::string::npos);
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}